@@ -57,17 +57,51 @@ public:
 
 class TrainLogonModule : public dcc::ParameterizedLogonModule<ModuleBase> {
 public:
-    TrainLogonModule(openlcb::TrainService *s)
-        : trainService_(s)
+    using Base = ParameterizedLogonModule<ModuleBase>;
+
+    /// Constructor.
+    /// @param s the train service to create the train nodes in.
+    /// @param max_locos how many decoders can log on. Every logged on
+    /// decoder gets a train node, so this has to fit the RAM of the target.
+    TrainLogonModule(openlcb::TrainService *s, unsigned max_locos)
+        : Base(max_locos)
+        , trainService_(s)
     {
     }
 
-    using Base = ParameterizedLogonModule<ModuleBase>;
-    
     void assign_complete(unsigned loco_id)
     {
         Base::assign_complete(loco_id);
+        start_train(loco_id);
+    }
+
+    /// Adds a locomotive saved before a reboot, and creates its train node.
+    /// @param decoder_id 44-bit decoder ID (aligned to LSb).
+    /// @param address the S-9.2.1.1 encoded address previously assigned.
+    /// @return locomotive ID, or an invalid locomotive ID if the table is
+    /// full.
+    unsigned restore_loco(uint64_t decoder_id, uint16_t address)
+    {
+        unsigned lid = Base::restore_loco(decoder_id, address);
+        if (is_valid_loco_id(lid))
+        {
+            start_train(lid);
+        }
+        return lid;
+    }
+
+private:
+    /// Creates the train implementation and the OpenLCB train node for a
+    /// locomotive with an assigned address.
+    /// @param loco_id which locomotive.
+    void start_train(unsigned loco_id)
+    {
         auto& t = locos_[loco_id];
+        if (t.node_)
+        {
+            // Already running, e.g. a restored loco that logged on again.
+            return;
+        }
         uint8_t part = (t.assignedAddress_ >> 8) & dcc::Defs::ADR_MASK;
         
         if (part == dcc::Defs::ADR_MOBILE_SHORT) {
@@ -93,8 +127,7 @@ public:
         t.eventProducer_.reset(new openlcb::FixedEventProducer<
             openlcb::TractionDefs::IS_TRAIN_EVENT>(t.node_.get()));
     }
-    
-private:
+
     openlcb::TrainService* trainService_;
 };
 
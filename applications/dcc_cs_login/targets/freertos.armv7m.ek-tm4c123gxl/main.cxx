@@ -162,7 +162,10 @@ openlcb::TractionCvSpace traction_cv(stack.memory_config_handler(), &track,
     &railcom_hub, openlcb::MemoryConfigDefs::SPACE_DCC_CV);
 
 // ===== Logon components =====
-TrainLogonModule module{&trainService};
+/// How many decoders can log on. Each of them gets a train node, which needs
+/// to fit into the 32 KB RAM of the TM4C123.
+static constexpr unsigned MAX_LOGON_LOCOS = 32;
+TrainLogonModule module{&trainService, MAX_LOGON_LOCOS};
 dcc::LogonHandler<TrainLogonModule> logonHandler{
         &trainService, &track, &railcom_hub, &module};
 
@@ -206,7 +206,7 @@ int appl_main(int argc, char *argv[])
         if (s >= 0)
         {
             create_legacy_bridge();
-            new HubDeviceSelect<CanHubFlow>(&can_hub0, s);
+            new HubDeviceSocketCan(&can_hub0, s);
             fprintf(stderr, "Opened SocketCan %s: fd %d\n", socket_can_path, s);
         }
         else
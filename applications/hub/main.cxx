@@ -199,7 +199,7 @@ int appl_main(int argc, char *argv[])
         int s = socketcan_open(socket_can_path, 1);
         if (s >= 0)
         {
-            new HubDeviceSelect<CanHubFlow>(&can_hub0, s);
+            new HubDeviceSocketCan(&can_hub0, s);
             fprintf(stderr, "Opened SocketCan %s: fd %d\n", socket_can_path, s);
         }
         else
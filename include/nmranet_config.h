@@ -78,6 +78,14 @@ DECLARE_CONST(executor_select_prescaler);
  */
 DECLARE_CONST(executor_max_sleep_msec);
 
+/** Size of the per-thread buffer caches of the mainBufferPool. When nonzero,
+ * each thread keeps up to this many free buffers of every bucket size for
+ * itself, which reduces lock contention in multi-threaded applications. Only
+ * used when OPENMRN_FEATURE_BUFFER_THREAD_CACHE is set. 0 (default)
+ * disables the caches.
+ */
+DECLARE_CONST(buffer_thread_cache_size);
+
 /** Number of packets to queue in the CANbus device driver for send. Each packet
  * takes 16 bytes of RAM. */
 DECLARE_CONST(can_tx_buffer_size);
@@ -178,10 +186,27 @@ DECLARE_CONST(node_init_identify);
  * time. */
 DECLARE_CONST(bulk_alias_num_can_frames);
 
+/** Number of preallocated reassembly buffers for multi-frame addressed
+ * messages and for multi-frame datagrams (each) on a CAN interface. The table
+ * grows if more messages are arriving at the same time. */
+DECLARE_CONST(can_reassembly_table_size);
+
+/** A partially received multi-frame message or datagram on a CAN interface is
+ * dropped if there was no frame for it for this many milliseconds. */
+DECLARE_CONST(can_reassembly_timeout_msec);
+
+/** Writes to a @ref MappedFileMemorySpace are synced to disk this many
+ * milliseconds after the first unsynced write. */
+DECLARE_CONST(mapped_file_sync_delay_msec);
+
 /** Default number of bytes in maximum stream window size for { @ref
  * StreamReceiver }. */
 DECLARE_CONST(stream_receiver_default_window_size);
 
+/** Default number of bytes in maximum stream window size for { @ref
+ * StreamReceiverTcp }. */
+DECLARE_CONST(stream_receiver_tcp_window_size);
+
 /** Stack size for @ref SocketListener threads. */
 DECLARE_CONST(socket_listener_stack_size);
 
@@ -69,6 +69,27 @@
 #define OPENMRN_HAVE_POSIX_FD 1
 #endif
 
+#if defined(__linux__)
+/// Enables MappedFileMemorySpace, which serves the configuration file from a
+/// shared memory mapping.
+#define OPENMRN_HAVE_MMAP 1
+#endif
+
+#if defined(__linux__) || defined(__MACH__)
+/// Uses ::writev in HubDeviceSelect to send several queued buffers with a
+/// single system call.
+#define OPENMRN_HAVE_WRITEV 1
+#endif
+
+#if defined(__linux__) && defined(OPENMRN_ENABLE_CAN_RX_TIMESTAMP)
+/// Adds a receive timestamp to the CAN frames going through a CanHubFlow,
+/// which is filled in by HubDeviceSocketCan. This makes every CAN buffer 8
+/// bytes larger, thus it has to be requested by defining
+/// OPENMRN_ENABLE_CAN_RX_TIMESTAMP in the compiler flags of both the library
+/// and the application.
+#define OPENMRN_HAVE_CAN_RX_TIMESTAMP 1
+#endif
+
 #if !defined(ESP_PLATFORM)
 /// Enables the code using ::fstat to confirm if the file handle is a socket.
 #define OPENMRN_HAVE_SOCKET_FSTAT 1
@@ -81,6 +102,14 @@
 #define OPENMRN_HAVE_PSELECT 1
 #endif
 
+#if defined(__linux__) && defined(OPENMRN_HAVE_PSELECT) &&                   \
+    !defined(OPENMRN_HAVE_EPOLL)
+/// Uses epoll instead of ::pselect in the Executor to wait for the
+/// Selectables. There is no FD_SETSIZE limit, and the cost of a wakeup does
+/// not depend on the number of file descriptors waited upon.
+#define OPENMRN_HAVE_EPOLL 1
+#endif
+
 #if defined(__WINNT__) || defined(ESP_PLATFORM) || defined(ESP_NONOS)
 /// Uses ::select in the executor to sleep (unsure how wakeup is handled)
 #define OPENMRN_HAVE_SELECT 1
@@ -171,6 +200,40 @@
 
 #endif
 
+#if !defined(OPENMRN_FEATURE_TIMER_WHEEL) &&                                  \
+    (defined(__linux__) || defined(__MACH__) || defined(__WINNT__))
+/// Uses a hierarchical timing wheel in ActiveTimers instead of a sorted
+/// list. Starting and cancelling a timer is O(1), at the cost of about 2 kbytes
+/// of RAM per executor. Define to 0 to use the sorted list.
+#define OPENMRN_FEATURE_TIMER_WHEEL 1
+#endif
+
+#if !defined(OPENMRN_FEATURE_BUFFER_THREAD_CACHE) &&                          \
+    (defined(__linux__) || defined(__MACH__))
+/// Compiles DynamicPool::enable_thread_cache(), which puts per-thread caches
+/// of free buffers in front of the shared buckets of a DynamicPool. Needs
+/// thread_local storage with destructors.
+#define OPENMRN_FEATURE_BUFFER_THREAD_CACHE 1
+#endif
+
+#if defined(__SSE2__)
+/// SSE2 intrinsics (emmintrin.h) are available. Used for bulk character
+/// processing, e.g. in the GridConnect parser and formatter.
+#define OPENMRN_HAVE_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+/// AArch64 NEON intrinsics (arm_neon.h) are available. Used for bulk character
+/// processing, e.g. in the GridConnect parser and formatter.
+#define OPENMRN_HAVE_NEON 1
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) &&                              \
+    (defined(__linux__) || defined(__MACH__))
+/// The compiler can emit PCLMULQDQ (carry-less multiply) in functions with a
+/// target attribute, and __builtin_cpu_supports can tell at runtime whether
+/// the CPU has it. Used by the CRC-16 routines.
+#define OPENMRN_HAVE_X86_CLMUL 1
+#endif
+
 #if !defined(__MACH__)
 /// Compiles support for calling reboot() in ConfigUpdateFlow.hxx and
 /// MemoryConfig.cxx.
@@ -646,6 +646,13 @@ public:
     /// requested by the previous cycle or the on-update notification). @param
     /// packet needs to be filled in for the output.
     void get_next_packet(unsigned code, Packet *packet) OVERRIDE;
+
+    /// @param code the update code. @return false for ESTOP, because the
+    /// emergency stop packet reverses the direction of the decoder.
+    bool is_repeatable(unsigned code) OVERRIDE
+    {
+        return code != ESTOP;
+    }
 };
 
 /// Structure defining the volatile state for a Marklin-Motorola v2 protocol
@@ -754,6 +761,13 @@ public:
     /// requested by the previous cycle or the on-update notification). @param
     /// packet needs to be filled in for the output.
     void get_next_packet(unsigned code, Packet *packet) OVERRIDE;
+
+    /// @param code the update code. @return false for ESTOP, because the
+    /// emergency stop packet reverses the direction of the decoder.
+    bool is_repeatable(unsigned code) OVERRIDE
+    {
+        return code != ESTOP;
+    }
 };
 
 } // namespace dcc
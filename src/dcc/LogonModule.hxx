@@ -34,7 +34,7 @@
 #ifndef _DCC_LOGONMODULE_HXX_
 #define _DCC_LOGONMODULE_HXX_
 
-#include <map>
+#include <memory>
 #include <vector>
 
 #include "dcc/Defs.hxx"
@@ -43,11 +43,132 @@
 namespace dcc
 {
 
+/// Open addressing hash table mapping 44-bit decoder IDs to dense locomotive
+/// IDs. The storage is allocated in the constructor; lookups and inserts
+/// never allocate memory. Entries cannot be removed.
+class DecoderIdTable
+{
+public:
+    /// Value returned for decoder IDs that are not in the table.
+    static constexpr uint16_t NOT_FOUND = 0xFFFF;
+
+    /// Constructor.
+    /// @param capacity how many decoder IDs the table needs to hold.
+    DecoderIdTable(unsigned capacity)
+    {
+        HASSERT(capacity < NOT_FOUND);
+        // Keeps the load factor at or below 50%, so that the probe sequences
+        // stay short.
+        unsigned sz = 4;
+        while (sz < capacity * 2)
+        {
+            sz <<= 1;
+        }
+        mask_ = sz - 1;
+        slots_.reset(new Slot[sz]);
+        for (unsigned i = 0; i < sz; ++i)
+        {
+            slots_[i].locoId_ = NOT_FOUND;
+        }
+    }
+
+    /// Looks up a decoder ID.
+    /// @param decoder_id 44-bit decoder ID (aligned to LSb).
+    /// @return the locomotive ID, or NOT_FOUND.
+    uint16_t find(uint64_t decoder_id)
+    {
+        return slots_[probe(decoder_id)].locoId_;
+    }
+
+    /// Adds a decoder ID to the table. The decoder ID must not be in the table
+    /// yet, and the table must not hold more than capacity entries after this
+    /// call.
+    /// @param decoder_id 44-bit decoder ID (aligned to LSb).
+    /// @param loco_id locomotive ID to store.
+    void insert(uint64_t decoder_id, uint16_t loco_id)
+    {
+        Slot &s = slots_[probe(decoder_id)];
+        HASSERT(s.locoId_ == NOT_FOUND);
+        s.decoderId_ = decoder_id;
+        s.locoId_ = loco_id;
+    }
+
+private:
+    /// One cell in the hash table.
+    struct Slot
+    {
+        /// 44-bit decoder ID.
+        uint64_t decoderId_ : 48;
+        /// Locomotive ID, or NOT_FOUND if this slot is empty.
+        uint64_t locoId_ : 16;
+    };
+
+    /// Finds the slot for a decoder ID using linear probing.
+    /// @param decoder_id 44-bit decoder ID.
+    /// @return the index of the slot that holds this decoder ID, or the empty
+    /// slot where it should be inserted.
+    unsigned probe(uint64_t decoder_id)
+    {
+        // Fibonacci hashing. The upper bits of the product depend on every
+        // bit of the decoder ID, including the manufacturer bits at the top.
+        unsigned i = (decoder_id * 0x9E3779B97F4A7C15ull) >> 32;
+        while (true)
+        {
+            i &= mask_;
+            if (slots_[i].locoId_ == NOT_FOUND ||
+                slots_[i].decoderId_ == decoder_id)
+            {
+                return i;
+            }
+            ++i;
+        }
+    }
+
+    /// Hash table. The size is a power of two.
+    std::unique_ptr<Slot[]> slots_;
+    /// Size of the hash table minus one.
+    unsigned mask_;
+};
+
+/// Optional callback interface for saving the logon table to non-volatile
+/// storage. An implementation saves every completed address assignment, and at
+/// startup hands the saved entries to ParameterizedLogonModule::restore_loco()
+/// before calling LogonHandler::startup_logon() with the same CID and session
+/// ID as before. Decoders then keep their addresses and do not need to log on
+/// again after a reboot of the command station.
+class LogonPersistence
+{
+public:
+    virtual ~LogonPersistence()
+    {
+    }
+
+    /// Invoked when a decoder has completed the address assignment.
+    /// @param loco_id dense locomotive ID.
+    /// @param decoder_id 44-bit decoder ID (aligned to LSb).
+    /// @param address assigned address in the S-9.2.1.1 encoding.
+    virtual void loco_assigned(
+        unsigned loco_id, uint64_t decoder_id, uint16_t address) = 0;
+};
+
 /// Default implementation of the storage and policy module for trains.
 template<class Base>
 class ParameterizedLogonModule : public LogonHandlerModule
 {
 public:
+    /// Default for the maximum number of locomotives.
+    static constexpr unsigned DEFAULT_MAX_LOCOS = 64;
+
+    /// Constructor. All memory is allocated here.
+    /// @param max_locos how many decoders can log on. Further decoders are
+    /// ignored.
+    ParameterizedLogonModule(unsigned max_locos = DEFAULT_MAX_LOCOS)
+        : ids_(max_locos)
+        , maxLocos_(max_locos)
+    {
+        locos_.reserve(max_locos);
+    }
+
     /// We store this structure about each locomotive.
     struct LocoInfo : public Base::Storage
     {
@@ -63,8 +184,44 @@ public:
         uint64_t decoderId_;
     };
 
+    /// Locomotives, indexed by locomotive ID.
     std::vector<LocoInfo> locos_;
-    std::map<uint64_t, uint16_t> ids_;
+    /// Decoder ID to locomotive ID lookup.
+    DecoderIdTable ids_;
+
+    /// Sets the persistence callback. @param p will be notified of every
+    /// completed address assignment. Not owned, may be nullptr.
+    void set_persistence(LogonPersistence *p)
+    {
+        persistence_ = p;
+    }
+
+    /// Adds a locomotive that was saved by a LogonPersistence implementation
+    /// before a reboot. The loco will be in completed state, and will get the
+    /// same address again if it logs on. This does not call assign_complete()
+    /// and does not notify the persistence; a subclass that creates objects
+    /// in assign_complete() has to do so for the restored locos as well (see
+    /// TrainLogonModule in applications/dcc_cs_login).
+    /// @param decoder_id 44-bit decoder ID (aligned to LSb).
+    /// @param address the S-9.2.1.1 encoded address previously assigned.
+    /// @return locomotive ID, or an invalid locomotive ID if the table is
+    /// full.
+    unsigned restore_loco(uint64_t decoder_id, uint16_t address)
+    {
+        unsigned lid = create_or_lookup_loco(decoder_id);
+        if (!is_valid_loco_id(lid))
+        {
+            return lid;
+        }
+        locos_[lid].assignedAddress_ = address;
+        locos_[lid].flags_ = LogonHandlerModule::FLAG_COMPLETE;
+        if (address >= nextAddress_ &&
+            address <= ((Defs::MAX_MOBILE_LONG << 8) | 0xFF))
+        {
+            nextAddress_ = address + 1;
+        }
+        return lid;
+    }
 
     /// @return the number of locomotives known. The locomotive IDs are
     /// 0..num_locos() - 1.
@@ -103,20 +260,31 @@ public:
     /// @return locomotive ID for this cell.
     unsigned create_or_lookup_loco(uint64_t decoder_id)
     {
-        auto it = ids_.find(decoder_id);
-        if (it == ids_.end())
+        uint16_t lid = ids_.find(decoder_id);
+        if (lid != DecoderIdTable::NOT_FOUND)
         {
-            // create new.
-            uint16_t lid = locos_.size();
-            locos_.emplace_back();
-            locos_[lid].decoderId_ = decoder_id;
-            ids_[decoder_id] = lid;
             return lid;
         }
-        else
+        if (locos_.size() >= maxLocos_)
         {
-            return it->second;
+            // Table full. This is not a valid loco ID.
+            if (!fullReported_)
+            {
+                LOG(WARNING,
+                    "Logon table full (%u locos), ignoring decoder id "
+                    "%03x%08x",
+                    maxLocos_, (unsigned)(decoder_id >> 32),
+                    (unsigned)(decoder_id & 0xffffffffu));
+                fullReported_ = true;
+            }
+            return maxLocos_;
         }
+        // create new.
+        lid = locos_.size();
+        locos_.emplace_back();
+        locos_[lid].decoderId_ = decoder_id;
+        ids_.insert(decoder_id, lid);
+        return lid;
     }
 
     /// Runs the locomotive address policy. After the address policy is run,
@@ -129,6 +297,11 @@ public:
     {
         /// @todo support accessory decoders.
 
+        // A decoder that logs on again keeps the address it had.
+        if (locos_[loco_id].assignedAddress_ != Defs::ADR_INVALID)
+        {
+            return;
+        }
         // Note: we ignore the desired address and start assigning addresses
         // from 10000 and up.
         locos_[loco_id].assignedAddress_ = nextAddress_++;
@@ -146,10 +319,23 @@ public:
     void assign_complete(unsigned loco_id)
     {
         loco_flags(loco_id) |= LogonHandlerModule::FLAG_COMPLETE;
+        if (persistence_)
+        {
+            persistence_->loco_assigned(loco_id, locos_[loco_id].decoderId_,
+                locos_[loco_id].assignedAddress_);
+        }
     }
 
     uint16_t nextAddress_ {(Defs::ADR_MOBILE_LONG << 8) + 10000};
 
+private:
+    /// Maximum number of entries in locos_.
+    unsigned maxLocos_;
+    /// Callback for saving the assignments. May be nullptr.
+    LogonPersistence *persistence_ {nullptr};
+    /// True if we already logged that the table is full.
+    bool fullReported_ {false};
+
 }; // class ParameterizedLogonModule
 
 class DefaultBase {
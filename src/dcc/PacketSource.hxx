@@ -56,6 +56,16 @@ public:
      * tells which recently changed value should be generated. 
      * @param packet is the storage to set the outgoing packet in. */
     virtual void get_next_packet(unsigned code, Packet* packet) = 0;
+
+    /** Tells the update loop whether it may repeat the packet for an update
+     * code. Sources whose packet generation has side effects (such as
+     * toggling the direction) must return false for those codes.
+     * @param code a non-zero update code, as passed to get_next_packet.
+     * @return true if calling get_next_packet(code) again is harmless. */
+    virtual bool is_repeatable(unsigned code)
+    {
+        return true;
+    }
 };
 
 /// Abstract class that is a packet source but not a TrainImpl. Provides dummy
@@ -34,17 +34,27 @@
  */
 
 #include "dcc/SimpleUpdateLoop.hxx"
+
+#include <algorithm>
+
 #include "dcc/Packet.hxx"
 #include "dcc/PacketSource.hxx"
 
 namespace dcc
 {
 
+constexpr unsigned SimpleUpdateLoop::MAX_UPDATES_IN_A_ROW;
+constexpr unsigned SimpleUpdateLoop::UPDATE_REPEAT_COUNT;
+
 SimpleUpdateLoop::SimpleUpdateLoop(Service *service, TrackIf *track_send)
     : StateFlow(service)
     , trackSend_(track_send)
     , nextRefreshIndex_(0)
+    , nextExclusiveIndex_(0)
     , lastCycleStart_(os_get_time_monotonic())
+    , updatesInARow_(0)
+    , lastSource_(nullptr)
+    , lastWasRepeat_(false)
 {
 }
 
@@ -52,7 +62,137 @@ SimpleUpdateLoop::~SimpleUpdateLoop()
 {
 }
 
-StateFlowBase::Action SimpleUpdateLoop::entry()
+bool SimpleUpdateLoop::add_refresh_source(
+    dcc::PacketSource *source, unsigned priority)
+{
+    AtomicHolder h(this);
+    if (priority >= EXCLUSIVE_MIN_PRIORITY)
+    {
+        exclusiveSources_.push_back({source, priority});
+        for (const auto &e : exclusiveSources_)
+        {
+            if (e.priority_ > priority)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (refreshIndex_.find(source) == refreshIndex_.end())
+    {
+        refreshIndex_[source] = refreshSources_.size();
+        refreshSources_.push_back(source);
+    }
+    return exclusiveSources_.empty();
+}
+
+void SimpleUpdateLoop::remove_refresh_source(dcc::PacketSource *source)
+{
+    AtomicHolder h(this);
+    auto it = refreshIndex_.find(source);
+    if (it != refreshIndex_.end())
+    {
+        unsigned idx = it->second;
+        refreshIndex_.erase(it);
+        remove_refresh_index(idx);
+    }
+    exclusiveSources_.erase(std::remove_if(exclusiveSources_.begin(),
+                                exclusiveSources_.end(),
+                                [source](const ExclusiveSource &e) {
+                                    return e.source_ == source;
+                                }),
+        exclusiveSources_.end());
+    auto is_source = [source](const Update &u) {
+        return u.source_ == source;
+    };
+    updates_.erase(std::remove_if(updates_.begin(), updates_.end(), is_source),
+        updates_.end());
+    repeats_.erase(std::remove_if(repeats_.begin(), repeats_.end(), is_source),
+        repeats_.end());
+    if (lastSource_ == source)
+    {
+        lastSource_ = nullptr;
+    }
+}
+
+void SimpleUpdateLoop::notify_update(PacketSource *source, unsigned code)
+{
+    AtomicHolder h(this);
+    for (const auto &u : updates_)
+    {
+        if (u.source_ == source && u.code_ == code)
+        {
+            // Will be sent with the latest state anyway.
+            return;
+        }
+    }
+    updates_.push_back({source, code, UPDATE_REPEAT_COUNT});
+}
+
+void SimpleUpdateLoop::move_refresh_index(unsigned from, unsigned to)
+{
+    if (from == to)
+    {
+        return;
+    }
+    refreshSources_[to] = refreshSources_[from];
+    refreshIndex_[refreshSources_[to]] = to;
+}
+
+void SimpleUpdateLoop::remove_refresh_index(unsigned idx)
+{
+    if (idx < nextRefreshIndex_)
+    {
+        // The hole is in the part that was already refreshed in this cycle.
+        // Fill it from the end of that part, then fill the new hole from the
+        // end of the vector.
+        --nextRefreshIndex_;
+        move_refresh_index(nextRefreshIndex_, idx);
+        idx = nextRefreshIndex_;
+    }
+    move_refresh_index(refreshSources_.size() - 1, idx);
+    refreshSources_.pop_back();
+}
+
+void SimpleUpdateLoop::schedule_repeat(const Update &u)
+{
+    if (!u.repeats_ || !u.source_->is_repeatable(u.code_))
+    {
+        return;
+    }
+    for (auto &r : repeats_)
+    {
+        if (r.source_ == u.source_ && r.code_ == u.code_)
+        {
+            r.repeats_ = u.repeats_;
+            return;
+        }
+    }
+    repeats_.push_back(u);
+}
+
+PacketSource *SimpleUpdateLoop::next_exclusive()
+{
+    unsigned top = 0;
+    for (const auto &e : exclusiveSources_)
+    {
+        top = std::max(top, e.priority_);
+    }
+    // Round-robin among the sources with the highest priority.
+    size_t n = exclusiveSources_.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t idx = (nextExclusiveIndex_ + i) % n;
+        if (exclusiveSources_[idx].priority_ == top)
+        {
+            nextExclusiveIndex_ = idx + 1;
+            return exclusiveSources_[idx].source_;
+        }
+    }
+    DIE("no exclusive source");
+}
+
+PacketSource *SimpleUpdateLoop::next_refresh()
 {
     long long current_time = os_get_time_monotonic();
     long long prev_cycle_start = lastCycleStart_;
@@ -68,14 +208,67 @@ StateFlowBase::Action SimpleUpdateLoop::entry()
         // We do not want to send another packet to the same locomotive too
         // quick. We send an idle packet instead. OR: We do not have any
         // locomotives at all. We will keep sending idle packets.
-        message()->data()->set_dcc_idle();
+        return nullptr;
+    }
+    return refreshSources_[nextRefreshIndex_++];
+}
+
+StateFlowBase::Action SimpleUpdateLoop::entry()
+{
+    PacketSource *source = nullptr;
+    unsigned code = 0;
+    {
+        AtomicHolder h(this);
+        if (!exclusiveSources_.empty())
+        {
+            // Updates are held back until the exclusive sources are gone.
+            source = next_exclusive();
+        }
+        else if (!updates_.empty() && updatesInARow_ < MAX_UPDATES_IN_A_ROW)
+        {
+            Update u = updates_.front();
+            updates_.pop_front();
+            source = u.source_;
+            code = u.code_;
+            ++updatesInARow_;
+            schedule_repeat(u);
+        }
+        else
+        {
+            // After a burst of updates this slot belongs to the background
+            // refresh.
+            bool refresh_due = updatesInARow_ >= MAX_UPDATES_IN_A_ROW;
+            updatesInARow_ = 0;
+            // A repeat does not go out directly after the previous packet to
+            // the same source.
+            if (!refresh_due && !repeats_.empty() && !lastWasRepeat_ &&
+                repeats_.front().source_ != lastSource_)
+            {
+                Update u = repeats_.front();
+                repeats_.pop_front();
+                source = u.source_;
+                code = u.code_;
+                lastWasRepeat_ = true;
+                if (--u.repeats_)
+                {
+                    repeats_.push_back(u);
+                }
+            }
+            else
+            {
+                lastWasRepeat_ = false;
+                source = next_refresh();
+            }
+        }
+    }
+    lastSource_ = source;
+    if (source)
+    {
+        source->get_next_packet(code, message()->data());
     }
     else
     {
-        // Send an update to the current loco.
-        refreshSources_[nextRefreshIndex_]
-            ->get_next_packet(0, message()->data());
-        nextRefreshIndex_++;
+        message()->data()->set_dcc_idle();
     }
     // We pass on the filled packet to the track processor.
     trackSend_->send(transfer_message());
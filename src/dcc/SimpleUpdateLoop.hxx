@@ -36,7 +36,8 @@
 #ifndef _DCC_SIMPLEUPDATELOOP_HXX_
 #define _DCC_SIMPLEUPDATELOOP_HXX_
 
-#include <algorithm>
+#include <deque>
+#include <unordered_map>
 
 #include "dcc/UpdateLoop.hxx"
 #include "executor/StateFlow.hxx"
@@ -44,9 +45,28 @@
 namespace dcc
 {
 
-/// Implementation of a command station update loop. This loop iterates over
-/// all locomotive implementations and polls them for the next packet in a
-/// strict round-robin behavior (no prioritization).
+/// Implementation of a command station update loop. Every time the track
+/// needs a packet, this loop picks a packet source and asks it for the next
+/// packet. The sources are chosen in the following order:
+///
+/// - If there are exclusive sources (priority at least
+///   EXCLUSIVE_MIN_PRIORITY, e.g. emergency stop or service mode
+///   programming), then only these are polled. The sources with the highest
+///   priority share the track in a round-robin manner; lower priorities wait
+///   until these go away.
+///
+/// - Sources that called notify_update get the next slot, in the order of
+///   the notifications. To keep the background refresh going, after
+///   MAX_UPDATES_IN_A_ROW such packets one slot goes to the refresh.
+///
+/// - The packet for a notified update is repeated UPDATE_REPEAT_COUNT more
+///   times, taking every other refresh slot, unless the source says that
+///   the packet is not repeatable (PacketSource::is_repeatable()).
+///
+/// - All other (non-exclusive) sources are refreshed in a strict round-robin
+///   manner. Their priority is not used.
+///
+/// Adding and removing refresh sources takes constant time.
 ///
 /// Usage:
 ///
@@ -65,44 +85,97 @@ public:
     SimpleUpdateLoop(Service *service, TrackIf *track_send);
     ~SimpleUpdateLoop();
 
+    /// How many packets for notified updates may be sent before a background
+    /// refresh packet has to be sent.
+    static constexpr unsigned MAX_UPDATES_IN_A_ROW = 4;
+    /// How many times the packet of a notified update is repeated after it
+    /// was first sent.
+    static constexpr unsigned UPDATE_REPEAT_COUNT = 2;
+
     /** Adds a new refresh source to the background refresh packets. */
     bool add_refresh_source(
-        dcc::PacketSource *source, unsigned priority) OVERRIDE
-    {
-        /// @todo implement priority refresh.
-        AtomicHolder h(this);
-        refreshSources_.push_back(source);
-        return true;
-    }
+        dcc::PacketSource *source, unsigned priority) OVERRIDE;
 
     /** Deletes a packet refresh source. */
-    void remove_refresh_source(dcc::PacketSource *source) OVERRIDE
-    {
-        AtomicHolder h(this);
-        refreshSources_.erase(
-            remove(refreshSources_.begin(), refreshSources_.end(), source),
-            refreshSources_.end());
-    }
-
-    /** We ignore notifications. The loop will get to them anyway. */
-    void notify_update(PacketSource *source, unsigned code) OVERRIDE
-    {
-    }
+    void remove_refresh_source(dcc::PacketSource *source) OVERRIDE;
+
+    /** Schedules the packet for the given update to be sent as soon as
+     * possible. */
+    void notify_update(PacketSource *source, unsigned code) OVERRIDE;
 
     // Entry to the state flow -- when a new packet needs to be sent.
     Action entry() OVERRIDE;
 
 private:
+    /// A notified update, or a repetition of an update.
+    struct Update
+    {
+        /// Which source to ask for the packet.
+        PacketSource *source_;
+        /// Source-specific code to pass to get_next_packet.
+        unsigned code_;
+        /// How many more times the update packet should be sent.
+        unsigned repeats_;
+    };
+
+    /// A refresh source with exclusive priority.
+    struct ExclusiveSource
+    {
+        /// Source to poll.
+        PacketSource *source_;
+        /// Priority as registered, at least EXCLUSIVE_MIN_PRIORITY.
+        unsigned priority_;
+    };
+
+    /// Picks the next exclusive source to poll. Must be called with the lock
+    /// held and exclusiveSources_ non-empty. @return the source.
+    PacketSource *next_exclusive();
+
+    /// Picks the next background refresh source. Must be called with the lock
+    /// held. @return the source, or nullptr if an idle packet should be sent.
+    PacketSource *next_refresh();
+
+    /// Removes an entry from the refresh round-robin, keeping the order of
+    /// the entries that have not been refreshed in this cycle yet.
+    /// @param idx index in refreshSources_ to remove.
+    void remove_refresh_index(unsigned idx);
+
+    /// Moves an entry in the refresh round-robin.
+    /// @param from index to move from
+    /// @param to index to move to (overwritten).
+    void move_refresh_index(unsigned from, unsigned to);
+
+    /// Queues the repetitions of an update that has just been sent.
+    /// @param u the update that was sent.
+    void schedule_repeat(const Update &u);
+
     // Place where we forward the packets filled in.
     TrackIf *trackSend_;
 
     // Packet sources to ask about refreshing data periodically.
     vector<dcc::PacketSource *> refreshSources_;
+    /// Index of each source in refreshSources_.
+    std::unordered_map<dcc::PacketSource *, unsigned> refreshIndex_;
+    /// Sources with exclusive priority. There are only very few of these.
+    vector<ExclusiveSource> exclusiveSources_;
+    /// Notified updates that were not sent yet.
+    std::deque<Update> updates_;
+    /// Updates that were sent and need to be repeated.
+    std::deque<Update> repeats_;
 
     /// Offset in the refreshSources_ vector for the next loco to send.
     size_t nextRefreshIndex_;
+    /// Offset in the exclusiveSources_ vector to start looking for the next
+    /// exclusive source to send.
+    size_t nextExclusiveIndex_;
     /// os time for the last time we sent a packet for loco zero.
     long long lastCycleStart_;
+    /// How many update packets were sent since the last refresh packet.
+    unsigned updatesInARow_;
+    /// Source of the previous packet, nullptr for an idle packet.
+    PacketSource *lastSource_;
+    /// True if the last refresh slot was used for repeating an update.
+    bool lastWasRepeat_;
 };
 }
 
@@ -35,8 +35,11 @@
 #ifndef _EXECUTOR_DISPATCHER_HXX_
 #define _EXECUTOR_DISPATCHER_HXX_
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 
+#include "executor/MulticastFlow.hxx"
 #include "executor/Notifiable.hxx"
 #include "executor/StateFlow.hxx"
 
@@ -46,6 +49,20 @@
    invoked.
 
    Handlers are called in no particular order.
+
+   Handlers that are registered as shared (multicast) handlers get a
+   reference to the incoming message buffer instead of a copy. A message that
+   matches N shared handlers is therefore delivered without allocating or
+   copying anything. Regular handlers still get an exclusively owned buffer
+   each.
+
+   The registered handlers are compiled into a read-only match index, which
+   groups the handlers by mask and has a hash table per mask group keyed by
+   (id & mask). A registration change only marks the index stale; the index
+   is rebuilt by the dispatch flow itself before the next message is
+   dispatched, so a burst of registration changes costs a single rebuild, and
+   the index being replaced is never in use. The dispatching of a message
+   takes no lock unless the index needs to be rebuilt.
  */
 template <int NUM_PRIO>
 class DispatchFlowBase : public UntypedStateFlow<QList<NUM_PRIO>>
@@ -83,8 +100,11 @@ protected:
        one
        @param handler is the flow to forward message to. It must stay alive so
        long as *this is alive or the handler is removed.
+       @param shared if true, the handler will get a shared reference to the
+       message instead of an exclusive copy.
      */
-    void register_handler(UntypedHandler *handler, ID id, ID mask);
+    void register_handler(
+        UntypedHandler *handler, ID id, ID mask, bool shared = false);
 
     /// Removes a specific instance of a handler from this dispatcher.
     ///
@@ -119,6 +139,10 @@ protected:
      */
     virtual void send_transfer() = 0;
 
+    /** Sends a new reference of the current message to a shared handler.
+     * @param handler a handler that was registered as shared. */
+    virtual void send_shared_ref(UntypedHandler *handler) = 0;
+
     /*typedef typename StateFlow<MessageType, QList<NUM_PRIO>>::Callback Callback;
     using StateFlow<MessageType, QList<NUM_PRIO>>::again;
     using StateFlow<MessageType, QList<NUM_PRIO>>::allocate_and_call;
@@ -157,13 +181,41 @@ protected:
     /// identifier, mask, handler pointer.
     struct HandlerInfo
     {
-        HandlerInfo() : handler(nullptr)
+        HandlerInfo()
+            : handler(nullptr)
+            , shared(false)
+        {
+        }
+
+        /// Copy constructor. @param o entry to copy.
+        HandlerInfo(const HandlerInfo &o)
+            : id(o.id)
+            , mask(o.mask)
+            , handler(o.handler.load(std::memory_order_relaxed))
+            , shared(o.shared)
+        {
+        }
+
+        /// Assignment operator. @param o entry to copy. @return *this.
+        HandlerInfo &operator=(const HandlerInfo &o)
         {
+            id = o.id;
+            mask = o.mask;
+            handler.store(
+                o.handler.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            shared = o.shared;
+            return *this;
         }
+
         ID id; ///< Bits that this handler is registered for.
         ID mask; ///< Mask that should be applied for the bits check.
-        /// Handler to call. NULL if the handler has been removed.
-        UntypedHandler *handler;
+        /// Handler to call. NULL if the handler has been removed. In a match
+        /// index this is cleared by unregister_handler() from a different
+        /// thread while the dispatch flow may be reading it.
+        std::atomic<UntypedHandler *> handler;
+        /// True if the handler accepts shared references to the message.
+        bool shared;
 
         /// Equality comparison function on the handlers. Used for remove()
         /// calls.
@@ -177,15 +229,121 @@ protected:
         bool Equals(ID id, ID mask, UntypedHandler *handler)
         {
             return (this->id == id && this->mask == mask &&
-                    this->handler == handler);
+                    this->handler.load(std::memory_order_relaxed) == handler);
+        }
+    };
+
+    /// Read-only compiled form of the handler registrations. Once published,
+    /// only the handler pointers may change (they get cleared when a handler
+    /// is unregistered while the index is still in use).
+    struct MatchIndex
+    {
+        enum : uint32_t
+        {
+            /// Marks an unused slot in the hash tables.
+            EMPTY_BUCKET = 0xFFFFFFFFu
+        };
+
+        /// All handlers that were registered with the same mask.
+        struct Group
+        {
+            /// Mask of all the entries in this group.
+            ID mask;
+            /// Index of the first entry of this group in entries.
+            uint32_t first;
+            /// Index one past the last entry of this group in entries.
+            uint32_t end;
+            /// Offset of this group's hash table in buckets.
+            uint32_t bucketOffset;
+            /// Log2 of the number of hash buckets of this group.
+            uint8_t bucketBits;
+        };
+
+        /// Computes the hash bucket for a given key.
+        /// @param key the masked identifier.
+        /// @param bits log2 of the hash table size (at least 1).
+        /// @return bucket index in 0 .. 2^bits - 1.
+        static uint32_t bucket(ID key, uint8_t bits)
+        {
+            return (uint32_t(key) * 2654435761u) >> (32 - bits);
+        }
+
+        /// Looks up the first entry matching a given key in a group.
+        /// @param g the group to search.
+        /// @param key the masked identifier to search for.
+        /// @return index of the first entry in entries with (id & mask) ==
+        /// key, or g.end if there is no such entry.
+        uint32_t find(const Group &g, ID key) const
+        {
+            uint32_t bmask = (1u << g.bucketBits) - 1;
+            for (uint32_t b = bucket(key, g.bucketBits);; b = (b + 1) & bmask)
+            {
+                uint32_t e = buckets[g.bucketOffset + b];
+                if (e == EMPTY_BUCKET)
+                {
+                    return g.end;
+                }
+                if ((entries[e].id & g.mask) == key)
+                {
+                    return e;
+                }
+            }
         }
+
+        /// Mask groups, in the order of first registration of the mask.
+        vector<Group> groups;
+        /// Handler registrations. The entries of each group are contiguous
+        /// and sorted by (id & mask); equal keys keep registration order.
+        vector<HandlerInfo> entries;
+        /// Open-addressing hash tables for all groups. Each non-empty slot
+        /// points to the first entry of a run of equal keys.
+        vector<uint32_t> buckets;
     };
 
-    /// Registered handlers.
+    /// Marks the match index stale, so that it gets rebuilt before the next
+    /// message is dispatched. Must be called with lock_ held.
+    void invalidate_index()
+    {
+        indexStale_.store(true, std::memory_order_release);
+    }
+
+    /// Compiles handlers_ into a new match index and replaces index_ with
+    /// it. Must be called with lock_ held, and only from the dispatch flow
+    /// when no message is being dispatched.
+    void publish_index();
+
+    /// Clears the handler pointer of a removed registration in the match
+    /// index, which may be in use by the dispatch flow. Must be called with
+    /// lock_ held.
+    /// @param id bits of the removed registration
+    /// @param mask mask of the removed registration
+    /// @param handler the removed handler.
+    /// @param all if true, clears every registration of handler, ignoring id
+    /// and mask.
+    void tombstone(ID id, ID mask, UntypedHandler *handler, bool all);
+
+    /// Registered handlers, in order of registration. Protected by lock_. This
+    /// is the source of truth from which the match index is compiled.
     vector<HandlerInfo> handlers_;
 
-    /// Index of the next handler to look at.
+    /// Current match index. Written only by the dispatch flow with lock_
+    /// held.
+    MatchIndex *index_{nullptr};
+    /// True if handlers_ was changed since index_ was compiled.
+    std::atomic<bool> indexStale_{false};
+
+    /// Match index used for the current message. Owned by the flow.
+    MatchIndex *readIndex_{nullptr};
+    /// Next group to look at in readIndex_.
+    size_t currentGroup_;
+    /// Index of the next entry to look at in readIndex_.
     size_t currentIndex_;
+    /// End of the entry range being looked at.
+    size_t currentEnd_;
+    /// How many shared references of the current message were sent out.
+    unsigned numSharedSent_;
+    /// True if we are making the copy for the last exclusive handler.
+    bool cloneForLast_{false};
 
     /// If non-NULL we still need to call this handler.
     UntypedHandler *lastHandlerToCall_{nullptr};
@@ -193,7 +351,7 @@ protected:
     /// registration.
     UntypedHandler *fallbackHandler_{nullptr};
 
-    /// Protects handler add / remove against iteration.
+    /// Protects handler add / remove against each other.
     OSMutex lock_;
 };
 
@@ -280,6 +438,26 @@ public:
         Base::register_fallback_handler(handler);
     }
 
+    /// Interface type for handlers that accept a shared message.
+    typedef MulticastFlowInterface<MessageType> SharedHandlerType;
+
+    /**
+       Adds a new handler to this dispatcher that will receive a shared
+       reference to the matching messages instead of a copy.
+
+       The handler can be removed with unregister_handler().
+
+       @param id is the identifier of the message to listen to.
+       @param mask is the mask of the ID matcher.
+       @param handler is the flow to forward message to. It must stay alive so
+       long as *this is alive or the handler is removed.
+     */
+    void register_shared_handler(SharedHandlerType *handler, ID id, ID mask)
+    {
+        Base::register_handler(
+            static_cast<HandlerType *>(handler), id, mask, true);
+    }
+
 protected:
     /// @return the identifier bits of the current message.
     typename Base::ID get_message_id() OVERRIDE {
@@ -319,6 +497,15 @@ protected:
         HandlerType* h = static_cast<HandlerType *>(this->lastHandlerToCall_);
         h->send(this->transfer_message());
     }
+
+    /// Sends a new reference of the current message to a shared handler.
+    /// @param handler the handler to send to
+    void send_shared_ref(typename Base::UntypedHandler *handler) OVERRIDE
+    {
+        auto *h = static_cast<SharedHandlerType *>(
+            static_cast<HandlerType *>(handler));
+        h->send_shared(this->message()->ref());
+    }
 };
 
 
@@ -336,40 +523,27 @@ template<int NUM_PRIO>
 DispatchFlowBase<NUM_PRIO>::~DispatchFlowBase()
 {
     HASSERT(this->is_waiting());
+    delete index_;
 }
 
 template<int NUM_PRIO>
 size_t DispatchFlowBase<NUM_PRIO>::size()
 {
     OSMutexLock h(&lock_);
-    size_t ret = 0;
-    for (auto &h : handlers_)
-    {
-        if (h.handler)
-        {
-            ++ret;
-        }
-    }
-    return ret;
+    return handlers_.size();
 }
 
 template<int NUM_PRIO>
-void DispatchFlowBase<NUM_PRIO>::register_handler(UntypedHandler *handler,
-                                                  ID id, ID mask)
+void DispatchFlowBase<NUM_PRIO>::register_handler(
+    UntypedHandler *handler, ID id, ID mask, bool shared)
 {
     OSMutexLock h(&lock_);
-    size_t idx = 0;
-    while (idx < handlers_.size() && handlers_[idx].handler)
-    {
-        ++idx;
-    }
-    if (idx >= handlers_.size())
-    {
-        handlers_.resize(handlers_.size() + 1);
-    }
-    handlers_[idx].handler = handler;
-    handlers_[idx].id = id;
-    handlers_[idx].mask = mask;
+    handlers_.resize(handlers_.size() + 1);
+    handlers_.back().handler = handler;
+    handlers_.back().id = id;
+    handlers_.back().mask = mask;
+    handlers_.back().shared = shared;
+    invalidate_index();
 }
 
 template<int NUM_PRIO>
@@ -378,7 +552,6 @@ DispatchFlowBase<NUM_PRIO>::unregister_handler(UntypedHandler *handler,
                                                ID id, ID mask)
 {
     OSMutexLock h(&lock_);
-    /// @todo(balazs.racz) optimize by looking at the current index - 1.
     size_t idx = 0;
     while (idx < handlers_.size() && !handlers_[idx].Equals(id, mask, handler))
     {
@@ -390,11 +563,9 @@ DispatchFlowBase<NUM_PRIO>::unregister_handler(UntypedHandler *handler,
     if (lastHandlerToCall_ == handlers_[idx].handler) {
         lastHandlerToCall_ = nullptr;
     }
-    handlers_[idx].handler = nullptr;
-    if (idx == handlers_.size() - 1)
-    {
-        handlers_.resize(handlers_.size() - 1);
-    }
+    handlers_.erase(handlers_.begin() + idx);
+    tombstone(id, mask, handler, false);
+    invalidate_index();
 }
 
 template<int NUM_PRIO>
@@ -402,23 +573,126 @@ void DispatchFlowBase<NUM_PRIO>::unregister_handler_all(
     UntypedHandler *handler)
 {
     OSMutexLock h(&lock_);
-    for (size_t i = 0; i < handlers_.size(); ++i)
+    handlers_.erase(std::remove_if(handlers_.begin(), handlers_.end(),
+                        [handler](const HandlerInfo &i) {
+                            return i.handler.load(std::memory_order_relaxed) ==
+                                handler;
+                        }),
+        handlers_.end());
+    tombstone(0, 0, handler, true);
+    invalidate_index();
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::tombstone(
+    ID id, ID mask, UntypedHandler *handler, bool all)
+{
+    if (!index_)
     {
-        if (handlers_[i].handler == handler)
+        return;
+    }
+    for (auto &e : index_->entries)
+    {
+        if (all ? e.handler.load(std::memory_order_relaxed) == handler
+                : e.Equals(id, mask, handler))
         {
-            handlers_[i].handler = nullptr;
+            e.handler.store(nullptr, std::memory_order_release);
+            if (!all)
+            {
+                return;
+            }
         }
     }
-    while (!handlers_.empty() && handlers_.back().handler == nullptr)
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::publish_index()
+{
+    MatchIndex *n = new MatchIndex;
+    n->entries.reserve(handlers_.size());
+    // Collects the distinct masks in the order of first registration.
+    vector<ID> masks;
+    for (const auto &h : handlers_)
     {
-        handlers_.pop_back();
+        if (std::find(masks.begin(), masks.end(), h.mask) == masks.end())
+        {
+            masks.push_back(h.mask);
+        }
     }
+    n->groups.resize(masks.size());
+    for (size_t gi = 0; gi < masks.size(); ++gi)
+    {
+        auto &g = n->groups[gi];
+        ID mask = masks[gi];
+        g.mask = mask;
+        g.first = n->entries.size();
+        for (const auto &h : handlers_)
+        {
+            if (h.mask == mask)
+            {
+                n->entries.push_back(h);
+            }
+        }
+        g.end = n->entries.size();
+        std::stable_sort(n->entries.begin() + g.first,
+            n->entries.begin() + g.end,
+            [mask](const HandlerInfo &a, const HandlerInfo &b) {
+                return (a.id & mask) < (b.id & mask);
+            });
+        // Sizes the hash table to at least twice the number of distinct keys.
+        unsigned num_keys = 0;
+        for (uint32_t i = g.first; i < g.end; ++i)
+        {
+            if (i == g.first ||
+                (n->entries[i].id & mask) != (n->entries[i - 1].id & mask))
+            {
+                ++num_keys;
+            }
+        }
+        g.bucketBits = 1;
+        while ((1u << g.bucketBits) < 2 * num_keys)
+        {
+            ++g.bucketBits;
+        }
+        g.bucketOffset = n->buckets.size();
+        n->buckets.resize(
+            n->buckets.size() + (1u << g.bucketBits), MatchIndex::EMPTY_BUCKET);
+        uint32_t bmask = (1u << g.bucketBits) - 1;
+        for (uint32_t i = g.first; i < g.end; ++i)
+        {
+            ID key = n->entries[i].id & mask;
+            if (i != g.first && key == (n->entries[i - 1].id & mask))
+            {
+                continue;
+            }
+            uint32_t b = MatchIndex::bucket(key, g.bucketBits);
+            while (n->buckets[g.bucketOffset + b] != MatchIndex::EMPTY_BUCKET)
+            {
+                b = (b + 1) & bmask;
+            }
+            n->buckets[g.bucketOffset + b] = i;
+        }
+    }
+    delete index_;
+    index_ = n;
 }
 
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::entry()
 {
+    if (indexStale_.load(std::memory_order_acquire))
+    {
+        // Registrations changed since the last message. No message is being
+        // dispatched now, so the old index can be freed right away.
+        OSMutexLock h(&lock_);
+        indexStale_.store(false, std::memory_order_relaxed);
+        publish_index();
+    }
+    readIndex_ = index_;
+    currentGroup_ = 0;
     currentIndex_ = 0;
+    currentEnd_ = 0;
+    numSharedSent_ = 0;
     lastHandlerToCall_ = nullptr;
     return call_immediately(STATE(iterate));
 }
@@ -426,49 +700,80 @@ StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::entry()
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::iterate()
 {
+    if (!readIndex_)
+    {
+        return iteration_done();
+    }
+    const MatchIndex &idx = *readIndex_;
     ID id = get_message_id();
+    while (true)
     {
-        // @todo(balazs.racz) make the registered handlers structure for the
-        // dispatcher lock-free. This mutex here is very expensive.
-        OSMutexLock l(&lock_);
-        for (; currentIndex_ < handlers_.size(); ++currentIndex_)
+        if (currentIndex_ >= currentEnd_)
         {
-            auto &h = handlers_[currentIndex_];
-            if (!h.handler)
+            // Moves on to the next mask group.
+            if (currentGroup_ >= idx.groups.size())
             {
-                continue;
+                break;
             }
-            if (negateMatch_ && (id & h.mask) == (h.id & h.mask))
+            const auto &g = idx.groups[currentGroup_++];
+            currentEnd_ = g.end;
+            if (negateMatch_)
             {
-                continue;
+                currentIndex_ = g.first;
             }
-            if ((!negateMatch_) && (id & h.mask) != (h.id & h.mask))
+            else
             {
-                continue;
+                currentIndex_ = idx.find(g, id & g.mask);
             }
-            // At this point: we have another handler.
-            if (!lastHandlerToCall_)
-            {
-                // This was the first we found.
-                lastHandlerToCall_ = handlers_[currentIndex_].handler;
-                continue;
-            }            
-            break;
+            continue;
         }
+        auto &h = idx.entries[currentIndex_];
+        bool match = (id & h.mask) == (h.id & h.mask);
+        if (!negateMatch_ && !match)
+        {
+            // End of the run of equal keys.
+            currentIndex_ = currentEnd_;
+            continue;
+        }
+        UntypedHandler *handler = h.handler.load(std::memory_order_acquire);
+        if ((negateMatch_ && match) || !handler)
+        {
+            ++currentIndex_;
+            continue;
+        }
+        // At this point: we have another handler.
+        if (h.shared)
+        {
+            send_shared_ref(handler);
+            ++numSharedSent_;
+            ++currentIndex_;
+            continue;
+        }
+        if (!lastHandlerToCall_)
+        {
+            // This was the first we found.
+            lastHandlerToCall_ = handler;
+            ++currentIndex_;
+            continue;
+        }
+        // Now: we have at least two different handler. We need to clone the
+        // message. We use the pool of the last handler to call by default.
+        return allocate_and_clone();
     }
-    if (currentIndex_ >= handlers_.size())
-    {
-        return iteration_done();
-    }
-    // Now: we have at least two different handler. We need to clone the
-    // message. We use the pool of the last handler to call by default.
-    return allocate_and_clone();
+    return iteration_done();
 }
 
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::clone_done()
 {
-    lastHandlerToCall_ = handlers_[currentIndex_].handler;
+    if (cloneForLast_)
+    {
+        cloneForLast_ = false;
+        lastHandlerToCall_ = nullptr;
+        return call_immediately(STATE(iteration_done));
+    }
+    lastHandlerToCall_ = readIndex_->entries[currentIndex_].handler.load(
+        std::memory_order_acquire);
     ++currentIndex_;
     return call_immediately(STATE(iterate));
 }
@@ -476,17 +781,25 @@ StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::clone_done()
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::iteration_done()
 {
-    if (lastHandlerToCall_)
+    if (lastHandlerToCall_ && numSharedSent_)
+    {
+        // The message buffer is shared with some multicast handlers, so the
+        // exclusive handler needs its own copy.
+        cloneForLast_ = true;
+        return allocate_and_clone();
+    }
+    else if (lastHandlerToCall_)
     {
         send_transfer();
     }
-    else if (fallbackHandler_)
+    else if (fallbackHandler_ && !numSharedSent_)
     {
         // Nothing handled this message, and we have a fallbac handler
         // registered. Gives the message to the fallback handler.
         lastHandlerToCall_ = fallbackHandler_;
         send_transfer();
     }
+    readIndex_ = nullptr;
     return release_and_exit();
 }
 
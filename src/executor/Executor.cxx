@@ -46,6 +46,12 @@
 #include <sys/select.h>
 #endif
 
+#if OPENMRN_HAVE_EPOLL
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#endif
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
@@ -77,10 +83,15 @@ ExecutorBase::ExecutorBase()
     , started_(0)
     , selectPrescaler_(0)
 {
+#if OPENMRN_HAVE_EPOLL
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    HASSERT(epollFd_ >= 0);
+#else
     FD_ZERO(&selectRead_);
     FD_ZERO(&selectWrite_);
     FD_ZERO(&selectExcept_);
     selectNFds_ = 0;
+#endif
 }
 
 /** Lookup an executor by its name.
@@ -329,6 +340,160 @@ void *ExecutorBase::entry()
     return NULL;
 }
 
+#if OPENMRN_HAVE_EPOLL
+
+void ExecutorBase::select(Selectable *job)
+{
+    unsigned fd = job->fd_;
+    if (fd >= epollEntries_.size())
+    {
+        epollEntries_.resize(fd + 1);
+    }
+    Selectable *&slot = epollEntries_[fd].sel_[job->selectType_ - 1];
+    if (slot)
+    {
+        LOG(FATAL,
+            "Multiple Selectables are waiting for the same fd %d type %u", fd,
+            job->selectType_);
+    }
+    HASSERT(!job->next);
+    slot = job;
+    epoll_update(fd);
+}
+
+bool ExecutorBase::is_selected(Selectable *job)
+{
+    unsigned fd = job->fd_;
+    return fd < epollEntries_.size() &&
+        epollEntries_[fd].sel_[job->selectType_ - 1];
+}
+
+void ExecutorBase::unselect(Selectable *job)
+{
+    unsigned fd = job->fd_;
+    if (!is_selected(job))
+    {
+        LOG(FATAL, "Tried to remove a non-active selectable: fd %d type %u", fd,
+            job->selectType_);
+    }
+    epollEntries_[fd].sel_[job->selectType_ - 1] = nullptr;
+    epoll_update(fd);
+}
+
+void ExecutorBase::epoll_update(unsigned fd)
+{
+    EpollEntry &e = epollEntries_[fd];
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (e.sel_[Selectable::READ - 1])
+    {
+        ev.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (e.sel_[Selectable::WRITE - 1])
+    {
+        ev.events |= EPOLLOUT;
+    }
+    if (e.sel_[Selectable::EXCEPT - 1])
+    {
+        ev.events |= EPOLLPRI;
+    }
+    if (ev.events == e.registered_)
+    {
+        return;
+    }
+    ev.data.fd = fd;
+    int ret;
+    if (!ev.events)
+    {
+        // Fails if the fd was closed in the meantime, which has already
+        // removed it from the epoll set.
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);
+        e.registered_ = 0;
+        return;
+    }
+    else if (e.registered_)
+    {
+        ret = epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+        if (ret < 0 && errno == ENOENT)
+        {
+            // The fd was closed and reopened since we registered it.
+            ret = epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+    else
+    {
+        ret = epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+        if (ret < 0 && errno == EEXIST)
+        {
+            // A previous DEL was skipped due to a close; the kernel still
+            // has the registration.
+            ret = epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+    if (ret == 0)
+    {
+        e.registered_ = ev.events;
+        return;
+    }
+    // The fd does not support epoll (EPERM), or it is invalid. ::select
+    // would report such an fd as ready, thus the callers will find out
+    // about the error when they try to use the fd.
+    LOG(VERBOSE, "epoll_ctl failed for fd %u: %s", fd, strerror(errno));
+    e.registered_ = 0;
+    for (auto *&sel : e.sel_)
+    {
+        if (sel)
+        {
+            add(sel->wakeup_, sel->priority_);
+            sel = nullptr;
+        }
+    }
+}
+
+void ExecutorBase::wait_with_select(long long wait_length)
+{
+    // We will check the queue for any prior wakeups after this call. If we
+    // already processed the executables, the wakeup is not necessary. Without
+    // this clear, there would always be two select() iterations happening when
+    // we are done with work and can go to sleep.
+    selectHelper_.clear_wakeup();
+    if (!empty())
+    {
+        wait_length = 0;
+    }
+    long long max_sleep = MSEC_TO_NSEC(config_executor_max_sleep_msec());
+    if (wait_length > max_sleep)
+    {
+        wait_length = max_sleep;
+    }
+    struct epoll_event events[32];
+    int ret = selectHelper_.epoll_wait(
+        epollFd_, events, ARRAYSIZE(events), wait_length);
+    // These are the conditions under which ::select would report the fd in
+    // the read, write and except set, respectively.
+    static const uint32_t masks[3] = {
+        EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR, //
+        EPOLLOUT | EPOLLHUP | EPOLLERR,             //
+        EPOLLPRI | EPOLLHUP | EPOLLERR};
+    for (int i = 0; i < ret; ++i)
+    {
+        unsigned fd = events[i].data.fd;
+        EpollEntry &e = epollEntries_[fd];
+        for (unsigned t = 0; t < 3; ++t)
+        {
+            Selectable *sel = e.sel_[t];
+            if (sel && (events[i].events & masks[t]))
+            {
+                add(sel->wakeup_, sel->priority_);
+                e.sel_[t] = nullptr;
+            }
+        }
+        epoll_update(fd);
+    }
+}
+
+#else
+
 void ExecutorBase::select(Selectable *job)
 {
     fd_set *s = get_select_set(job->type());
@@ -425,6 +590,8 @@ void ExecutorBase::wait_with_select(long long wait_length)
     selectNFds_ = max_fd;
 }
 
+#endif // OPENMRN_HAVE_EPOLL
+
 #endif
 
 #if defined(ARDUINO)
@@ -458,4 +625,7 @@ ExecutorBase::~ExecutorBase()
     {
         shutdown();
     }
+#if OPENMRN_HAVE_EPOLL
+    ::close(epollFd_);
+#endif
 }
@@ -38,6 +38,7 @@
 
 #include <functional>
 #include <atomic>
+#include <vector>
 
 #include "executor/Executable.hxx"
 #include "executor/Notifiable.hxx"
@@ -192,6 +193,24 @@ private:
      * @param next_timer_nsec is the maximum time to sleep in nanoseconds. */
     void wait_with_select(long long next_timer_nsec);
 
+#if OPENMRN_HAVE_EPOLL
+    /// Brings the epoll registration of a file descriptor in sync with the
+    /// Selectables waiting for it. If the fd cannot be waited upon with
+    /// epoll (e.g. a regular file), the waiting Selectables are triggered
+    /// immediately, which is what ::select would do.
+    ///
+    /// @param fd file descriptor whose Selectables changed.
+    void epoll_update(unsigned fd);
+
+    /// Selectables waiting for a given file descriptor.
+    struct EpollEntry
+    {
+        /// Selectable for READ, WRITE and EXCEPT (indexed by type - 1).
+        Selectable *sel_[3] {nullptr, nullptr, nullptr};
+        /// Events the fd is currently registered with in the epoll set.
+        uint32_t registered_ {0};
+    };
+#else
     /// Helper function.
     ///
     /// @param type a select type: READ, WRITE or EXCEPT
@@ -209,6 +228,7 @@ private:
         LOG(FATAL, "Unexpected select type %d", type);
         return nullptr;
     }
+#endif
 
     /** name of this Executor */
     const char *name_;
@@ -219,6 +239,12 @@ private:
     /** List of active timers. */
     ActiveTimers activeTimers_;
 
+#if OPENMRN_HAVE_EPOLL
+    /** epoll instance that the executor sleeps on. */
+    int epollFd_;
+    /** Selectables waiting, indexed by file descriptor. */
+    std::vector<EpollEntry> epollEntries_;
+#else
     /** fd to select for read. */
     fd_set selectRead_;
     /** fd to select for write. */
@@ -229,6 +255,7 @@ private:
     int selectNFds_;
     /** Head of the linked list for the select calls. */
     TypedQueue<Selectable> selectables_;
+#endif
 
     /** Set to 1 when the executor thread has exited and it is safe to delete
      * *this. */
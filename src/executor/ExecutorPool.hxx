@@ -0,0 +1,389 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file ExecutorPool.hxx
+ *
+ * An executor that runs its executables on multiple threads.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#ifndef _EXECUTOR_EXECUTORPOOL_HXX_
+#define _EXECUTOR_EXECUTORPOOL_HXX_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "executor/Executor.hxx"
+#include "nmranet_config.h"
+
+/// An executor with multiple worker threads. Services (and the state flows
+/// in them) can be created on an ExecutorPool the same way as on an
+/// Executor; their executables will then run on whichever worker thread is
+/// free.
+///
+/// Each worker thread has its own queue (one priority band per NUM_PRIO).
+/// Executables added from a worker thread go to the queue of that worker;
+/// executables added from elsewhere are spread across the queues. A worker
+/// that runs out of work steals from the queues of the other workers.
+///
+/// A given Executable never runs on two threads at the same time: when an
+/// executable is added while it is running (e.g. a state flow gets notified
+/// before its state function returned), it is enqueued on the worker that is
+/// running it, and the other workers will not steal it from there. This means
+/// that code written for a single-threaded Executor, in particular
+/// StateFlowBase, remains correct, as long as the different flows do not
+/// share unprotected data.
+///
+/// The first worker thread also runs the timers and the select() loop of the
+/// pool. select() and unselect() may only be called from that thread; flows
+/// doing file I/O via Selectables should use a regular Executor.
+template <unsigned NUM_PRIO> class ExecutorPool : public ExecutorBase
+{
+public:
+    /// Constructor.
+    ///
+    /// @param name name of the executor threads
+    /// @param num_threads how many worker threads to run, at least 1.
+    /// @param priority thread priority
+    /// @param stack_size thread stack size
+    ExecutorPool(const char *name, unsigned num_threads, int priority,
+        size_t stack_size)
+    {
+        HASSERT(num_threads >= 1);
+        for (unsigned i = 0; i < num_threads; ++i)
+        {
+            lanes_.emplace_back(new Lane(this, i));
+        }
+        runningWorkers_ = num_threads - 1;
+        for (unsigned i = 1; i < num_threads; ++i)
+        {
+            lanes_[i]->worker_.start(name, priority, stack_size);
+        }
+        OSThread::start(name, priority, stack_size);
+    }
+
+    /// Destructor. Stops all worker threads.
+    ~ExecutorPool()
+    {
+        exiting_ = true;
+        for (unsigned i = 1; i < lanes_.size(); ++i)
+        {
+            lanes_[i]->sem_.post();
+        }
+        while (runningWorkers_)
+        {
+            usleep(100);
+        }
+        shutdown();
+    }
+
+    /// @return how many worker threads this pool has.
+    unsigned num_threads()
+    {
+        return lanes_.size();
+    }
+
+    /** Send a message to this Executor's queue.
+     * @param msg Executable instance to insert into the input queue
+     * @param priority priority of message
+     */
+    void add(Executable *msg, unsigned priority = UINT_MAX) override
+    {
+        if (priority >= NUM_PRIO)
+        {
+            priority = NUM_PRIO - 1;
+        }
+        unsigned n = lanes_.size();
+        unsigned target = n;
+        for (unsigned i = 0; i < n; ++i)
+        {
+            if (running(i) == msg)
+            {
+                // The worker running it will pick it up when it's done; no
+                // one else may run it.
+                lanes_[i]->queue_.insert(msg, priority);
+                return;
+            }
+        }
+        bool from_owner = false;
+        if (msg == static_cast<Executable *>(this))
+        {
+            // Shutdown request for the first worker.
+            target = 0;
+        }
+        else
+        {
+            os_thread_t self = os_thread_self();
+            for (unsigned i = 0; i < n; ++i)
+            {
+                if (thread_of(i) == self)
+                {
+                    target = i;
+                    from_owner = true;
+                    break;
+                }
+            }
+            if (target == n)
+            {
+                // The first worker is also busy with timers and select, thus
+                // it gets only the work it generates itself.
+                target = n > 1 ? 1 + nextLane_++ % (n - 1) : 0;
+            }
+        }
+        lanes_[target]->queue_.insert(msg, priority);
+        wakeup(target, from_owner);
+    }
+
+#if OPENMRN_FEATURE_RTOS_FROM_ISR
+    /** Send a message to this Executor's queue. Callable from interrupt
+     * context.
+     * @param msg Executable instance to insert into the input queue
+     * @param priority priority of message
+     */
+    void add_from_isr(Executable *msg, unsigned priority = UINT_MAX) override
+    {
+        lanes_[0]->queue_.insert_locked(
+            msg, priority >= NUM_PRIO ? NUM_PRIO - 1 : priority);
+        selectHelper_.wakeup_from_isr();
+    }
+#endif // OPENMRN_FEATURE_RTOS_FROM_ISR
+
+    /// @return true if there are no executables waiting on any of the threads
+    /// to be executed. There could still be executables running.
+    bool empty() override
+    {
+        for (auto &l : lanes_)
+        {
+            if (!l->queue_.empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t sequence() override
+    {
+        return sequence_;
+    }
+
+private:
+    /// Thread object for the workers other than the first.
+    class Worker : public OSThread
+    {
+    public:
+        /// Constructor. @param parent owning pool. @param index which lane
+        /// this worker serves.
+        Worker(ExecutorPool *parent, unsigned index)
+            : parent_(parent)
+            , index_(index)
+        {
+        }
+
+    private:
+        void *entry() override
+        {
+            parent_->worker_loop(index_);
+            return nullptr;
+        }
+
+        /// Owning pool.
+        ExecutorPool *parent_;
+        /// Lane index.
+        unsigned index_;
+    };
+
+    /// Per-thread state of the pool.
+    struct Lane
+    {
+        /// Constructor. @param parent owning pool. @param index which lane
+        /// this is.
+        Lane(ExecutorPool *parent, unsigned index)
+            : worker_(parent, index)
+        {
+        }
+
+        /// Executables waiting to be run by this worker.
+        QList<NUM_PRIO> queue_;
+        /// Executable currently running on this worker. Unused for lane 0,
+        /// which uses ExecutorBase::current().
+        std::atomic<Executable *> current_ {nullptr};
+        /// True when the worker is about to sleep or is sleeping.
+        std::atomic_bool sleeping_ {false};
+        /// The worker sleeps on this semaphore. Unused for lane 0, which
+        /// sleeps in the select call.
+        OSSem sem_;
+        /// Thread for this lane. Not started for lane 0.
+        Worker worker_;
+    };
+
+    /// @param lane index of a worker.
+    /// @return the executable running on that worker, or nullptr.
+    Executable *running(unsigned lane)
+    {
+        return lane ? lanes_[lane]->current_.load() : current();
+    }
+
+    /// @param lane index of a worker.
+    /// @return the thread handle of that worker.
+    os_thread_t thread_of(unsigned lane)
+    {
+        return lane ? lanes_[lane]->worker_.get_handle() : thread_handle();
+    }
+
+    /// Wakes up the worker of a lane after an executable was added to it. If
+    /// that worker is busy, wakes up an idle worker, which will steal the
+    /// work.
+    /// @param lane the lane where a new executable is waiting.
+    /// @param from_owner true if the executable was added by the worker of
+    /// that lane, i.e. the worker is known to be busy.
+    void wakeup(unsigned lane, bool from_owner)
+    {
+        if (!from_owner)
+        {
+            if (lane == 0)
+            {
+                selectHelper_.wakeup();
+                return;
+            }
+            if (lanes_[lane]->sleeping_)
+            {
+                lanes_[lane]->sem_.post();
+                return;
+            }
+        }
+        for (unsigned i = 1; i < lanes_.size(); ++i)
+        {
+            if (i != lane && lanes_[i]->sleeping_)
+            {
+                lanes_[i]->sem_.post();
+                return;
+            }
+        }
+        if (lane != 0)
+        {
+            selectHelper_.wakeup();
+        }
+    }
+
+    /// Takes the next executable to run for a given worker: from its own
+    /// queue, or stolen from another worker.
+    /// @param lane index of the worker.
+    /// @param priority will be set to the priority of the executable.
+    /// @return the executable to run, or nullptr if there is no work.
+    Executable *take(unsigned lane, unsigned *priority)
+    {
+        unsigned n = lanes_.size();
+        auto r = lanes_[lane]->queue_.next();
+        if (r.item)
+        {
+            *priority = r.index;
+            return static_cast<Executable *>(r.item);
+        }
+        for (unsigned k = 1; k < n; ++k)
+        {
+            unsigned victim = (lane + k) % n;
+            Lane *l = lanes_[victim].get();
+            if (l->queue_.empty())
+            {
+                continue;
+            }
+            AtomicHolder h(l->queue_.lock());
+            r = l->queue_.next_locked();
+            if (!r.item)
+            {
+                continue;
+            }
+            Executable *e = static_cast<Executable *>(r.item);
+            if (e == running(victim) || e == static_cast<Executable *>(this))
+            {
+                // Must stay on the victim.
+                l->queue_.insert_locked(r.item, r.index);
+                continue;
+            }
+            *priority = r.index;
+            return e;
+        }
+        return nullptr;
+    }
+
+    /// Main loop of the worker threads other than the first.
+    /// @param lane index of the worker.
+    void worker_loop(unsigned lane)
+    {
+        Lane *l = lanes_[lane].get();
+        while (!exiting_)
+        {
+            unsigned priority;
+            Executable *e = take(lane, &priority);
+            if (!e)
+            {
+                l->sleeping_ = true;
+                // Checks again, otherwise we could miss a wakeup that came
+                // before setting sleeping_.
+                e = take(lane, &priority);
+                if (!e)
+                {
+                    l->sem_.timedwait(
+                        MSEC_TO_NSEC(config_executor_max_sleep_msec()));
+                    l->sleeping_ = false;
+                    continue;
+                }
+                l->sleeping_ = false;
+            }
+            l->current_ = e;
+            e->run();
+            l->current_ = nullptr;
+        }
+        --runningWorkers_;
+    }
+
+    /** Retrieve an item for the first worker.
+     * @param priority pass back the priority of the queue pulled from
+     * @return item retrieved from queue, else NULL if none waiting.
+     */
+    Executable *next(unsigned *priority) override
+    {
+        return take(0, priority);
+    }
+
+    /// Per-worker state. Index 0 is the thread of ExecutorBase.
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    /// Round-robin counter for distributing executables added from outside
+    /// the pool.
+    std::atomic<unsigned> nextLane_ {0};
+    /// Number of worker threads (other than the first) still running.
+    std::atomic<unsigned> runningWorkers_ {0};
+    /// Set to true when the worker threads should exit.
+    std::atomic_bool exiting_ {false};
+
+    DISALLOW_COPY_AND_ASSIGN(ExecutorPool);
+};
+
+#endif // _EXECUTOR_EXECUTORPOOL_HXX_
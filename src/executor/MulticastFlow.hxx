@@ -0,0 +1,230 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file MulticastFlow.hxx
+ *
+ * Flows that can receive a shared reference to a message instead of an
+ * exclusively owned copy.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#ifndef _EXECUTOR_MULTICASTFLOW_HXX_
+#define _EXECUTOR_MULTICASTFLOW_HXX_
+
+#include "executor/StateFlow.hxx"
+
+/// A message recipient that is able to take a shared reference to a message
+/// buffer. The Buffer's own queue link is never used by such a recipient, so
+/// the same buffer can be delivered to any number of these recipients at the
+/// same time by taking a reference for each of them (see note 1 in
+/// utils/DirectHub.md).
+///
+/// The recipient must treat a shared message as read-only.
+template <class MessageType>
+class MulticastFlowInterface : public FlowInterface<MessageType>
+{
+public:
+    /// Delivers a shared message to this flow.
+    ///
+    /// @param message buffer to send to the flow. One reference is
+    /// transferred. Other owners may hold references to the same buffer;
+    /// the payload must not be modified.
+    /// @param priority which priority band the flow should process it. Lower
+    /// numbers mean process earlier.
+    virtual void send_shared(
+        MessageType *message, unsigned priority = UINT_MAX) = 0;
+};
+
+/// Queue entry for MulticastStateFlow. Points to the (shared) message.
+struct SharedMessageNode : public QMember
+{
+    /// The message buffer. Owns one reference.
+    BufferBase *payload_;
+};
+
+/// State flow with an input queue that does not use the QMember link of the
+/// incoming buffers. Each queued message is represented by a small node
+/// owned by this flow, which points to the message. Up to MAX_FREE_NODES
+/// nodes are recycled, thus in steady state enqueueing a message does not
+/// allocate memory. Nodes are never allocated or freed inside a critical
+/// section.
+///
+/// Messages arriving via send() and send_shared() are handled the same way;
+/// the flow must treat message() as read-only in both cases, and must not
+/// hand the buffer on to a regular (queue-link based) flow.
+///
+/// MessageType has to be Buffer<T>. QueueType is usually QList<N>, depending
+/// on how many priority bands are necessary.
+template <class MessageType, class QueueType>
+class MulticastStateFlow : public StateFlowWithQueue,
+                           public MulticastFlowInterface<MessageType>
+{
+public:
+    /// Constructor. @param service specifies which thread to execute this
+    /// state flow on.
+    MulticastStateFlow(Service *service)
+        : StateFlowWithQueue(service)
+    {
+    }
+
+    /// How many unused queue nodes are kept for reuse at most.
+    static constexpr unsigned MAX_FREE_NODES = 8;
+
+    ~MulticastStateFlow()
+    {
+        while (auto *n = static_cast<SharedMessageNode *>(freeNodes_.next(0)))
+        {
+            delete n;
+        }
+    }
+
+    /// Entry point to the flow for an exclusively owned message.
+    ///
+    /// @param msg Message to enqueue
+    /// @param priority the priority at which to enqueue this message.
+    void send(MessageType *msg, unsigned priority = UINT_MAX) override
+    {
+        send_shared(msg, priority);
+    }
+
+    /// Entry point to the flow for a shared message.
+    ///
+    /// @param msg Message to enqueue. One reference is transferred.
+    /// @param priority the priority at which to enqueue this message.
+    void send_shared(MessageType *msg, unsigned priority = UINT_MAX) override
+    {
+        SharedMessageNode *n;
+        {
+            AtomicHolder h(this);
+            n = static_cast<SharedMessageNode *>(freeNodes_.next_locked().item);
+        }
+        if (!n)
+        {
+            // Allocates outside of the critical section; malloc must not be
+            // called with interrupts disabled.
+            n = new SharedMessageNode;
+        }
+        n->payload_ = msg;
+        AtomicHolder h(this);
+        queue_.insert_locked(n, priority);
+        queueSize_ = queue_.size();
+        if (isWaiting_)
+        {
+            isWaiting_ = 0;
+            set_priority(priority);
+            this->notify();
+        }
+    }
+
+    /// @return the number of queue nodes kept for reuse.
+    size_t num_free_nodes()
+    {
+        AtomicHolder h(this);
+        return freeNodes_.pending();
+    }
+
+    /// Entry into the StateFlow activity. Must eventually call
+    /// release_and_exit().
+    /// @return function pointer to next state
+    Action entry() override = 0;
+
+protected:
+    /// Unrefs the current buffer.
+    void release() override
+    {
+        if (message())
+        {
+            message()->unref();
+        }
+        currentMessage_ = nullptr;
+        trim_free_nodes();
+    }
+
+    /// Frees the recycled queue nodes above MAX_FREE_NODES. Must be called
+    /// without the lock held.
+    void trim_free_nodes()
+    {
+        while (true)
+        {
+            QMember *n;
+            {
+                AtomicHolder h(this);
+                if (freeNodes_.pending() <= MAX_FREE_NODES)
+                {
+                    return;
+                }
+                n = freeNodes_.next_locked().item;
+            }
+            delete static_cast<SharedMessageNode *>(n);
+        }
+    }
+
+    /// @return the current message we are processing. Read-only.
+    MessageType *message()
+    {
+        return static_cast<MessageType *>(StateFlowWithQueue::message());
+    }
+
+    /// Takes the front entry in the queue. Must be called with the lock held.
+    ///
+    /// @param priority will be set to the priority of the queue member
+    /// removed from the queue.
+    /// @return the message buffer, or NULL if the queue is empty.
+    QMember *queue_next(unsigned *priority) override
+    {
+        typename QueueType::Result r = queue_.next_locked();
+        if (!r.item)
+        {
+            return nullptr;
+        }
+        *priority = r.index;
+        auto *n = static_cast<SharedMessageNode *>(r.item);
+        BufferBase *payload = n->payload_;
+        n->payload_ = nullptr;
+        // The free list may grow above MAX_FREE_NODES here; it is trimmed in
+        // release(), outside of the critical section.
+        freeNodes_.insert_locked(n);
+        return payload;
+    }
+
+    /// @return true if this StateFlow does not have any messages pending in
+    /// the queue.
+    bool queue_empty() override
+    {
+        AtomicHolder h(this);
+        return queue_.empty();
+    }
+
+private:
+    /// Queue of SharedMessageNode pointing to the pending messages.
+    QueueType queue_;
+    /// Recycled queue nodes. Trimmed to MAX_FREE_NODES entries.
+    Q freeNodes_;
+};
+
+#endif // _EXECUTOR_MULTICASTFLOW_HXX_
@@ -94,6 +94,21 @@ StateFlowBase::Action StateFlowWithQueue::wait_for_message()
     }
 }
 
+bool StateFlowWithQueue::release_and_take_next()
+{
+    release();
+    AtomicHolder h(this);
+    unsigned priority;
+    currentMessage_ = static_cast<BufferBase *>(queue_next(&priority));
+    if (!currentMessage_)
+    {
+        return false;
+    }
+    currentPriority_ = priority;
+    queueSize_--;
+    return true;
+}
+
 void StateFlowBase::notify()
 {
     service()->executor()->add(this);
@@ -1032,6 +1032,15 @@ protected:
         return exit();
     }
 
+    /** Frees the current message and takes the next one from the queue
+     * without going through the executor. This allows a flow to work through
+     * a batch of messages that need very little processing each. It bypasses
+     * the priority scheduling of the executor, thus the batches should be
+     * kept short.
+     * @return true if there is a new current message; false if the queue was
+     * empty, in which case the flow should return exit(). */
+    bool release_and_take_next();
+
     /// @returns the current message we are processing.
     BufferBase *message()
     {
@@ -1100,6 +1109,7 @@ private:
 
     template <class Q> friend class UntypedStateFlow;
     template <class M, class B> friend class TypedStateFlow;
+    template <class M, class Q> friend class MulticastStateFlow;
     friend class GlobalEventFlow;
 
     /// Largest acceptable priority value for a stateflow.
@@ -36,6 +36,8 @@
 #include "executor/Executor.hxx"
 #include "os/os.h"
 
+#include <algorithm>
+
 Timer::~Timer()
 {
     HASSERT(!isActive_);
@@ -81,6 +83,300 @@ void ActiveTimers::run()
     // call.
 }
 
+#if OPENMRN_FEATURE_TIMER_WHEEL
+
+long long ActiveTimers::get_next_timeout()
+{
+    OSMutexLock l(&lock_);
+
+    long long now = OSTime::get_monotonic();
+    if (advance_locked(now))
+    {
+        return 0;
+    }
+    long long next = next_wakeup_locked();
+    if (next != INT64_MAX)
+    {
+        return next - now;
+    }
+    else
+    {
+        // Wakes up the timer service every now and then. It won't make any
+        // difference.
+        return SEC_TO_NSEC(3600);
+    }
+}
+
+bool ActiveTimers::empty()
+{
+    OSMutexLock l(&lock_);
+    for (auto o : occupied_)
+    {
+        if (o)
+        {
+            return false;
+        }
+    }
+    return slots_[OVERFLOW_SLOT] == nullptr;
+}
+
+void ActiveTimers::schedule_timer(Timer *timer)
+{
+    OSMutexLock l(&lock_);
+    insert_locked(timer);
+}
+
+void ActiveTimers::insert_locked(Timer *timer)
+{
+    HASSERT(timer);
+    HASSERT(timer->next == nullptr);
+    HASSERT(timer->prev_ == nullptr);
+
+    link_locked(timer);
+
+    // This will wake up the executor, which will schedule all expired timers
+    // and recompute sleep length.
+    notify();
+}
+
+void ActiveTimers::remove_locked(Timer *timer)
+{
+    HASSERT(timer);
+    HASSERT(timer->prev_ && *timer->prev_ == timer);
+    unlink_locked(timer);
+}
+
+void ActiveTimers::link_locked(Timer *timer)
+{
+    long long tick = timer->when_ >> TICK_SHIFT;
+    unsigned slot;
+    if (tick <= currentTick_)
+    {
+        // Already due, goes to the slot that is checked next.
+        slot = currentTick_ & SLOT_MASK;
+    }
+    else
+    {
+        unsigned long long diff = tick ^ currentTick_;
+        unsigned level = 0;
+        while (level < NUM_LEVELS && (diff >> (LEVEL_BITS * (level + 1))))
+        {
+            ++level;
+        }
+        if (level >= NUM_LEVELS)
+        {
+            slot = OVERFLOW_SLOT;
+        }
+        else
+        {
+            slot = level * NUM_SLOTS +
+                ((tick >> (LEVEL_BITS * level)) & SLOT_MASK);
+        }
+    }
+    timer->wheelSlot_ = slot;
+    timer->next = slots_[slot];
+    if (timer->next)
+    {
+        static_cast<Timer *>(timer->next)->prev_ = &timer->next;
+    }
+    timer->prev_ = &slots_[slot];
+    slots_[slot] = timer;
+    if (slot < OVERFLOW_SLOT)
+    {
+        occupied_[slot / NUM_SLOTS] |= UINT64_C(1) << (slot & SLOT_MASK);
+    }
+    if (wakeupValid_ && timer->when_ < nextWakeup_)
+    {
+        nextWakeup_ = timer->when_;
+        wakeupSlot_ = slot;
+    }
+}
+
+void ActiveTimers::unlink_locked(Timer *timer)
+{
+    *timer->prev_ = timer->next;
+    if (timer->next)
+    {
+        static_cast<Timer *>(timer->next)->prev_ = timer->prev_;
+    }
+    unsigned slot = timer->wheelSlot_;
+    if (slot == wakeupSlot_)
+    {
+        // The removed timer might have been the earliest one.
+        wakeupValid_ = false;
+    }
+    if (!slots_[slot] && slot < OVERFLOW_SLOT)
+    {
+        occupied_[slot / NUM_SLOTS] &= ~(UINT64_C(1) << (slot & SLOT_MASK));
+    }
+    timer->next = nullptr;
+    timer->prev_ = nullptr;
+}
+
+bool ActiveTimers::expire_slot_locked(unsigned slot, long long now)
+{
+    // Collects the due timers sorted by expiry time. Timers with equal expiry
+    // time are kept in the order they were scheduled. Since the slot lists
+    // are LIFO, this is usually O(1) per timer.
+    QMember *due = nullptr;
+    Timer *current_timer = static_cast<Timer *>(slots_[slot]);
+    while (current_timer)
+    {
+        Timer *t = current_timer;
+        current_timer = static_cast<Timer *>(t->next);
+        if (t->when_ > now)
+        {
+            continue;
+        }
+        unlink_locked(t);
+        QMember **last = &due;
+        while (*last && static_cast<Timer *>(*last)->when_ < t->when_)
+        {
+            last = &((*last)->next);
+        }
+        t->next = *last;
+        *last = t;
+    }
+    if (!due)
+    {
+        return false;
+    }
+    while (due)
+    {
+        Timer *t = static_cast<Timer *>(due);
+        due = t->next;
+        t->next = nullptr;
+        t->isActive_ = 0;
+        t->isExpired_ = 1;
+        // Puts it on the executor.
+        executor_->add(t, t->priority_);
+    }
+    return true;
+}
+
+void ActiveTimers::cascade_locked()
+{
+    for (unsigned level = 1; level <= NUM_LEVELS; ++level)
+    {
+        long long level_mask = (1LL << (LEVEL_BITS * level)) - 1;
+        if (currentTick_ & level_mask)
+        {
+            // Not at the beginning of a slot on this level.
+            return;
+        }
+        unsigned slot = level == NUM_LEVELS
+            ? OVERFLOW_SLOT
+            : level * NUM_SLOTS +
+                ((currentTick_ >> (LEVEL_BITS * level)) & SLOT_MASK);
+        QMember *current = slots_[slot];
+        if (!current)
+        {
+            continue;
+        }
+        slots_[slot] = nullptr;
+        if (slot < OVERFLOW_SLOT)
+        {
+            occupied_[level] &= ~(UINT64_C(1) << (slot & SLOT_MASK));
+        }
+        wakeupValid_ = false;
+        while (current)
+        {
+            Timer *t = static_cast<Timer *>(current);
+            current = t->next;
+            t->next = nullptr;
+            t->prev_ = nullptr;
+            link_locked(t);
+        }
+    }
+}
+
+bool ActiveTimers::advance_locked(long long now)
+{
+    long long now_tick = now >> TICK_SHIFT;
+    if (now_tick < currentTick_)
+    {
+        // Time went backwards; checks the current slot only.
+        now_tick = currentTick_;
+    }
+    bool found_timer = false;
+    while (true)
+    {
+        // Expires the level 0 slots from the current tick to the end of the
+        // current level 0 round (or until now).
+        long long round_end = currentTick_ | SLOT_MASK;
+        long long last = std::min(now_tick, round_end);
+        uint64_t pending = occupied_[0] >> (currentTick_ & SLOT_MASK);
+        pending <<= (currentTick_ & SLOT_MASK);
+        pending &= (UINT64_C(2) << (last & SLOT_MASK)) - 1;
+        while (pending)
+        {
+            unsigned slot = __builtin_ctzll(pending);
+            pending &= pending - 1;
+            found_timer |= expire_slot_locked(slot, now);
+        }
+        if (last == now_tick)
+        {
+            currentTick_ = now_tick;
+            return found_timer;
+        }
+        // Level 0 is empty now. Jumps to the beginning of the next non-empty
+        // slot on a higher level, or to now if that is earlier.
+        long long next_tick = round_end + 1;
+        long long target = now_tick;
+        for (unsigned level = 1; level < NUM_LEVELS; ++level)
+        {
+            unsigned shift = LEVEL_BITS * level;
+            uint64_t bits =
+                occupied_[level] >> ((next_tick >> shift) & SLOT_MASK);
+            if (!bits)
+            {
+                continue;
+            }
+            long long start = (next_tick >> shift) + __builtin_ctzll(bits);
+            target = std::min(target, start << shift);
+            break;
+        }
+        if (slots_[OVERFLOW_SLOT])
+        {
+            unsigned shift = LEVEL_BITS * NUM_LEVELS;
+            long long start = ((next_tick - 1) >> shift) + 1;
+            target = std::min(target, start << shift);
+        }
+        currentTick_ = target;
+        cascade_locked();
+    }
+}
+
+long long ActiveTimers::next_wakeup_locked()
+{
+    if (wakeupValid_)
+    {
+        return nextWakeup_;
+    }
+    // The earliest timer is in the first non-empty slot of the lowest
+    // non-empty level.
+    unsigned slot = OVERFLOW_SLOT;
+    for (unsigned level = 0; level < NUM_LEVELS; ++level)
+    {
+        if (occupied_[level])
+        {
+            slot = level * NUM_SLOTS + __builtin_ctzll(occupied_[level]);
+            break;
+        }
+    }
+    nextWakeup_ = INT64_MAX;
+    for (QMember *current = slots_[slot]; current; current = current->next)
+    {
+        Timer *t = static_cast<Timer *>(current);
+        nextWakeup_ = std::min(nextWakeup_, t->when_);
+    }
+    wakeupSlot_ = slot;
+    wakeupValid_ = true;
+    return nextWakeup_;
+}
+
+#else
+
 long long ActiveTimers::get_next_timeout()
 {
     OSMutexLock l(&lock_);
@@ -170,6 +466,8 @@ void ActiveTimers::remove_locked(Timer *timer)
     timer->next = nullptr;
 }
 
+#endif // OPENMRN_FEATURE_TIMER_WHEEL
+
 void ActiveTimers::update_timer(Timer *timer)
 {
     HASSERT(timer);
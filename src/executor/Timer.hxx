@@ -36,6 +36,7 @@
 #define _EXECUTOR_TIMER_HXX_
 
 #include "executor/Notifiable.hxx"
+#include "openmrn_features.h"
 #include "utils/Buffer.hxx"
 #include "utils/QMember.hxx"
 #include "os/OS.hxx"
@@ -44,7 +45,19 @@ class Timer;
 class ExecutorBase;
 
 /** Class that manages the list of active timers. The Executor uses this class
- * tightly in its sleep-execute loop. */
+ * tightly in its sleep-execute loop.
+ *
+ * When OPENMRN_FEATURE_TIMER_WHEEL is set, the timers are stored in a
+ * hierarchical timing wheel. Each level has 64 slots; a slot on level 0 is
+ * one tick (~1 msec) long, a slot on level N is 64 times longer than on level
+ * N-1. A timer is linked into the lowest level where its expiry is in the
+ * same slot of the level above as the current time; timers beyond the
+ * highest level are in an overflow list. As the time advances, the slots of
+ * higher levels are redistributed to the lower levels. Scheduling and
+ * removing a timer is O(1).
+ *
+ * Otherwise the timers are in a single linked list sorted by expiry time,
+ * which needs less memory, but scheduling is O(number of timers). */
 class ActiveTimers : public Executable
 {
 public:
@@ -55,6 +68,20 @@ public:
         : executor_(executor)
         , isPending_(0)
     {
+#if OPENMRN_FEATURE_TIMER_WHEEL
+        for (auto &s : slots_)
+        {
+            s = nullptr;
+        }
+        for (auto &o : occupied_)
+        {
+            o = 0;
+        }
+        currentTick_ = OSTime::get_monotonic() >> TICK_SHIFT;
+        nextWakeup_ = INT64_MAX;
+        wakeupSlot_ = OVERFLOW_SLOT;
+        wakeupValid_ = true;
+#endif
     }
 
     ~ActiveTimers();
@@ -75,17 +102,18 @@ public:
      * scheduled. */
     void schedule_timer(::Timer *timer);
 
-    /** Updates the expiration time of an already scheduled timer. This call is
-     * somewhat expensive, because it needs to walk the entire queue of active
-     * timers. May wake up the executor.
+    /** Updates the expiration time of an already scheduled timer. Without
+     * the timing wheel this call is somewhat expensive, because it needs to
+     * walk the entire queue of active timers. May wake up the executor.
      *
      * @param timer is the timer whose next execution time has been updated. It
      * must already be scheduled. */
     void update_timer(::Timer *timer);
 
-    /** Deletes an already scheduled but not yet expired timer. This call is
-     * somewhat expensive, because it needs to walk the entire queue of active
-     * timers. Asserts that the timer is in fact not yet expired.
+    /** Deletes an already scheduled but not yet expired timer. Without the
+     * timing wheel this call is somewhat expensive, because it needs to walk
+     * the entire queue of active timers. Asserts that the timer is in fact
+     * not yet expired.
      *
      * @param timer is the timer to delete. */
     void remove_timer(::Timer *timer);
@@ -113,12 +141,81 @@ private:
      * @param timer what to insert into the active list. */
     void insert_locked(::Timer *timer);
 
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /** Links a timer into the wheel slot matching its expiry time. Caller must
+     * hold the lock.
+     * @param timer what to link; must not be in the wheel. */
+    void link_locked(::Timer *timer);
+
+    /** Removes a timer from the wheel slot it is linked into. Caller must
+     * hold the lock.
+     * @param timer what to unlink. */
+    void unlink_locked(::Timer *timer);
+
+    /** Moves all timers of a given slot that are due to the executor, in the
+     * order of their expiry times. Caller must hold the lock.
+     * @param slot index into slots_.
+     * @param now current time in nanoseconds.
+     * @return true if any timer was expired. */
+    bool expire_slot_locked(unsigned slot, long long now);
+
+    /** Re-links the timers of the higher level slots that start at the
+     * current tick. Caller must hold the lock. */
+    void cascade_locked();
+
+    /** Advances the current tick of the wheel to the given time, expiring all
+     * timers that are due. Caller must hold the lock.
+     * @param now current time in nanoseconds.
+     * @return true if any timer was expired. */
+    bool advance_locked(long long now);
+
+    /** @return the expiry time (in nanoseconds) of the earliest timer, or
+     * INT64_MAX if there are no timers. Caller must hold the lock. */
+    long long next_wakeup_locked();
+
+    /// Constants of the timing wheel.
+    enum
+    {
+        /// One tick of the wheel is 2^TICK_SHIFT nanoseconds.
+        TICK_SHIFT = 20,
+        /// Each level has 2^LEVEL_BITS slots.
+        LEVEL_BITS = 6,
+        /// Number of slots in a level.
+        NUM_SLOTS = 1 << LEVEL_BITS,
+        /// Mask of the slot index within a level.
+        SLOT_MASK = NUM_SLOTS - 1,
+        /// How many levels the wheel has. The wheel covers 2^(TICK_SHIFT +
+        /// LEVEL_BITS * NUM_LEVELS) nanoseconds, which is about 4.9 hours.
+        NUM_LEVELS = 4,
+        /// Index of the overflow list in slots_.
+        OVERFLOW_SLOT = NUM_LEVELS * NUM_SLOTS,
+    };
+#endif
+
     /// Parent.
     ExecutorBase *executor_;
     /// Protects the timer list.
     OSMutex lock_;
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /// Heads of the timer lists in the wheel. Index is level * NUM_SLOTS +
+    /// slot; the last entry is the overflow list.
+    QMember *slots_[OVERFLOW_SLOT + 1];
+    /// One bit for each non-empty slot, for each level.
+    uint64_t occupied_[NUM_LEVELS];
+    /// The wheel has been processed up to and including this tick.
+    long long currentTick_;
+    /// Cached expiry time of the earliest timer, INT64_MAX if there are no
+    /// timers. Valid if wakeupValid_ is true.
+    long long nextWakeup_;
+    /// Slot where the earliest timer is. Removing a timer from this slot
+    /// invalidates nextWakeup_.
+    unsigned wakeupSlot_;
+    /// True if nextWakeup_ is up to date.
+    bool wakeupValid_;
+#else
     /// List of timers that are scheduled.
     QMember activeTimers_;
+#endif
     /// 1 if we in the executor's queue.
     std::atomic_uint_least8_t isPending_;
 
@@ -302,6 +399,13 @@ private:
     long long when_;
     /** period in nanoseconds for timer */
     long long period_;
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /** Points to the link in the timing wheel that points to this timer;
+     * nullptr if the timer is not in the wheel. */
+    QMember **prev_{nullptr};
+    /** Index of the timing wheel slot that the timer is linked into. */
+    uint16_t wheelSlot_{0};
+#endif
     /** true when the timer is in the active timers list */
     unsigned isActive_ : 1;
     /** True when the timer is in the pending executables list of the
@@ -104,6 +104,13 @@ void EEPROMEmulation::mount()
         }
     }
 
+    /* do we index the journal to avoid scanning it for every access */
+    if (fblock_count() * sizeof(uint16_t) <= INDEX_RAM_BUDGET)
+    {
+        index_ = new uint16_t[fblock_count()];
+        build_index();
+    }
+
     /* do we shadow_ the data in RAM to speed up reads */
     if (SHADOW_IN_RAM)
     {
@@ -115,6 +122,28 @@ void EEPROMEmulation::mount()
 
         /* turn on shadowing */
         shadowInRam_ = true;
+
+        /* the shadow serves all reads from now on */
+        delete[] index_;
+        index_ = nullptr;
+    }
+}
+
+/** Fills in the index from the slots of the active sector.
+ */
+void EEPROMEmulation::build_index()
+{
+    memset(index_, 0, fblock_count() * sizeof(uint16_t));
+    /* later slots override earlier ones */
+    for (unsigned block_index = slot_first();
+         block_index < rawBlockCount_ - availableSlots_;
+         ++block_index)
+    {
+        unsigned fblock = *block(activeSector_, block_index) >> 16;
+        if (fblock < fblock_count())
+        {
+            index_[fblock] = block_index;
+        }
     }
 }
 
@@ -130,9 +159,6 @@ void EEPROMEmulation::write(unsigned int index, const void *buf, size_t len)
     HASSERT((index + len) <= file_size());
 
     uint8_t* byte_data = (uint8_t*)buf;
-    uint8_t* shadow_data = (uint8_t*)buf;
-    unsigned shadow_index = index;
-    size_t shadow_len = len;
 
     while (len)
     {
@@ -191,11 +217,6 @@ void EEPROMEmulation::write(unsigned int index, const void *buf, size_t len)
         }
     }
 
-    if (shadowInRam_)
-    {
-        memcpy(shadow_ + shadow_index, shadow_data, shadow_len);
-    }
-
     updated_notification();
 }
 
@@ -205,6 +226,16 @@ void EEPROMEmulation::write(unsigned int index, const void *buf, size_t len)
  */
 void EEPROMEmulation::write_fblock(unsigned int index, const uint8_t data[])
 {
+    if (shadowInRam_)
+    {
+        /* an overflow below copies the other blocks from the shadow, which
+         * has to include the blocks written earlier by the same write() */
+        unsigned ofs = index * BYTES_PER_BLOCK;
+        size_t len = file_size() - ofs < BYTES_PER_BLOCK ?
+                     file_size() - ofs : BYTES_PER_BLOCK;
+        memcpy(shadow_ + ofs, data, len);
+    }
+
     if (availableSlots_)
     {
         /* still have room in this sector for at least one more write */
@@ -216,6 +247,10 @@ void EEPROMEmulation::write_fblock(unsigned int index, const uint8_t data[])
                            (data[(i * 2) + 0] << 0);
         }
         flash_program(activeSector_, rawBlockCount_ - availableSlots_, slot_data, BLOCK_SIZE);
+        if (index_)
+        {
+            index_[index] = rawBlockCount_ - availableSlots_;
+        }
         --availableSlots_;
     }
     else
@@ -251,6 +286,10 @@ void EEPROMEmulation::write_fblock(unsigned int index, const uint8_t data[])
                 if (!read_fblock(fblock, read_data))
                 {
                     /* nothing to write, this is the default "erased" value */
+                    if (index_)
+                    {
+                        index_[fblock] = 0;
+                    }
                     continue;
                 }
                 for (unsigned int i = 0; i < BLOCK_SIZE / sizeof(uint32_t); ++i)
@@ -262,8 +301,22 @@ void EEPROMEmulation::write_fblock(unsigned int index, const uint8_t data[])
             }
             /* commit the write */
             flash_program(new_sector, rawBlockCount_ - available_slots, slot_data, BLOCK_SIZE);
+            if (index_)
+            {
+                /* this block will not be read from the old sector anymore */
+                index_[fblock] = rawBlockCount_ - available_slots;
+            }
             --available_slots;
         }
+        if (index_)
+        {
+            /* a partial block at the end of the file is not moved over */
+            for (unsigned fblock = file_size() / BYTES_PER_BLOCK;
+                 fblock < fblock_count(); ++fblock)
+            {
+                index_[fblock] = 0;
+            }
+        }
         /* finalize the data move and write */
         magic[0] = MAGIC_INTACT;
         flash_program(new_sector, MAGIC_INTACT_INDEX, magic, BLOCK_SIZE);
@@ -290,6 +343,25 @@ void EEPROMEmulation::read(unsigned int offset, void *buf, size_t len)
     }
 
     uint8_t *byte_data = (uint8_t *)buf;
+
+    if (index_)
+    {
+        /* go block by block, each is found directly */
+        while (len)
+        {
+            uint8_t data[MAX_BLOCK_SIZE];
+            unsigned lsa = offset & (BYTES_PER_BLOCK - 1);
+            size_t copylen = len < (BYTES_PER_BLOCK - lsa) ?
+                             len : (BYTES_PER_BLOCK - lsa);
+            read_fblock(offset / BYTES_PER_BLOCK, data);
+            memcpy(byte_data, data + lsa, copylen);
+            offset    += copylen;
+            len       -= copylen;
+            byte_data += copylen;
+        }
+        return;
+    }
+
     memset(byte_data, 0xff, len); // default if data not found
 
     for (unsigned block_index = slot_first();
@@ -355,6 +427,24 @@ bool EEPROMEmulation::read_fblock(unsigned int index, uint8_t data[])
         }
         return false;
     }
+    else if (index_)
+    {
+        /* default data value if not found */
+        memset(data, 0xFF, BYTES_PER_BLOCK);
+
+        unsigned raw_block = index_[index];
+        if (!raw_block)
+        {
+            return false;
+        }
+        const uint32_t* address = block(activeSector_, raw_block);
+        for (unsigned int i = 0; i < BLOCK_SIZE / sizeof(uint32_t); ++i)
+        {
+            data[(i * 2) + 0] = (address[i] >> 0) & 0xFF;
+            data[(i * 2) + 1] = (address[i] >> 8) & 0xFF;
+        }
+        return true;
+    }
     else
     {
         /* default data value if not found */
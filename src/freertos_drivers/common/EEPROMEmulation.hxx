@@ -99,6 +99,14 @@ extern const char __eeprom_end;
  *  be allocated in RAM that will be pre-filled with the entire eeprom
  *  data. Dramatically speeds up reads, because reads will not have to go
  *  through the log anymore.
+ *  @param INDEX_RAM_BUDGET: maximum number of bytes of RAM to use for an index
+ *  of the journal. The index takes 2 bytes per data block, and holds for each
+ *  data block which slot of the active sector has the latest data. With the
+ *  index reads and writes do not need to scan the journal; this is
+ *  significantly cheaper than SHADOW_IN_RAM when BYTES_PER_BLOCK is large. If
+ *  the index does not fit into the budget, or the budget is 0, the journal is
+ *  scanned. When SHADOW_IN_RAM is set, the index is only used to speed up the
+ *  mount, and freed afterwards.
  *  @param file_size: The total number of bytes held by the emulated eeprom
  *  file. Reads from address 0 .. file_size - 1 will be valid. Must be smaller
  *  than half of one sector, but should be realistically about 35% of the
@@ -140,6 +148,7 @@ protected:
      */
     ~EEPROMEmulation()
     {
+        delete[] index_;
     }
 
     /** Mount the EEPROM file.  Should be called during construction of the
@@ -199,6 +208,11 @@ private:
      */
     static const bool SHADOW_IN_RAM;
 
+    /** Maximum number of bytes of RAM to use for indexing the journal. 0 to
+     * disable the index.
+     */
+    static const size_t INDEX_RAM_BUDGET;
+
 protected:
     /** magic marker for an intact block */
     static const uint32_t MAGIC_INTACT;
@@ -240,6 +254,16 @@ private:
      */
     bool read_fblock(unsigned int index, uint8_t data[]);
 
+    /** Fills in the index from the slots of the active sector. */
+    void build_index();
+
+    /** @return the number of data blocks in the file, including a partial
+     * block at the end. */
+    unsigned fblock_count()
+    {
+        return (file_size() + BYTES_PER_BLOCK - 1) / BYTES_PER_BLOCK;
+    }
+
     /** Get the next active sector pointer.
      * @return sector index for the next sector to use.
      */
@@ -327,6 +351,11 @@ protected:
     /** pointer to RAM for shadowing EEPROM. */
     uint8_t *shadow_{nullptr};
 
+    /** For each data block, the raw block index in the active sector that
+     * holds the latest data, or 0 if the block was not written. nullptr if
+     * the index is not in use. */
+    uint16_t *index_{nullptr};
+
 
     /** Default constructor.
      */
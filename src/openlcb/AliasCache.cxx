@@ -64,14 +64,18 @@ static NodeAlias resolve_notresponding(NodeAlias stored)
 extern volatile int consistency_result;
 volatile int consistency_result = 0;
 
+/// Caches with more entries than this are not checked after every operation,
+/// because the check is O(n log n).
+static constexpr size_t MAX_AUTO_CONSISTENCY_CHECK = 1000;
+
 int AliasCache::check_consistency()
 {
-    if (idMap.size() != aliasMap.size())
+    if (!aliasHash && idMap.size() != aliasMap.size())
     {
         LOG(INFO, "idmap size != aliasmap size.");
         return 1;
     }
-    if (aliasMap.size() == entries)
+    if (index_size() == entries)
     {
         if (!freeList.empty())
         {
@@ -87,7 +91,7 @@ int AliasCache::check_consistency()
             return 3;
         }
     }
-    if (aliasMap.size() == 0 && (!oldest.empty() || !newest.empty()))
+    if (index_size() == 0 && (!oldest.empty() || !newest.empty()))
     {
         LOG(INFO, "LRU head/tail elements should be null when map is empty.");
         return 4;
@@ -103,7 +107,7 @@ int AliasCache::check_consistency()
         }
         free_entries.insert(m);
     }
-    if (free_entries.size() + aliasMap.size() != entries)
+    if (free_entries.size() + index_size() != entries)
     {
         LOG(INFO, "Lost some metadata entries.");
         return 6;
@@ -124,7 +128,38 @@ int AliasCache::check_consistency()
             return 20;
         }
     }
-    if (aliasMap.size() == 0)
+    if (aliasHash)
+    {
+        size_t alias_count = 0;
+        size_t id_count = 0;
+        for (unsigned i = 0; i <= hashMask; ++i)
+        {
+            if (!aliasHash[i].empty())
+            {
+                ++alias_count;
+                if (free_entries.count(aliasHash[i].deref(this)))
+                {
+                    LOG(INFO, "Found an alias hash entry in the freelist.");
+                    return 19;
+                }
+            }
+            if (!idHash[i].empty())
+            {
+                ++id_count;
+                if (free_entries.count(idHash[i].deref(this)))
+                {
+                    LOG(INFO, "Found an id hash entry in the freelist.");
+                    return 20;
+                }
+            }
+        }
+        if (alias_count != hashCount || id_count != hashCount)
+        {
+            LOG(INFO, "Hash table sizes are incorrect.");
+            return 1;
+        }
+    }
+    if (index_size() == 0)
     {
         if (!oldest.empty())
         {
@@ -160,7 +195,7 @@ int AliasCache::check_consistency()
             return 12; // newest is free
         }
     }
-    if (aliasMap.size() == 0)
+    if (index_size() == 0)
     {
         return 0;
     }
@@ -194,7 +229,7 @@ int AliasCache::check_consistency()
             LOG(INFO, "Prev link points to newest.");
             return 18;
         }
-        if (count != aliasMap.size())
+        if (count != index_size())
         {
             LOG(INFO, "LRU link list length is incorrect.");
             return 27;
@@ -235,23 +270,23 @@ int AliasCache::check_consistency()
             continue;
         }
         auto *e = pool + i;
-        if (idMap.find(e->get_node_id()) == idMap.end())
+        if (index_find(e->get_node_id()).empty())
         {
             LOG(INFO, "Metadata ID is not in the id map.");
             return 23;
         }
-        if (idMap.find(e->get_node_id())->idx_ != i)
+        if (index_find(e->get_node_id()).idx_ != i)
         {
             LOG(INFO,
                 "Id map entry does not point back to the expected index.");
             return 24;
         }
-        if (aliasMap.find(e->alias_) == aliasMap.end())
+        if (index_find(e->alias_).empty())
         {
             LOG(INFO, "Metadata alias is not in the alias map.");
             return 25;
         }
-        if (aliasMap.find(e->alias_)->idx_ != i)
+        if (index_find(e->alias_).idx_ != i)
         {
             LOG(INFO,
                 "Alis map entry does not point back to the expected index.");
@@ -267,6 +302,15 @@ void AliasCache::clear()
 {
     idMap.clear();
     aliasMap.clear();
+    if (aliasHash)
+    {
+        for (unsigned i = 0; i <= hashMask; ++i)
+        {
+            aliasHash[i].idx_ = NONE_ENTRY;
+            idHash[i].idx_ = NONE_ENTRY;
+        }
+        hashCount = 0;
+    }
     oldest.idx_ = NONE_ENTRY;
     newest.idx_ = NONE_ENTRY;
     freeList.idx_ = NONE_ENTRY;
@@ -279,6 +323,116 @@ void AliasCache::clear()
     }
 }
 
+AliasCache::PoolIdx AliasCache::index_find(NodeAlias alias)
+{
+    if (aliasHash)
+    {
+        for (unsigned slot = hash_slot(alias);; slot = (slot + 1) & hashMask)
+        {
+            PoolIdx idx = aliasHash[slot];
+            if (idx.empty() || idx.deref(this)->alias_ == alias)
+            {
+                return idx;
+            }
+        }
+    }
+    auto it = aliasMap.find(alias);
+    if (it == aliasMap.end())
+    {
+        return PoolIdx();
+    }
+    return *it;
+}
+
+AliasCache::PoolIdx AliasCache::index_find(NodeID id)
+{
+    if (idHash)
+    {
+        for (unsigned slot = hash_slot(id);; slot = (slot + 1) & hashMask)
+        {
+            PoolIdx idx = idHash[slot];
+            if (idx.empty() || idx.deref(this)->get_node_id() == id)
+            {
+                return idx;
+            }
+        }
+    }
+    auto it = idMap.find(id);
+    if (it == idMap.end())
+    {
+        return PoolIdx();
+    }
+    return *it;
+}
+
+void AliasCache::index_insert(PoolIdx idx)
+{
+    if (!aliasHash)
+    {
+        aliasMap.insert(PoolIdx(idx));
+        idMap.insert(PoolIdx(idx));
+        return;
+    }
+    Metadata *m = idx.deref(this);
+    unsigned slot = hash_slot(m->alias_);
+    while (!aliasHash[slot].empty())
+    {
+        slot = (slot + 1) & hashMask;
+    }
+    aliasHash[slot] = idx;
+    slot = hash_slot(m->get_node_id());
+    while (!idHash[slot].empty())
+    {
+        slot = (slot + 1) & hashMask;
+    }
+    idHash[slot] = idx;
+    ++hashCount;
+}
+
+void AliasCache::index_erase(PoolIdx idx)
+{
+    Metadata *m = idx.deref(this);
+    if (!aliasHash)
+    {
+        aliasMap.erase(aliasMap.find(m->alias_));
+        idMap.erase(idMap.find(m->get_node_id()));
+        return;
+    }
+    unsigned slot = hash_slot(m->alias_);
+    while (aliasHash[slot].idx_ != idx.idx_)
+    {
+        slot = (slot + 1) & hashMask;
+    }
+    hash_erase(aliasHash, slot);
+    slot = hash_slot(m->get_node_id());
+    while (idHash[slot].idx_ != idx.idx_)
+    {
+        slot = (slot + 1) & hashMask;
+    }
+    hash_erase(idHash, slot);
+    --hashCount;
+}
+
+void AliasCache::hash_erase(PoolIdx *table, unsigned slot)
+{
+    unsigned hole = slot;
+    for (unsigned next = (slot + 1) & hashMask; !table[next].empty();
+         next = (next + 1) & hashMask)
+    {
+        Metadata *m = table[next].deref(this);
+        unsigned home = table == aliasHash ? hash_slot(m->alias_)
+                                           : hash_slot(m->get_node_id());
+        // The element at next can fill the hole if its home slot is not in
+        // the (cyclic) range (hole, next].
+        if (((next - home) & hashMask) >= ((next - hole) & hashMask))
+        {
+            table[hole] = table[next];
+            hole = next;
+        }
+    }
+    table[hole].idx_ = NONE_ENTRY;
+}
+
 void debug_print_entry(void *, NodeID id, NodeAlias alias)
 {
     LOG(INFO, "[%012" PRIx64 "]: %03X", id, alias);
@@ -301,16 +455,16 @@ void AliasCache::add(NodeID id, NodeAlias alias)
     
     Metadata *insert;
 
-    auto it = aliasMap.find(alias);
-    if (alias == NOT_RESPONDING)
+    PoolIdx it;
+    if (alias != NOT_RESPONDING)
     {
         // We can have more than one NOT_RESPONDING entry.
-        it = aliasMap.end();
+        it = index_find(alias);
     }
-    if (it != aliasMap.end())
+    if (!it.empty())
     {
         /* we already have a mapping for this alias, so lets remove it */
-        insert = it->deref(this);
+        insert = it.deref(this);
         auto nid = insert->get_node_id();
         remove(insert->alias_);
 
@@ -320,11 +474,11 @@ void AliasCache::add(NodeID id, NodeAlias alias)
             (*removeCallback)(nid, insert->alias_, context);
         }
     }
-    auto nit = idMap.find(id);
-    if (nit != idMap.end())
+    PoolIdx nit = index_find(id);
+    if (!nit.empty())
     {
         /* we already have a mapping for this id, so lets remove it */
-        insert = nit->deref(this);
+        insert = nit.deref(this);
         auto nid = insert->get_node_id();
         remove(insert->alias_);
 
@@ -356,10 +510,10 @@ void AliasCache::add(NodeID id, NodeAlias alias)
         {
             newest.idx_ = NONE_ENTRY;
         }
+        PoolIdx evicted = oldest;
         oldest = second;
 
-        aliasMap.erase(aliasMap.find(insert->alias_));
-        idMap.erase(idMap.find(insert->get_node_id()));
+        index_erase(evicted);
 
         if (removeCallback)
         {
@@ -373,16 +527,14 @@ void AliasCache::add(NodeID id, NodeAlias alias)
         // This code will make all NOT_RESPONDING aliases unique in our map.
         unsigned ofs = insert - pool;
         alias = NOT_RESPONDING | ofs;
-        auto it = aliasMap.find(alias);
-        HASSERT(it == aliasMap.end());
+        HASSERT(index_find(alias).empty());
     }
     insert->set_node_id(id);
     insert->alias_ = alias;
 
     PoolIdx n;
     n.idx_ = insert - pool;
-    aliasMap.insert(PoolIdx(n));
-    idMap.insert(PoolIdx(n));
+    index_insert(n);
 
     /* update the time based list */
     insert->newer_.idx_ = NONE_ENTRY;
@@ -403,8 +555,11 @@ void AliasCache::add(NodeID id, NodeAlias alias)
     newest = n;
 
 #if defined(TEST_CONSISTENCY)
-    consistency_result = check_consistency();
-    HASSERT(0 == consistency_result);
+    if (entries <= MAX_AUTO_CONSISTENCY_CHECK)
+    {
+        consistency_result = check_consistency();
+        HASSERT(0 == consistency_result);
+    }
 #endif
 }
 
@@ -415,13 +570,12 @@ void AliasCache::add(NodeID id, NodeAlias alias)
  */
 void AliasCache::remove(NodeAlias alias)
 {
-    auto it = aliasMap.find(alias);
+    PoolIdx it = index_find(alias);
 
-    if (it != aliasMap.end())
+    if (!it.empty())
     {
-        Metadata *metadata = it->deref(this);
-        aliasMap.erase(it);
-        idMap.erase(idMap.find(metadata->get_node_id()));
+        Metadata *metadata = it.deref(this);
+        index_erase(it);
         // Ensures that the AME query handler does not find this metadata.
         metadata->set_node_id(0);
 
@@ -449,8 +603,11 @@ void AliasCache::remove(NodeAlias alias)
     }
 
 #if defined(TEST_CONSISTENCY)
-    consistency_result = check_consistency();
-    HASSERT(0 == consistency_result);
+    if (entries <= MAX_AUTO_CONSISTENCY_CHECK)
+    {
+        consistency_result = check_consistency();
+        HASSERT(0 == consistency_result);
+    }
 #endif
 }
 
@@ -475,12 +632,34 @@ bool AliasCache::retrieve(unsigned entry, NodeID* node, NodeAlias* alias)
 
 bool AliasCache::next_entry(NodeID bound, NodeID *node, NodeAlias *alias)
 {
-    auto it = idMap.upper_bound(bound);
-    if (it == idMap.end())
+    Metadata *metadata = nullptr;
+    if (aliasHash)
+    {
+        // The hash index is not ordered; finds the smallest larger ID by
+        // walking the LRU list.
+        for (PoolIdx idx = newest; !idx.empty();
+             idx = idx.deref(this)->older_)
+        {
+            Metadata *m = idx.deref(this);
+            if (m->get_node_id() > bound &&
+                (!metadata || m->get_node_id() < metadata->get_node_id()))
+            {
+                metadata = m;
+            }
+        }
+    }
+    else
+    {
+        auto it = idMap.upper_bound(bound);
+        if (it != idMap.end())
+        {
+            metadata = it->deref(this);
+        }
+    }
+    if (!metadata)
     {
         return false;
     }
-    Metadata *metadata = it->deref(this);
     if (alias)
     {
         *alias = resolve_notresponding(metadata->alias_);
@@ -500,11 +679,11 @@ NodeAlias AliasCache::lookup(NodeID id)
 {
     HASSERT(id != 0);
 
-    auto it = idMap.find(id);
+    PoolIdx it = index_find(id);
 
-    if (it != idMap.end())
+    if (!it.empty())
     {
-        Metadata *metadata = it->deref(this);
+        Metadata *metadata = it.deref(this);
 
         /* update timestamp */
         touch(metadata);
@@ -526,11 +705,11 @@ NodeID AliasCache::lookup(NodeAlias alias)
         return 0;
     }
 
-    auto it = aliasMap.find(alias);
+    PoolIdx it = index_find(alias);
 
-    if (it != aliasMap.end())
+    if (!it.empty())
     {
-        Metadata *metadata = it->deref(this);
+        Metadata *metadata = it.deref(this);
 
         /* update timestamp */
         touch(metadata);
@@ -602,8 +781,11 @@ void AliasCache::touch(Metadata* metadata)
         newest.idx_ = metadata - pool;
     }
 #if defined(TEST_CONSISTENCY)
-    consistency_result = check_consistency();
-    HASSERT(0 == consistency_result);
+    if (entries <= MAX_AUTO_CONSISTENCY_CHECK)
+    {
+        consistency_result = check_consistency();
+        HASSERT(0 == consistency_result);
+    }
 #endif
 }
 
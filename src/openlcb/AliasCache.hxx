@@ -82,20 +82,47 @@ namespace openlcb
  *
  * A similar sorted vector is kept sorted by the NodeID values. This also takes
  * only 2 bytes per entry.
+ *
+ * For very large caches (e.g. a router tracking thousands of remote nodes) the
+ * sorted vectors can be replaced by two open-addressing hash tables (linear
+ * probing, at most 50% load) of PoolIdx, one hashed by alias and one by
+ * NodeID. This makes add, lookup and remove O(1) instead of O(n) for the
+ * vector shifts, at the cost of 8 to 16 bytes per entry. next_entry() is
+ * O(n) in this case, thus the hash index must not be used for caches that are
+ * iterated with next_entry(), such as the local alias cache.
  */
 class AliasCache
 {
 public:
+    /// How to index the entries for lookup by alias and by node ID.
+    enum IndexType
+    {
+        /// Uses the sorted index for small caches and the hash index for
+        /// caches with at least HASH_INDEX_MIN_ENTRIES entries. Meant for
+        /// the remote alias cache, which is never iterated in order.
+        AUTO_INDEX,
+        /// Sorted vectors; 4 bytes per entry, O(n) add and remove.
+        SORTED_INDEX,
+        /// Open-addressing hash tables; 8-16 bytes per entry, O(1) add and
+        /// remove.
+        HASH_INDEX,
+    };
+
+    /// AUTO_INDEX picks the hash index from this many entries up.
+    static constexpr size_t HASH_INDEX_MIN_ENTRIES = 256;
+
     /** Constructor.
      * @param seed starting seed for generation of aliases
      * @param entries maximum number of entries in this cache
      * @param remove_callback callback to call when we remove a mapping from
      *        the cache however it will not be called in the remove() method
      * @param context context pointer to pass to remove_callback
+     * @param index_type how to index the entries. Caches that use
+     *        next_entry() should keep the sorted index.
      */
     AliasCache(NodeID seed, size_t _entries,
         void (*remove_callback)(NodeID id, NodeAlias alias, void *) = NULL,
-        void *context = NULL)
+        void *context = NULL, IndexType index_type = SORTED_INDEX)
         : pool(new Metadata[_entries])
         , aliasMap(this)
         , idMap(this)
@@ -104,8 +131,24 @@ public:
         , removeCallback(remove_callback)
         , context(context)
     {
-        aliasMap.reserve(_entries);
-        idMap.reserve(_entries);
+        HASSERT(_entries < NONE_ENTRY);
+        if (index_type == HASH_INDEX ||
+            (index_type == AUTO_INDEX && _entries >= HASH_INDEX_MIN_ENTRIES))
+        {
+            unsigned slots = 2;
+            while (slots < _entries * 2)
+            {
+                slots <<= 1;
+            }
+            hashMask = slots - 1;
+            aliasHash = new PoolIdx[slots];
+            idHash = new PoolIdx[slots];
+        }
+        else
+        {
+            aliasMap.reserve(_entries);
+            idMap.reserve(_entries);
+        }
         clear();
     }
 
@@ -162,7 +205,8 @@ public:
      */
     bool retrieve(unsigned entry, NodeID* node, NodeAlias* alias);
 
-    /** Retrieves the next entry by increasing node ID.
+    /** Retrieves the next entry by increasing node ID. O(log n) with the
+     * sorted index, O(n) with the hash index.
      * @param bound is a Node ID. Will search for the next largest node ID
      * (upper bound of this key).
      * @param node will be filled with the node ID. May be null.
@@ -181,6 +225,8 @@ public:
     ~AliasCache()
     {
         delete [] pool;
+        delete [] aliasHash;
+        delete [] idHash;
     }
 
     /** Visible for testing. Check internal consistency. */
@@ -345,6 +391,20 @@ private:
     /** Map of Node ID to corresponding Metadata */
     IdMap idMap;
 
+    /** Hash table of alias to corresponding Metadata, or nullptr if the
+     * sorted index is used. */
+    PoolIdx *aliasHash = nullptr;
+
+    /** Hash table of Node ID to corresponding Metadata, or nullptr if the
+     * sorted index is used. */
+    PoolIdx *idHash = nullptr;
+
+    /** Number of slots in the hash tables minus one. */
+    unsigned hashMask = 0;
+
+    /** Number of entries in the hash tables. */
+    size_t hashCount = 0;
+
     /** list of unused mapping entries (index into pool) */
     PoolIdx freeList;
 
@@ -371,6 +431,49 @@ private:
      */
     void touch(Metadata* metadata);
 
+    /** @return the number of entries in the index. */
+    size_t index_size()
+    {
+        return aliasHash ? hashCount : aliasMap.size();
+    }
+
+    /** Finds an entry in the index by alias.
+     * @param alias alias (as stored) to look for
+     * @return the entry, or an empty PoolIdx if not found.
+     */
+    PoolIdx index_find(NodeAlias alias);
+
+    /** Finds an entry in the index by Node ID.
+     * @param id Node ID to look for
+     * @return the entry, or an empty PoolIdx if not found.
+     */
+    PoolIdx index_find(NodeID id);
+
+    /** Adds an entry to the index. The alias and Node ID must already be set.
+     * @param idx the entry to add
+     */
+    void index_insert(PoolIdx idx);
+
+    /** Removes an entry from the index. The alias and Node ID must not have
+     * been changed since index_insert.
+     * @param idx the entry to remove
+     */
+    void index_erase(PoolIdx idx);
+
+    /** @param key alias (as stored) or Node ID
+     * @return home slot of the key in the hash tables. */
+    unsigned hash_slot(uint64_t key)
+    {
+        return ((key * 0x9E3779B97F4A7C15ull) >> 40) & hashMask;
+    }
+
+    /** Removes an element from a hash table, and moves back the following
+     * elements of the probe sequence to fill the hole.
+     * @param table aliasHash or idHash
+     * @param slot where the element to remove is
+     */
+    void hash_erase(PoolIdx *table, unsigned slot);
+
     DISALLOW_COPY_AND_ASSIGN(AliasCache);
 };
 
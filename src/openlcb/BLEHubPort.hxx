@@ -153,11 +153,17 @@ public:
             // Port already closed. Ignore data to send.
             return;
         }
+        const LinkedDataBufferPtr *payload = msg->payload(input_.type_);
+        if (!payload)
+        {
+            // Not representable in the format of this port.
+            return;
+        }
         {
             AtomicHolder h(lock());
-            if (pendingTail_ && pendingTail_->buf_.try_append_from(msg->buf_))
+            if (pendingTail_ && pendingTail_->buf_.try_append_from(*payload))
             {
-                totalPendingSize_ += msg->buf_.size();
+                totalPendingSize_ += payload->size();
                 // Successfully enqueued the bytes into the tail of the queue.
                 // Nothing else to do here.
                 return;
@@ -168,7 +174,7 @@ public:
         /// enqueueing them.
         BufferType *b;
         mainBufferPool->alloc(&b);
-        b->data()->buf_.reset(msg->buf_);
+        b->data()->buf_.reset(*payload);
         if (msg->done_)
         {
             b->set_done(msg->done_->new_child());
@@ -183,7 +189,7 @@ public:
                 return;
             }
             pendingQueue_.insert_locked(b);
-            totalPendingSize_ += msg->buf_.size();
+            totalPendingSize_ += payload->size();
             pendingTail_ = b->data();
             if (notRunning_)
             {
@@ -326,6 +332,7 @@ protected:
             , parent_(parent)
             , segmenter_(std::move(segmenter))
             , hub_(hub)
+            , type_(segmenter_->segment_type())
         {
             segmenter_->clear();
             flowWaiting_ = true;
@@ -443,6 +450,7 @@ protected:
             /// @todo do we need to add barriernotifiables here?
             //m->set_done(buf_.tail()->new_child());
             m->source_ = parent_;
+            m->type_ = type_;
             // This call transfers the chained head of the current buffers,
             // taking additional references where necessary or transferring the
             // existing reference. It adjusts the skip_ and size_ arguments in
@@ -498,7 +506,8 @@ protected:
         std::unique_ptr<MessageSegmenter> segmenter_;
         /// Parent hub where output data is coming from.
         DirectHubInterface<uint8_t[]> *hub_;
-        
+        /// Format of the data on this port, both for input and output.
+        DirectHubSegmentType type_;
     };
 
     /// Holds the necessary information we need to keep in the queue about a
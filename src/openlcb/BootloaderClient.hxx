@@ -345,7 +345,7 @@ private:
                 (payload[error_ofs] << 8) | ((uint8_t)payload[error_ofs + 1]);
             error_ofs += 2;
             return return_error(
-                error_code, "Write rejected " + payload.substr(error_ofs));
+                error_code, "Write rejected " + string(payload.substr(error_ofs)));
         }
         else if ((payload[1] & 0xFC) ==
             MemoryConfigDefs::COMMAND_WRITE_STREAM_REPLY)
@@ -0,0 +1,224 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file CanReassemblyTable.cxx
+ *
+ * Table of partially received multi-frame messages on a CAN interface.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#include "openlcb/CanReassemblyTable.hxx"
+
+#include "os/os.h"
+
+namespace openlcb
+{
+
+constexpr uint64_t CanReassemblyTable::EMPTY;
+
+CanReassemblyTable::CanReassemblyTable(unsigned size, long long timeout_nsec)
+    : timeoutNsec_(timeout_nsec)
+{
+    unsigned cap = 4;
+    while (cap < size)
+    {
+        cap <<= 1;
+    }
+    slots_ = new Slot[cap];
+    mask_ = cap - 1;
+}
+
+CanReassemblyTable::~CanReassemblyTable()
+{
+    delete[] slots_;
+}
+
+int CanReassemblyTable::lookup(uint64_t key)
+{
+    unsigned idx = home(key);
+    // The table is never full, so there is always an empty slot to stop at.
+    while (slots_[idx].key_ != EMPTY)
+    {
+        if (slots_[idx].key_ == key)
+        {
+            return idx;
+        }
+        idx = (idx + 1) & mask_;
+    }
+    return -1;
+}
+
+Payload *CanReassemblyTable::find(uint64_t key)
+{
+    int idx = lookup(key);
+    if (idx < 0)
+    {
+        return nullptr;
+    }
+    long long now = os_get_time_monotonic();
+    Slot &s = slots_[idx];
+    if (expired(now, s))
+    {
+        erase_index(idx);
+        return nullptr;
+    }
+    s.lastFrame_ = now;
+    return &s.data_;
+}
+
+Payload *CanReassemblyTable::insert(uint64_t key)
+{
+    long long now = os_get_time_monotonic();
+    int found = lookup(key);
+    if (found >= 0)
+    {
+        slots_[found].lastFrame_ = now;
+        return &slots_[found].data_;
+    }
+    // Keeps the load factor at most 3/4, otherwise the probe sequences get
+    // long.
+    if ((count_ + 1) * 4 > (mask_ + 1) * 3)
+    {
+        expire_all(now);
+        if ((count_ + 1) * 4 > (mask_ + 1) * 3)
+        {
+            grow();
+        }
+    }
+    unsigned idx = home(key);
+    while (slots_[idx].key_ != EMPTY)
+    {
+        idx = (idx + 1) & mask_;
+    }
+    Slot &s = slots_[idx];
+    s.key_ = key;
+    s.lastFrame_ = now;
+    s.data_.clear();
+    ++count_;
+    return &s.data_;
+}
+
+void CanReassemblyTable::erase(uint64_t key)
+{
+    int idx = lookup(key);
+    if (idx >= 0)
+    {
+        erase_index(idx);
+    }
+}
+
+bool CanReassemblyTable::take(uint64_t key, Payload *out)
+{
+    out->clear();
+    int idx = lookup(key);
+    if (idx < 0)
+    {
+        return false;
+    }
+    bool live = !expired(os_get_time_monotonic(), slots_[idx]);
+    if (live)
+    {
+        out->swap(slots_[idx].data_);
+    }
+    erase_index(idx);
+    return live;
+}
+
+void CanReassemblyTable::erase_index(unsigned idx)
+{
+    unsigned j = idx;
+    while (true)
+    {
+        j = (j + 1) & mask_;
+        Slot &s = slots_[j];
+        if (s.key_ == EMPTY)
+        {
+            break;
+        }
+        // The entry at j may move into the hole if the hole is between its
+        // home slot and j.
+        unsigned dist_home = (j - home(s.key_)) & mask_;
+        unsigned dist_hole = (j - idx) & mask_;
+        if (dist_home >= dist_hole)
+        {
+            Slot &hole = slots_[idx];
+            hole.key_ = s.key_;
+            hole.lastFrame_ = s.lastFrame_;
+            hole.data_.swap(s.data_);
+            idx = j;
+        }
+    }
+    slots_[idx].key_ = EMPTY;
+    slots_[idx].data_.clear();
+    --count_;
+}
+
+void CanReassemblyTable::expire_all(long long now)
+{
+    unsigned idx = 0;
+    while (idx <= mask_)
+    {
+        Slot &s = slots_[idx];
+        if (s.key_ != EMPTY && expired(now, s))
+        {
+            // Another entry may have moved here; check this index again.
+            erase_index(idx);
+        }
+        else
+        {
+            ++idx;
+        }
+    }
+}
+
+void CanReassemblyTable::grow()
+{
+    unsigned old_size = mask_ + 1;
+    Slot *old_slots = slots_;
+    slots_ = new Slot[old_size * 2];
+    mask_ = old_size * 2 - 1;
+    for (unsigned i = 0; i < old_size; ++i)
+    {
+        Slot &o = old_slots[i];
+        if (o.key_ == EMPTY)
+        {
+            continue;
+        }
+        unsigned idx = home(o.key_);
+        while (slots_[idx].key_ != EMPTY)
+        {
+            idx = (idx + 1) & mask_;
+        }
+        slots_[idx].key_ = o.key_;
+        slots_[idx].lastFrame_ = o.lastFrame_;
+        slots_[idx].data_.swap(o.data_);
+    }
+    delete[] old_slots;
+}
+
+} // namespace openlcb
@@ -0,0 +1,181 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file CanReassemblyTable.hxx
+ *
+ * Table of partially received multi-frame messages on a CAN interface.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#ifndef _OPENLCB_CANREASSEMBLYTABLE_HXX_
+#define _OPENLCB_CANREASSEMBLYTABLE_HXX_
+
+#include "openlcb/Defs.hxx"
+#include "openlcb/Payload.hxx"
+#include "utils/macros.h"
+
+namespace openlcb
+{
+
+/// Reassembly buffers for multi-frame messages arriving on a CAN interface,
+/// keyed by source and destination alias (and for addressed messages, the
+/// MTI).
+///
+/// The slots are preallocated in an open-addressed hash table with linear
+/// probing. Each slot holds a Payload, which stores up to a full datagram
+/// without a heap allocation, so the steady state of receiving multi-frame
+/// messages does not allocate memory.
+///
+/// A partial message that did not get a frame for longer than the timeout is
+/// considered abandoned: lookups do not find it any more, and its slot is
+/// reused. When all slots are taken by live entries, the table doubles in
+/// size. There is no shrinking; the table stays at the high-water mark.
+///
+/// Pointers returned by find() and insert() are invalidated by the next call
+/// to insert() or erase().
+class CanReassemblyTable
+{
+public:
+    /// Constructor.
+    /// @param size number of preallocated slots. Rounded up to a power of
+    /// two.
+    /// @param timeout_nsec partial messages which did not get a new frame in
+    /// this much time are dropped.
+    CanReassemblyTable(unsigned size, long long timeout_nsec);
+
+    ~CanReassemblyTable();
+
+    /// Computes the key for a pending message.
+    /// @param dst destination alias
+    /// @param src source alias
+    /// @param mti CAN MTI bits of the message, or 0 if the key does not
+    /// depend on the MTI.
+    /// @return key to use in find() and insert().
+    static uint64_t key(NodeAlias dst, NodeAlias src, unsigned mti = 0)
+    {
+        return (uint64_t(mti & 0xfff) << 24) | (uint64_t(dst & 0xfff) << 12) |
+            (src & 0xfff);
+    }
+
+    /// Looks up a pending message and refreshes its timestamp.
+    /// @param key the pending message, see key().
+    /// @return the buffer of the pending message, or nullptr if there is
+    /// none (or it timed out).
+    Payload *find(uint64_t key);
+
+    /// Starts a new pending message. If there is already one for this key, it
+    /// is returned as is; the caller may want to clear() it.
+    /// @param key the pending message, see key().
+    /// @return buffer for the message data.
+    Payload *insert(uint64_t key);
+
+    /// Removes a pending message. Does nothing if there is none.
+    /// @param key the pending message, see key().
+    void erase(uint64_t key);
+
+    /// Removes a pending message, handing over its data.
+    /// @param key the pending message, see key().
+    /// @param out the message data gets swapped into here. Its previous
+    /// contents are cleared.
+    /// @return true if a (not timed out) message was found and removed.
+    bool take(uint64_t key, Payload *out);
+
+    /// @return the number of entries, including the ones that timed out but
+    /// were not yet reused.
+    unsigned size()
+    {
+        return count_;
+    }
+
+    /// @return the number of slots.
+    unsigned capacity()
+    {
+        return mask_ + 1;
+    }
+
+private:
+    /// Value of Slot::key_ when the slot is not used.
+    static constexpr uint64_t EMPTY = ~uint64_t(0);
+
+    /// One reassembly buffer.
+    struct Slot
+    {
+        /// Which message this is, or EMPTY.
+        uint64_t key_ {EMPTY};
+        /// When the last frame arrived (os_get_time_monotonic).
+        long long lastFrame_ {0};
+        /// Data bytes so far.
+        Payload data_;
+    };
+
+    /// @param key message key.
+    /// @return the first slot to probe for this key.
+    unsigned home(uint64_t key)
+    {
+        uint32_t h = uint32_t(key ^ (key >> 24)) * 0x9E3779B1u;
+        return (h >> 16) & mask_;
+    }
+
+    /// @param key message key.
+    /// @return index of the slot with this key, or -1.
+    int lookup(uint64_t key);
+
+    /// @param now current time.
+    /// @param s a slot in use.
+    /// @return true if the slot's message timed out.
+    bool expired(long long now, const Slot &s)
+    {
+        return now - s.lastFrame_ > timeoutNsec_;
+    }
+
+    /// Clears a slot, and moves back the entries after it that would not be
+    /// found any more because of the hole.
+    /// @param idx slot to clear.
+    void erase_index(unsigned idx);
+
+    /// Removes all timed out entries. @param now current time.
+    void expire_all(long long now);
+
+    /// Doubles the number of slots.
+    void grow();
+
+    /// Slot array. Size is mask_ + 1.
+    Slot *slots_;
+    /// Number of slots - 1.
+    unsigned mask_;
+    /// Number of slots in use.
+    unsigned count_ {0};
+    /// Timeout of partial messages.
+    long long timeoutNsec_;
+
+    DISALLOW_COPY_AND_ASSIGN(CanReassemblyTable);
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_CANREASSEMBLYTABLE_HXX_
@@ -81,9 +81,11 @@ public:
             return;
         }
         const string &p = *b->data();
-        for (unsigned i = 0; i < p.size(); ++i)
+        const char *data = p.data();
+        const char *end = data + p.size();
+        while (data < end)
         {
-            if (it->second.segmenter_.consume_byte(p[i]))
+            if (it->second.segmenter_.consume_data(&data, end))
             {
                 // We have a frame.
                 string ret;
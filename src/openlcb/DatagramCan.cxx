@@ -34,6 +34,8 @@
 
 #include "openlcb/DatagramCan.hxx"
 
+#include "nmranet_config.h"
+#include "openlcb/CanReassemblyTable.hxx"
 #include "openlcb/DatagramDefs.hxx"
 #include "openlcb/DatagramImpl.hxx"
 #include "openlcb/IfCanImpl.hxx"
@@ -162,9 +164,8 @@ public:
 
         srcAlias_ = (id & CanDefs::SRC_MASK) >> CanDefs::SRC_SHIFT;
 
-        uint64_t buffer_key = id & (CanDefs::DST_MASK | CanDefs::SRC_MASK);
-
-        dst_.alias = buffer_key >> (CanDefs::DST_SHIFT);
+        dst_.alias = (id & CanDefs::DST_MASK) >> CanDefs::DST_SHIFT;
+        uint64_t buffer_key = CanReassemblyTable::key(dst_.alias, srcAlias_);
         dstNode_ = nullptr;
         dst_.id = if_can()->local_aliases()->lookup(NodeAlias(dst_.alias));
         if (dst_.id)
@@ -192,10 +193,9 @@ public:
             case 3:
             {
                 // Datagram first frame
-                auto it = pendingBuffers_.find(buffer_key);
-                if (it != pendingBuffers_.end())
+                if (pendingBuffers_.find(buffer_key))
                 {
-                    pendingBuffers_.erase(it);
+                    pendingBuffers_.erase(buffer_key);
                     /** Frames came out of order or more than one datagram is
                      * being sent to the same dst. */
                     errorCode_ = DatagramClient::RESEND_OK |
@@ -203,11 +203,8 @@ public:
                     break;
                 }
 
-                buf = &pendingBuffers_[buffer_key];
-                buf->clear();
-
-                // Datagram first frame. Get a full buffer.
-                buf->reserve(72);
+                // The table's buffers fit a full datagram.
+                buf = pendingBuffers_.insert(buffer_key);
                 last_frame = false;
                 break;
             }
@@ -218,20 +215,18 @@ public:
             case 5:
             {
                 // Datagram last frame
-                auto it = pendingBuffers_.find(buffer_key);
-                if (it != pendingBuffers_.end())
+                if (last_frame)
                 {
-                    buf = &it->second;
-                    if (last_frame)
+                    // Moves the data to the local buffer.
+                    if (pendingBuffers_.take(buffer_key, &localBuffer_))
                     {
-                        localBuffer_.clear();
-                        // Moves ownership of the allocated data to the local
-                        // buffer.
-                        localBuffer_.swap(*buf);
                         buf = &localBuffer_;
-                        pendingBuffers_.erase(it);
                     }
                 }
+                else
+                {
+                    buf = pendingBuffers_.find(buffer_key);
+                }
                 break;
             }
             default:
@@ -334,12 +329,12 @@ private:
     /// be forwarded to the upper layer in this case.
     uint16_t errorCode_;
 
-    /** Open datagram buffers. Keyed by (dstid | srcid), value is a datagram
-     * payload. When a payload is finished, it should be moved into the final
-     * datagram message using swap() to avoid memory copies.
-     * @TODO(balazs.racz) we need some kind of timeout-based release mechanism
-     * in here. */
-    StlMap<uint64_t, DatagramPayload> pendingBuffers_;
+    /** Open datagram buffers. Keyed by (dst alias, src alias). When a
+     * payload is finished, it is moved into the final datagram message using
+     * swap() to avoid memory copies. */
+    CanReassemblyTable pendingBuffers_ {
+        (unsigned)config_can_reassembly_table_size(),
+        MSEC_TO_NSEC(config_can_reassembly_timeout_msec())};
 };
 CanDatagramService::CanDatagramService(IfCan *iface,
                                        int num_registry_entries,
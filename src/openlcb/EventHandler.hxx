@@ -287,6 +287,17 @@ public:
     /// Creates a new event iterator. Caller takes ownership of object.
     virtual EventIterator *create_iterator() = 0;
 
+    /// Quick negative check before iterating for a single event. Used by the
+    /// event service to drop the (very frequent) messages about events that
+    /// are not interesting for any local handler.
+    /// @param event an event ID (with mask 0).
+    /// @return false if no registered handler would be returned by an
+    /// iterator for this event; true if there may be some.
+    virtual bool may_have_handlers(EventId event)
+    {
+        return true;
+    }
+
     /// Returns a monotonically increasing number that will change every time
     /// the set of registered event handlers change. Whenever this number
     /// changes, the iterators are invalidated and must be cleared.
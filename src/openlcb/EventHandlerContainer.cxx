@@ -160,4 +160,259 @@ TreeEventHandlers::TreeEventHandlers()
 {
 }
 
+FlatEventHandlers::FlatEventHandlers()
+{
+}
+
+void FlatEventHandlers::register_handler(
+    const EventRegistryEntry &entry, unsigned mask)
+{
+    AtomicHolder h(this);
+    LOG(VERBOSE, "%p: register %p", this, entry.handler);
+    set_dirty();
+    if (mask == 0)
+    {
+        events_.insert(EventRegistryEntry(entry));
+        bloom_add(entry.event, 0);
+    }
+    else if (mask >= 64)
+    {
+        global_.push_back(entry);
+    }
+    else
+    {
+        ranges_.push_back({entry, 0, (uint8_t)mask});
+        rangesDirty_ = true;
+        bloom_add(entry.event, mask);
+    }
+}
+
+void FlatEventHandlers::unregister_handler(
+    EventHandler *handler, uint32_t user_arg, uint32_t user_arg_mask)
+{
+    AtomicHolder h(this);
+    set_dirty();
+    LOG(VERBOSE, "%p: unregister %p", this, handler);
+    auto matches = [handler, user_arg, user_arg_mask](
+                       const EventRegistryEntry &e) {
+        return e.handler == handler &&
+            ((e.user_arg & user_arg_mask) == (user_arg & user_arg_mask));
+    };
+    auto begin_it = events_.begin();
+    auto end_it = events_.end();
+    auto erase_it = std::remove_if(begin_it, end_it, matches);
+    if (erase_it != end_it)
+    {
+        events_.erase(erase_it, end_it);
+    }
+    global_.erase(
+        std::remove_if(global_.begin(), global_.end(), matches), global_.end());
+    auto range_it = std::remove_if(ranges_.begin(), ranges_.end(),
+        [&matches](const RangeEntry &r) { return matches(r.entry); });
+    if (range_it != ranges_.end())
+    {
+        ranges_.erase(range_it, ranges_.end());
+        rangesDirty_ = true;
+    }
+    // The removed entries' bits cannot be cleared from the filter.
+    bloomStale_ = true;
+}
+
+void FlatEventHandlers::reserve(size_t count)
+{
+    AtomicHolder h(this);
+    events_.reserve(events_.size() + count);
+}
+
+void FlatEventHandlers::update_ranges()
+{
+    if (!rangesDirty_)
+    {
+        return;
+    }
+    std::sort(ranges_.begin(), ranges_.end(),
+        [](const RangeEntry &a, const RangeEntry &b) {
+            return a.entry.event < b.entry.event;
+        });
+    EventId max_end = 0;
+    for (auto &r : ranges_)
+    {
+        EventId span = (1ULL << r.mask) - 1;
+        EventId end = r.entry.event > UINT64_MAX - span ? UINT64_MAX
+                                                        : r.entry.event + span;
+        max_end = std::max(max_end, end);
+        r.maxEnd = max_end;
+    }
+    rangesDirty_ = false;
+}
+
+bool FlatEventHandlers::may_have_handlers(EventId event)
+{
+    AtomicHolder h(this);
+    if (!global_.empty())
+    {
+        return true;
+    }
+    if (bloomStale_)
+    {
+        rebuild_bloom();
+    }
+    if (bloom_check(event, 0))
+    {
+        return true;
+    }
+    for (uint64_t masks = rangeMasks_; masks; masks &= masks - 1)
+    {
+        unsigned m = __builtin_ctzll(masks);
+        if (bloom_check(event, m))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FlatEventHandlers::rebuild_bloom()
+{
+    // Aims for 16 bits per entry; this gives about 1.5% false positives with
+    // two bits set per entry.
+    size_t words = MIN_BLOOM_WORDS;
+    while (words * 2 < events_.size() + ranges_.size())
+    {
+        words *= 2;
+    }
+    bloom_.assign(words, 0);
+    rangeMasks_ = 0;
+    bloomStale_ = false;
+    for (auto &e : events_)
+    {
+        bloom_add(e.event, 0);
+    }
+    for (auto &r : ranges_)
+    {
+        bloom_add(r.entry.event, r.mask);
+    }
+}
+
+void FlatEventHandlers::bloom_add(EventId event, unsigned mask)
+{
+    if (bloomStale_)
+    {
+        return;
+    }
+    if ((events_.size() + ranges_.size()) * 8 > bloom_.size() * 32)
+    {
+        // Too full, the false positive rate would go up.
+        bloomStale_ = true;
+        return;
+    }
+    if (mask)
+    {
+        rangeMasks_ |= 1ULL << mask;
+    }
+    uint64_t h = bloom_hash(event >> mask, mask);
+    unsigned bits = bloom_.size() * 32 - 1;
+    unsigned b1 = h & bits;
+    unsigned b2 = (h >> 32) & bits;
+    bloom_[b1 >> 5] |= 1u << (b1 & 31);
+    bloom_[b2 >> 5] |= 1u << (b2 & 31);
+}
+
+bool FlatEventHandlers::bloom_check(EventId event, unsigned mask)
+{
+    uint64_t h = bloom_hash(event >> mask, mask);
+    unsigned bits = bloom_.size() * 32 - 1;
+    unsigned b1 = h & bits;
+    unsigned b2 = (h >> 32) & bits;
+    return (bloom_[b1 >> 5] & (1u << (b1 & 31))) &&
+        (bloom_[b2 >> 5] & (1u << (b2 & 31)));
+}
+
+/// Class representing the iteration state on the flat event handler
+/// registry.
+class FlatEventHandlers::Iterator : public EventIterator
+{
+public:
+    Iterator(FlatEventHandlers *parent)
+        : parent_(parent)
+    {
+        clear_iteration();
+    }
+
+    EventRegistryEntry *next_entry() OVERRIDE
+    {
+        AtomicHolder h(parent_);
+        if (eventIt_ != eventEnd_)
+        {
+            return &*eventIt_++;
+        }
+        while (rangeIt_ != rangeEnd_)
+        {
+            RangeEntry &r = *rangeIt_++;
+            // Same condition as in TreeEventHandlers: the registered event
+            // has to be at or above the incoming event rounded down to the
+            // registered mask.
+            uint64_t mask = (1ULL << r.mask) - 1;
+            if (r.entry.event >= (currentReport_->event & ~mask))
+            {
+                return &r.entry;
+            }
+        }
+        if (globalIt_ != globalEnd_)
+        {
+            return &*globalIt_++;
+        }
+        return nullptr;
+    }
+
+    void clear_iteration() OVERRIDE
+    {
+        AtomicHolder h(parent_);
+        eventIt_ = eventEnd_ = parent_->events_.end();
+        rangeIt_ = rangeEnd_ = parent_->ranges_.end();
+        globalIt_ = globalEnd_ = parent_->global_.end();
+    }
+
+    void init_iteration(EventReport *r) OVERRIDE
+    {
+        AtomicHolder h(parent_);
+        currentReport_ = r;
+        uint64_t last = r->event + r->mask;
+        auto &events = parent_->events_;
+        eventIt_ = events.lower_bound(r->event);
+        eventEnd_ = events.upper_bound(last);
+
+        parent_->update_ranges();
+        auto &ranges = parent_->ranges_;
+        // Ranges before this one all end before the incoming event.
+        rangeIt_ = std::partition_point(ranges.begin(), ranges.end(),
+            [r](const RangeEntry &e) { return e.maxEnd < r->event; });
+        // Ranges from this one all start after the incoming event range.
+        rangeEnd_ = std::partition_point(rangeIt_, ranges.end(),
+            [last](const RangeEntry &e) { return e.entry.event <= last; });
+
+        globalIt_ = parent_->global_.begin();
+        globalEnd_ = parent_->global_.end();
+    }
+
+private:
+    typedef SortedListSet<EventRegistryEntry, cmpop>::iterator EventIt;
+    typedef std::vector<RangeEntry>::iterator RangeIt;
+    typedef std::vector<EventRegistryEntry>::iterator GlobalIt;
+
+    FlatEventHandlers *parent_;
+    EventReport *currentReport_;
+    EventIt eventIt_;
+    EventIt eventEnd_;
+    RangeIt rangeIt_;
+    RangeIt rangeEnd_;
+    GlobalIt globalIt_;
+    GlobalIt globalEnd_;
+};
+
+EventIterator *FlatEventHandlers::create_iterator()
+{
+    return new Iterator(this);
+}
+
 } // namespace openlcb
@@ -187,6 +187,119 @@ private:
     MaskLookupMap handlers_;
 };
 
+/// EventRegistry implementation that keeps the event handlers in flat sorted
+/// arrays, and finds all matching handlers of an event with a single search.
+///
+/// Registrations with mask 0 (single events, which is the vast majority) are
+/// kept in a sorted array by event ID. Registrations with mask 1..63 (event
+/// ranges) are kept in a second sorted array where each entry also stores the
+/// largest range end of itself and all preceding entries, which allows
+/// finding the first range that may overlap the incoming event with a binary
+/// search. Registrations with mask 64 (all events) are kept in a plain
+/// vector.
+///
+/// The set of matching handlers is the same as with TreeEventHandlers, but
+/// the order in which they are returned may be different.
+class FlatEventHandlers : public EventRegistry, private Atomic
+{
+public:
+    FlatEventHandlers();
+
+    EventIterator *create_iterator() OVERRIDE;
+    void register_handler(
+        const EventRegistryEntry &entry, unsigned mask) OVERRIDE;
+    void unregister_handler(EventHandler *handler, uint32_t user_arg = 0,
+        uint32_t user_arg_mask = 0) OVERRIDE;
+    void reserve(size_t count) OVERRIDE;
+    bool may_have_handlers(EventId event) OVERRIDE;
+
+private:
+    class Iterator;
+    friend class Iterator;
+
+    /// Minimum size of the bloom filter in 32-bit words.
+    static constexpr unsigned MIN_BLOOM_WORDS = 16;
+
+    /// Registration for an event range.
+    struct RangeEntry
+    {
+        /// Registration data as supplied by the caller.
+        EventRegistryEntry entry;
+        /// Largest event ID covered by this or any preceding entry in the
+        /// ranges_ array (saturated at the top of the event ID space).
+        EventId maxEnd;
+        /// Number of bits covered by the range (the mask argument of
+        /// register_handler).
+        uint8_t mask;
+    };
+
+    /// Comparison operator for event registry entries.
+    struct cmpop
+    {
+        bool operator()(const EventRegistryEntry &d, uint64_t k)
+        {
+            return d.event < k;
+        }
+        bool operator()(uint64_t k, const EventRegistryEntry &d)
+        {
+            return k < d.event;
+        }
+        bool operator()(const EventRegistryEntry &a, const EventRegistryEntry &b)
+        {
+            return a.event < b.event;
+        }
+    };
+
+    /// Sorts the ranges_ array and recomputes the maxEnd fields if there was
+    /// a change. Must be called with the lock held.
+    void update_ranges();
+
+    /// Rebuilds the bloom filter from the registrations, sizing it to the
+    /// current number of entries. Must be called with the lock held.
+    void rebuild_bloom();
+
+    /// Adds a registration to the bloom filter, or marks the filter for
+    /// rebuild if it is too full. Must be called with the lock held.
+    /// @param event the registered event ID. @param mask number of bits
+    /// covered by the registration (0..63).
+    void bloom_add(EventId event, unsigned mask);
+
+    /// @param event the event ID to look up. @param mask which registrations
+    /// to look for, by the number of bits they cover (0..63).
+    /// @return true if the bloom filter has both bits set for this key.
+    bool bloom_check(EventId event, unsigned mask);
+
+    /// Computes the hash of a key in the bloom filter. @param event event ID
+    /// with the masked bits shifted out. @param mask number of bits covered
+    /// by the registration. @return 64-bit hash.
+    static uint64_t bloom_hash(EventId event, unsigned mask)
+    {
+        uint64_t h = event + (mask + 1) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        return h ^ (h >> 31);
+    }
+
+    /// Registrations with mask 0, sorted by event ID.
+    SortedListSet<EventRegistryEntry, cmpop> events_;
+    /// Registrations with mask 1..63, sorted by event ID after
+    /// update_ranges().
+    std::vector<RangeEntry> ranges_;
+    /// Registrations with mask 64.
+    std::vector<EventRegistryEntry> global_;
+    /// True if ranges_ was changed since the last update_ranges() call.
+    bool rangesDirty_ {false};
+    /// Bloom filter over the registrations in events_ and ranges_. Each
+    /// registration sets two bits, using the event ID shifted right by the
+    /// mask as the key.
+    std::vector<uint32_t> bloom_;
+    /// Bit m is set if there may be an entry in ranges_ with mask m.
+    uint64_t rangeMasks_ {0};
+    /// True if the bloom filter needs to be rebuilt before the next use,
+    /// because it has stale bits or it is too full.
+    bool bloomStale_ {true};
+};
+
 }; /* namespace openlcb */
 
 #endif  // _OPENLCB_EVENTHANDLERCONTAINER_HXX_
@@ -59,7 +59,7 @@ EventService::Impl::Impl(EventService *service) : callerFlow_(service)
 #ifdef TARGET_LPC11Cxx
     registry.reset(new VectorEventHandlers());
 #else
-    registry.reset(new TreeEventHandlers());
+    registry.reset(new FlatEventHandlers());
 #endif
 }
 
@@ -135,6 +135,31 @@ StateFlowBase::Action EventIteratorFlow::entry()
 #ifdef DEBUG_EVENT_PERFORMANCE
     currentProcessStart_ = os_get_time_monotonic();
 #endif
+    unsigned num_skipped = 0;
+    while (!decode_message() ||
+        (eventReport_.mask == 0 &&
+            !eventService_->impl()->registry->may_have_handlers(
+                eventReport_.event)))
+    {
+        // Nothing to do with this message. During bursts (e.g. the identify
+        // responses at startup) most messages are like this, so we take the
+        // next few ones inline instead of going through the executor.
+        if (++num_skipped >= MAX_SKIP_BATCH || !release_and_take_next())
+        {
+            return release_and_exit();
+        }
+    }
+    // The incoming message is not needed anymore.
+    incomingDone_ = message()->new_child();
+    release();
+
+    eventRegistryEpoch_ = eventService_->impl()->registry->get_epoch();
+    iterator_->init_iteration(&eventReport_);
+    return yield_and_call(STATE(iterate_next));
+}
+
+bool EventIteratorFlow::decode_message()
+{
     EventReport *rep = &eventReport_;
     rep->src_node = nmsg()->src;
     rep->dst_node = nmsg()->dstNode;
@@ -144,7 +169,7 @@ StateFlowBase::Action EventIteratorFlow::entry()
         {
             LOG(INFO, "Invalid input event message, payload length %d",
                 (unsigned)nmsg()->payload.size());
-            return release_and_exit();
+            return false;
         }
         rep->event = NetworkToEventID(nmsg()->payload.data());
         rep->mask = 0;
@@ -213,7 +238,7 @@ StateFlowBase::Action EventIteratorFlow::entry()
             {
                 LOG(INFO, "Invalid addressed identify all message, destination "
                           "node not found");
-                return release_and_exit();
+                return false;
             }
         // fall through
         case Defs::MTI_EVENTS_IDENTIFY_GLOBAL:
@@ -226,15 +251,9 @@ StateFlowBase::Action EventIteratorFlow::entry()
         default:
             LOG(INFO,
                 "Unexpected message arrived at the global event handler.");
-            return release_and_exit();
+            return false;
     } //    case
-    // The incoming message is not needed anymore.
-    incomingDone_ = message()->new_child();
-    release();
-
-    eventRegistryEpoch_ = eventService_->impl()->registry->get_epoch();
-    iterator_->init_iteration(rep);
-    return yield_and_call(STATE(iterate_next));
+    return true;
 }
 
 StateFlowBase::Action EventIteratorFlow::iterate_next()
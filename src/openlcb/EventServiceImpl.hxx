@@ -136,6 +136,14 @@ protected:
     Action iterate_next();
 
 private:
+    /// How many messages entry() may drop in one go (without yielding to the
+    /// executor) if they are not interesting for any of the event handlers.
+    static constexpr unsigned MAX_SKIP_BATCH = 16;
+
+    /// Fills in eventReport_ and fn_ from the current incoming message.
+    /// @return false if the message is invalid and should be dropped.
+    bool decode_message();
+
     virtual Action dispatch_event(const EventRegistryEntry *entry);
 
 protected:
@@ -67,6 +67,7 @@ void FilteringCanHubFlow::set_port_promiscuous(
         if (h.handler == port)
         {
             h.mask = is_promiscuous ? 0 : POINTER_MASK;
+            invalidate_index();
             return;
         }
     }
@@ -79,31 +80,48 @@ StateFlowBase::Action FilteringCanHubFlow::iterate()
         return CanHubFlow::iterate();
     }
 
-    // Filtering behavior
+    // Filtering behavior. Looks at every registered port regardless of the
+    // mask groups of the match index.
+    if (!readIndex_)
     {
-        OSMutexLock l(&lock_);
-        for (; currentIndex_ < handlers_.size(); ++currentIndex_)
+        return iteration_done();
+    }
+    {
+        const auto &entries = readIndex_->entries;
+        for (; currentIndex_ < entries.size(); ++currentIndex_)
         {
-            auto &h = handlers_[currentIndex_];
+            auto &h = entries[currentIndex_];
+            UntypedHandler *handler =
+                h.handler.load(std::memory_order_acquire);
+            if (!handler)
+            {
+                continue;
+            }
             bool is_promisc = (h.mask == 0);
             // Filtering check. Will also prevent loopback.
             if (!filter_.is_matching(
-                    reinterpret_cast<uintptr_t>(h.handler), is_promisc))
+                    reinterpret_cast<uintptr_t>(handler), is_promisc))
             {
                 continue;
             }
 
             // At this point: we have another handler.
+            if (h.shared)
+            {
+                send_shared_ref(handler);
+                ++numSharedSent_;
+                continue;
+            }
             if (!lastHandlerToCall_)
             {
                 // This was the first we found.
-                lastHandlerToCall_ = handlers_[currentIndex_].handler;
+                lastHandlerToCall_ = handler;
                 continue;
             }
             break;
         }
     }
-    if (currentIndex_ >= handlers_.size())
+    if (currentIndex_ >= readIndex_->entries.size())
     {
         return iteration_done();
     }
@@ -51,11 +51,11 @@ const unsigned LARGEST_BUFFERPOOL_BUCKET = BUCKET_SIZE;
 namespace openlcb
 {
 
-string node_id_to_buffer(NodeID id)
+Payload node_id_to_buffer(NodeID id)
 {
     id = htobe64(id);
     const char *src = reinterpret_cast<const char *>(&id);
-    return string(src + 2, 6);
+    return Payload(src + 2, 6);
 }
 
 void node_id_to_data(NodeID id, void* buf)
@@ -72,7 +72,7 @@ NodeID data_to_node_id(const void* buf)
     return be64toh(d);
 }
 
-NodeID buffer_to_node_id(const string &buf)
+NodeID buffer_to_node_id(const Payload &buf)
 {
     HASSERT(buf.size() == 6);
     return data_to_node_id(buf.data());
@@ -81,7 +81,7 @@ NodeID buffer_to_node_id(const string &buf)
 Payload eventid_to_buffer(uint64_t eventid)
 {
     eventid = htobe64(eventid);
-    return string(reinterpret_cast<char*>(&eventid), 8);
+    return Payload(reinterpret_cast<char*>(&eventid), 8);
 }
 
 void error_to_data(uint16_t error_code, void* data) {
@@ -96,18 +96,18 @@ uint16_t data_to_error(const void *data)
     return (((uint16_t)p[0]) << 8) | p[1];
 }
 
-string error_to_buffer(uint16_t error_code, uint16_t mti)
+Payload error_to_buffer(uint16_t error_code, uint16_t mti)
 {
-    string ret(4, '\0');
+    Payload ret(4, '\0');
     error_to_data(error_code, &ret[0]);
     ret[2] = mti >> 8;
     ret[3] = mti & 0xff;
     return ret;
 }
 
-string error_to_buffer(uint16_t error_code)
+Payload error_to_buffer(uint16_t error_code)
 {
-    string ret(2, '\0');
+    Payload ret(2, '\0');
     error_to_data(error_code, &ret[0]);
     return ret;
 }
@@ -157,8 +157,10 @@ void send_event(Node* src_node, uint64_t event_id)
     src_node->iface()->global_message_write_flow()->send(b);
 }
 
+constexpr size_t Payload::npos;
+constexpr size_t Payload::INLINE_SIZE;
 
-string EMPTY_PAYLOAD;
+Payload EMPTY_PAYLOAD;
 
 /*Buffer *node_id_to_buffer(NodeID id)
 {
@@ -34,12 +34,13 @@
 
 #include "openlcb/IfCan.hxx"
 
-#include "utils/StlMap.hxx"
 #include "openlcb/AliasAllocator.hxx"
 #include "openlcb/IfImpl.hxx"
 #include "openlcb/IfCanImpl.hxx"
 #include "openlcb/CanDefs.hxx"
+#include "openlcb/CanReassemblyTable.hxx"
 #include "can_frame.h"
+#include "nmranet_config.h"
 
 namespace openlcb
 {
@@ -556,7 +557,7 @@ private:
     /// CAN frame ID, saved from the incoming frame.
     uint32_t id_;
     /// Payload for the MTI message.
-    string buf_;
+    Payload buf_;
 };
 
 /** This class listens for incoming CAN frames of regular addressed OpenLCB
@@ -620,17 +621,13 @@ public:
         // Checks the continuation bits.
         if (f->data[0] & (CanDefs::NOT_FIRST_FRAME | CanDefs::NOT_LAST_FRAME))
         {
-            uint64_t buffer_key = dstHandle_.alias;
-            buffer_key <<= 12;
-            buffer_key |= CanDefs::get_src(id_);
-            buffer_key <<= 12;
-            buffer_key |= CanDefs::get_mti(id_);
-            /** @todo (balazs.racz): handle the error cases here, like when we
-             * get a middle frame out of the blue etc. */
-            Payload *mapped_buffer = &pendingBuffers_[buffer_key];
+            uint64_t buffer_key = CanReassemblyTable::key(dstHandle_.alias,
+                CanDefs::get_src(id_), CanDefs::get_mti(id_));
+            Payload *mapped_buffer;
             if ((f->data[0] & CanDefs::NOT_FIRST_FRAME) == 0)
             {
                 // First frame. Make sure the pending buffer is empty.
+                mapped_buffer = pendingBuffers_.insert(buffer_key);
                 if (!mapped_buffer->empty())
                 {
                     LOG(WARNING, "Received multi-frame message when a previous "
@@ -640,6 +637,19 @@ public:
                 }
                 mapped_buffer->clear();
             }
+            else
+            {
+                mapped_buffer = pendingBuffers_.find(buffer_key);
+                if (!mapped_buffer)
+                {
+                    // Middle or last frame without a first frame, or the
+                    // first frame was too long ago.
+                    LOG(VERBOSE, "Dropping continuation frame of an unknown "
+                                 "multi-frame message. frame ID=%08x",
+                        (unsigned)id_);
+                    return release_and_exit();
+                }
+            }
             if (f->can_dlc > 2)
             {
                 mapped_buffer->append(
@@ -653,8 +663,7 @@ public:
             else
             {
                 // Frame complete.
-                mapped_buffer->swap(buf_);
-                pendingBuffers_.erase(buffer_key);
+                pendingBuffers_.take(buffer_key, &buf_);
             }
         }
         else
@@ -699,10 +708,12 @@ public:
 
 private:
     uint32_t id_;
-    string buf_;
+    Payload buf_;
     NodeHandle dstHandle_;
     /// Reassembly buffers for multi-frame messages.
-    StlMap<uint32_t, Payload> pendingBuffers_;
+    CanReassemblyTable pendingBuffers_ {
+        (unsigned)config_can_reassembly_table_size(),
+        MSEC_TO_NSEC(config_can_reassembly_timeout_msec())};
 };
 
 IfCan::IfCan(ExecutorBase *executor, CanHubFlow *device,
@@ -711,7 +722,10 @@ IfCan::IfCan(ExecutorBase *executor, CanHubFlow *device,
     : If(executor, local_nodes_count)
     , CanIf(this, device)
     , localAliases_(0, local_alias_cache_size)
-    , remoteAliases_(0, remote_alias_cache_size)
+    // The remote cache may be large (e.g. on a router) and is only used for
+    // lookups, so it can use the hash index.
+    , remoteAliases_(0, remote_alias_cache_size, nullptr, nullptr,
+          AliasCache::AUTO_INDEX)
 {
     auto *gflow = new GlobalCanMessageWriteFlow(this);
     globalWriteFlow_ = gflow;
@@ -168,7 +168,7 @@ private:
                           CanDefs::NORMAL_PRIORITY);
         SET_CAN_FRAME_ID_EFF(*f, can_id);
 
-        const string &data = nmsg()->payload;
+        const Payload &data = nmsg()->payload;
         bool need_more_frames = false;
         // Sets the destination bytes if needed. Adds the payload.
         if (Defs::get_mti_address(nmsg()->mti))
@@ -0,0 +1,228 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file MappedFileMemorySpace.cxx
+ *
+ * Memory space that serves a file through a shared memory mapping.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#include "openlcb/MappedFileMemorySpace.hxx"
+
+#ifdef OPENMRN_HAVE_MMAP
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "executor/Executor.hxx"
+#include "nmranet_config.h"
+#include "utils/logging.h"
+
+namespace openlcb
+{
+
+MappedFileMemorySpace::SyncTimer::SyncTimer(
+    ExecutorBase *executor, MappedFileMemorySpace *parent)
+    : ::Timer(executor->active_timers())
+    , parent_(parent)
+{
+}
+
+MappedFileMemorySpace::MappedFileMemorySpace(
+    ExecutorBase *executor, int fd, address_t len)
+    : timer_(new SyncTimer(executor, this))
+    , size_(len)
+    , name_(nullptr)
+    , fd_(fd)
+    , timerPending_(0)
+{
+    HASSERT(fd_ >= 0);
+}
+
+MappedFileMemorySpace::MappedFileMemorySpace(
+    ExecutorBase *executor, const char *name, address_t len)
+    : timer_(new SyncTimer(executor, this))
+    , size_(len)
+    , name_(name)
+    , fd_(-1)
+    , timerPending_(0)
+{
+    HASSERT(name_);
+}
+
+MappedFileMemorySpace::~MappedFileMemorySpace()
+{
+    if (timerPending_)
+    {
+        // The timer might have expired already and be waiting on the
+        // executor, in which case it cannot be cancelled. Instead it is
+        // detached, and deletes itself when it runs.
+        timer_->detach();
+        timer_->ensure_triggered();
+    }
+    else
+    {
+        delete timer_;
+    }
+    if (data_)
+    {
+        flush();
+        munmap(data_, size_);
+    }
+    if (name_ && fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+bool MappedFileMemorySpace::ensure_mapped()
+{
+    if (data_)
+    {
+        return true;
+    }
+    if (fd_ < 0)
+    {
+        fd_ = ::open(name_, O_RDWR);
+        if (fd_ < 0)
+        {
+            LOG(WARNING, "Error opening file %s : %s", name_, strerror(errno));
+            return false;
+        }
+    }
+    struct stat buf;
+    HASSERT(fstat(fd_, &buf) >= 0);
+    if (size_ == AUTO_LEN)
+    {
+        size_ = buf.st_size;
+    }
+    else if ((address_t)buf.st_size < size_ && ftruncate(fd_, size_) < 0)
+    {
+        LOG(WARNING, "Error extending fd %d: %s", fd_, strerror(errno));
+        return false;
+    }
+    if (size_ == 0)
+    {
+        return false;
+    }
+    void *m = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (m == MAP_FAILED)
+    {
+        LOG(WARNING, "Error mapping fd %d: %s", fd_, strerror(errno));
+        return false;
+    }
+    data_ = static_cast<uint8_t *>(m);
+    return true;
+}
+
+size_t MappedFileMemorySpace::write(address_t destination,
+    const uint8_t *data, size_t len, errorcode_t *error, Notifiable *again)
+{
+    if (!ensure_mapped())
+    {
+        *error = Defs::ERROR_PERMANENT;
+        return 0;
+    }
+    if (destination >= size_)
+    {
+        *error = MemoryConfigDefs::ERROR_OUT_OF_BOUNDS;
+        return 0;
+    }
+    if (destination + len > size_)
+    {
+        len = size_ - destination;
+    }
+    memcpy(data_ + destination, data, len);
+    mark_dirty(destination, destination + len);
+    return len;
+}
+
+size_t MappedFileMemorySpace::read(address_t source, uint8_t *dst, size_t len,
+    errorcode_t *error, Notifiable *again)
+{
+    if (!ensure_mapped())
+    {
+        *error = Defs::ERROR_PERMANENT;
+        return 0;
+    }
+    if (source >= size_)
+    {
+        *error = MemoryConfigDefs::ERROR_OUT_OF_BOUNDS;
+        return 0;
+    }
+    if (source + len > size_)
+    {
+        len = size_ - source;
+    }
+    memcpy(dst, data_ + source, len);
+    return len;
+}
+
+void MappedFileMemorySpace::mark_dirty(address_t begin, address_t end)
+{
+    if (!is_dirty())
+    {
+        dirtyBegin_ = begin;
+        dirtyEnd_ = end;
+    }
+    else
+    {
+        dirtyBegin_ = std::min(dirtyBegin_, begin);
+        dirtyEnd_ = std::max(dirtyEnd_, end);
+    }
+    if (!timerPending_)
+    {
+        timerPending_ = 1;
+        timer_->start(MSEC_TO_NSEC(config_mapped_file_sync_delay_msec()));
+    }
+}
+
+void MappedFileMemorySpace::flush()
+{
+    if (!is_dirty())
+    {
+        return;
+    }
+    // msync needs a page aligned start address. MS_ASYNC only schedules the
+    // write-back, thus it does not block the executor on disk I/O.
+    static const address_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+    address_t begin = dirtyBegin_ & ~page_mask;
+    if (msync(data_ + begin, dirtyEnd_ - begin, MS_ASYNC) < 0)
+    {
+        LOG(WARNING, "Error syncing fd %d: %s", fd_, strerror(errno));
+    }
+    dirtyBegin_ = dirtyEnd_ = 0;
+}
+
+} // namespace openlcb
+
+#endif // OPENMRN_HAVE_MMAP
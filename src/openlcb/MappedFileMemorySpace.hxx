@@ -0,0 +1,191 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file MappedFileMemorySpace.hxx
+ *
+ * Memory space that serves a file through a shared memory mapping.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#ifndef _OPENLCB_MAPPEDFILEMEMORYSPACE_HXX_
+#define _OPENLCB_MAPPEDFILEMEMORYSPACE_HXX_
+
+#include "openlcb/MemoryConfig.hxx"
+#include "openmrn_features.h"
+
+#ifdef OPENMRN_HAVE_MMAP
+
+#include "executor/Timer.hxx"
+
+class ExecutorBase;
+
+namespace openlcb
+{
+
+/// Memory space implementation that exports the contents of a file as a
+/// read-write memory space, like FileMemorySpace, but without a system call
+/// per request. The file is mapped into memory at the first use; reads and
+/// writes are a memcpy. Written bytes are tracked as a dirty range, and
+/// scheduled for write-back to disk together on a timer, or when flush() is
+/// called (e.g. by the update complete command). The write-back is
+/// asynchronous (MS_ASYNC), so the executor never blocks on disk I/O.
+///
+/// Since the mapping is shared, the data written is immediately visible to
+/// ::read calls on the same file, such as those done by the configuration
+/// update listeners.
+///
+/// All calls, including the destructor, must be made on the executor given
+/// in the constructor.
+class MappedFileMemorySpace : public MemorySpace
+{
+public:
+    static const address_t AUTO_LEN = FileMemorySpace::AUTO_LEN;
+
+    /** Creates a memory space based on an fd.
+     *
+     * @param executor will run the deferred sync timer.
+     * @param fd is an open read-write file descriptor with the data. Not
+     * owned.
+     * @param len tells how many bytes there are in the memory space. If
+     * specified as AUTO_LEN, then uses fstat to figure out the size of the
+     * file. If the file is shorter than len, it will be extended.
+     */
+    MappedFileMemorySpace(
+        ExecutorBase *executor, int fd, address_t len = AUTO_LEN);
+
+    /** Creates a memory space based on a file name. Opens the file at the
+     * first use, and closes it in the destructor.
+     *
+     * @param executor will run the deferred sync timer.
+     * @param name is the file name to open. The pointer must stay alive so
+     * long as *this is around.
+     * @param len tells how many bytes there are in the memory space. If
+     * specified as AUTO_LEN, then uses fstat to figure out the size of the
+     * file. If the file is shorter than len, it will be extended.
+     */
+    MappedFileMemorySpace(
+        ExecutorBase *executor, const char *name, address_t len = AUTO_LEN);
+
+    /// Schedules the write-back of the pending writes, and unmaps the file.
+    ~MappedFileMemorySpace();
+
+    bool read_only() OVERRIDE
+    {
+        return false;
+    }
+
+    address_t max_address() OVERRIDE
+    {
+        if (!ensure_mapped())
+        {
+            return 0;
+        }
+        return size_ - 1;
+    }
+
+    size_t write(address_t destination, const uint8_t *data, size_t len,
+        errorcode_t *error, Notifiable *again) OVERRIDE;
+
+    size_t read(address_t source, uint8_t *dst, size_t len, errorcode_t *error,
+        Notifiable *again) OVERRIDE;
+
+    /// Schedules the write-back of the dirty range to disk immediately. Does
+    /// not wait for the disk I/O.
+    void flush() OVERRIDE;
+
+    /// @return true if there are written bytes whose write-back is not yet
+    /// scheduled.
+    bool is_dirty()
+    {
+        return dirtyEnd_ > dirtyBegin_;
+    }
+
+private:
+    /// Fires the deferred sync. Allocated separately, because it may outlive
+    /// the memory space when it has already expired at the time of
+    /// destruction.
+    class SyncTimer : public ::Timer
+    {
+    public:
+        SyncTimer(ExecutorBase *executor, MappedFileMemorySpace *parent);
+
+        long long timeout() override
+        {
+            if (!parent_)
+            {
+                // The memory space was destroyed.
+                return DELETE;
+            }
+            parent_->timerPending_ = 0;
+            parent_->flush();
+            return NONE;
+        }
+
+        /// Disconnects the timer from the memory space. The timer will
+        /// delete itself when it runs next.
+        void detach()
+        {
+            parent_ = nullptr;
+        }
+
+    private:
+        MappedFileMemorySpace *parent_;
+    };
+
+    /// Opens and maps the file if not done yet.
+    /// @return true if the mapping is usable.
+    bool ensure_mapped();
+
+    /// Adds a byte range to the dirty range, and schedules the sync.
+    /// @param begin first written offset
+    /// @param end one past the last written offset
+    void mark_dirty(address_t begin, address_t end);
+
+    /// Timer for the deferred sync. Owned, unless detached in the destructor.
+    SyncTimer *timer_;
+    /// Start of the mapped file, or nullptr if not mapped yet.
+    uint8_t *data_ {nullptr};
+    /// Number of bytes in the memory space.
+    address_t size_;
+    /// File name to open, or nullptr if an fd was given.
+    const char *name_;
+    /// File descriptor of the backing file.
+    int fd_;
+    /// Offset of the first written byte that is not synced yet.
+    address_t dirtyBegin_ {0};
+    /// One past the offset of the last written byte that is not synced yet.
+    address_t dirtyEnd_ {0};
+    /// 1 if the sync timer is scheduled or expired, but has not run yet.
+    unsigned timerPending_ : 1;
+};
+
+} // namespace openlcb
+
+#endif // OPENMRN_HAVE_MMAP
+
+#endif // _OPENLCB_MAPPEDFILEMEMORYSPACE_HXX_
@@ -170,6 +170,13 @@ public:
     virtual errorcode_t unfreeze() {
         return Defs::ERROR_INVALID_ARGS;
     }
+
+    /** Called when the configuration tool sends the update complete
+     * command. Spaces that defer writing data to persistent storage should
+     * write it out now. */
+    virtual void flush()
+    {
+    }
 };
 
 /// Memory space implementation that exports a some memory-mapped data as a
@@ -726,6 +733,7 @@ private:
             }
             case MemoryConfigDefs::COMMAND_UPDATE_COMPLETE:
             {
+                flush_spaces();
                 Singleton<ConfigUpdateService>::instance()->trigger_update();
                 return respond_ok(0);
             }
@@ -875,6 +883,21 @@ private:
         return respond_ok(DatagramClient::REPLY_PENDING);
     }
 
+    /// Calls flush() on every memory space of the destination node.
+    void flush_spaces()
+    {
+        for (auto it = registry_.begin(); it != registry_.end(); ++it)
+        {
+            auto h = *it;
+            Node *node = h.first.first;
+            if (node && node != message()->data()->dst)
+            {
+                continue;
+            }
+            h.second->flush();
+        }
+    }
+
     Action handle_get_space_info()
     {
         if (message()->data()->payload.size() < 3) {
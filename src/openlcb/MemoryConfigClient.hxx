@@ -40,6 +40,7 @@
 #include "openlcb/IfCan.hxx"
 #include "openlcb/MemoryConfig.hxx"
 #include "openlcb/StreamReceiver.hxx"
+#include "openlcb/StreamSender.hxx"
 #include "openlcb/StreamTransport.hxx"
 
 namespace openlcb
@@ -72,6 +73,11 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         WRITE
     };
 
+    enum WriteStreamCmd
+    {
+        WRITE_STREAM
+    };
+
     enum UpdateCompleteCmd
     {
         UPDATE_COMPLETE
@@ -116,7 +122,9 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         progressCb = std::move(cb);
     }
 
-    /// Sets up a command to read an entire memory space using stream transport.
+    /// Sets up a command to read an entire memory space using stream
+    /// transport. If the target node does not support reading via streams,
+    /// the data is read using datagrams instead.
     /// @param ReadStreamCmd polymorphic matching arg; always set to READ.
     /// @param d is the destination node to query
     /// @param space is the memory space to read out
@@ -148,7 +156,8 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
     }
 
     /// Sets up a command to read a part of a memory space using stream
-    /// transport.
+    /// transport. If the target node does not support reading via streams,
+    /// the data is read using datagrams instead.
     /// @param ReadPartStreamCmd polymorphic matching arg; always set to
     /// READ_PART.
     /// @param d is the destination node to query
@@ -180,6 +189,24 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         payload = std::move(data);
     }
 
+    /// Sets up a command to write a part of a memory space using stream
+    /// transport. If the target node does not support writing via streams,
+    /// the data is written using datagrams instead. Errors of the target
+    /// while writing the stream data into the memory space are returned in
+    /// resultCode.
+    /// @param WriteStreamCmd polymorphic matching arg; always set to
+    /// WRITE_STREAM.
+    /// @param d is the destination node to write to
+    /// @param space is the memory space to write to
+    /// @param offset if the address of the first byte to write
+    /// @param data is the data to write
+    void reset(WriteStreamCmd, NodeHandle d, uint8_t space, unsigned offset,
+        string data)
+    {
+        reset(WRITE, d, space, offset, std::move(data));
+        use_stream = true;
+    }
+
     /// Sets up a command to send an Update Complete request to a remote node.
     /// @param UpdateCompleteCmd polymorphic matching arg; always set to
     /// UPDATE_COMPLETE.
@@ -277,11 +304,15 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         size = 0;
         address = 0;
         use_stream = false;
+        stream_window = 0;
     }
 
     Command cmd;
     uint8_t memory_space;
     bool use_stream;
+    /// Maximum stream window size for stream transfers. 0 means the default
+    /// window size of the stream receiver.
+    uint16_t stream_window;
     unsigned address;
     unsigned size;
     /// Node to send the request to.
@@ -291,6 +322,13 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
     std::function<void(MemoryConfigClientRequest *)> progressCb;
 };
 
+/// Client for the memory config protocol. Datagram reads and writes are
+/// stop-and-wait, one chunk of up to 64 bytes per bus round trip. They are not
+/// pipelined, because OpenLCB allows only one unacknowledged datagram per node
+/// pair in each direction, and the next request already goes out together
+/// with the ack of the previous reply. For bulk transfers use the stream
+/// commands of MemoryConfigClientWithStream, which fall back to datagrams for
+/// targets without stream support.
 class MemoryConfigClient : public CallableFlow<MemoryConfigClientRequest>
 {
 public:
@@ -357,12 +395,16 @@ private:
         return call_immediately(STATE(send_next_read));
     }
 
+protected:
+    /// Sends the read datagram for the next chunk, from offset_. The datagram
+    /// client has to be allocated and the response flow registered.
     Action send_next_read()
     {
         return allocate_and_call(
             dg_service()->iface()->dispatcher(), STATE(send_read_datagram));
     }
 
+private:
     Action send_read_datagram()
     {
         auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
@@ -498,6 +540,10 @@ private:
         return call_immediately(STATE(send_next_write));
     }
 
+protected:
+    /// Sends the write datagram for the next chunk, from offset_ and
+    /// payloadOffset_. The datagram client has to be allocated and the
+    /// response flow registered.
     Action send_next_write()
     {
         return allocate_and_call(
@@ -616,6 +662,8 @@ private:
         return return_with_error(error);
     }
 
+protected:
+    /// Releases the datagram client and the response flow registration.
     void cleanup_write()
     {
         responsePayload_.clear();
@@ -624,6 +672,7 @@ private:
         dgClient_ = nullptr;
     }
 
+private:
     Action finish_write()
     {
         cleanup_write();
@@ -781,6 +830,13 @@ private:
                     }
                     return respond_ok(0);
                 }
+                case MemoryConfigDefs::COMMAND_WRITE_STREAM_REPLY:
+                case MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED:
+                    if (!parent_->request()->use_stream)
+                    {
+                        break;
+                    }
+                    // fall through
                 case MemoryConfigDefs::COMMAND_WRITE_REPLY:
                 case MemoryConfigDefs::COMMAND_WRITE_FAILED:
                     if (parent_->request()->cmd !=
@@ -831,7 +887,7 @@ protected:
     /// timing helper
     StateFlowTimer timer_ {this};
     /// The data that came back from reading.
-    string responsePayload_;
+    Payload responsePayload_;
     /// error code that came with the response. 0 for success.
     int responseCode_;
     /// 1 if we are pending on the timer.
@@ -845,13 +901,9 @@ public:
         Node *node, MemoryConfigHandler *memcfg, uint8_t local_stream_id)
         : MemoryConfigClient(node, memcfg)
     {
-        /// @todo make this not specific to the CAN-buf interface but somehow
-        /// portable.
-        IfCan *iface = static_cast<IfCan *>(node_->iface());
-        HASSERT(iface);
-        HASSERT(iface->stream_transport());
-        dstStreamId_ = iface->stream_transport()->get_next_stream_receive_id();
-        receiver_.reset(new StreamReceiverCan(iface, dstStreamId_));
+        HASSERT(stream_transport());
+        dstStreamId_ = stream_transport()->get_next_stream_receive_id();
+        receiver_.reset(stream_transport()->create_receiver(dstStreamId_));
     }
 
 protected:
@@ -868,6 +920,9 @@ protected:
             case MemoryConfigClientRequest::CMD_READ_PART:
                 return allocate_and_call(
                     STATE(do_stream_read), dg_service()->client_allocator());
+            case MemoryConfigClientRequest::CMD_WRITE:
+                return allocate_and_call(
+                    STATE(do_stream_write), dg_service()->client_allocator());
             default:
                 return return_with_error(Defs::ERROR_UNIMPLEMENTED_SUBCMD);
         }
@@ -882,7 +937,8 @@ protected:
             receiver_->pool()->alloc(&streamRecvRequest_);
             /// @todo add option to specify byte sink directly.
             streamRecvRequest_->data()->reset(&defaultSink_, node_,
-                request()->dst, StreamDefs::INVALID_STREAM_ID, dstStreamId_);
+                request()->dst, StreamDefs::INVALID_STREAM_ID, dstStreamId_,
+                request()->stream_window);
             streamRecvRequest_->data()->done.reset(this);
             // We keep an extra reference.
             streamRecvRequest_->data()->done.new_child();
@@ -996,15 +1052,223 @@ protected:
         streamRecvRequest_->data()->done.notify();
         receiver_->cancel_request();
         request()->resultCode = error;
+        if ((error & 0xfff0) == Defs::ERROR_UNIMPLEMENTED)
+        {
+            // The target does not know about stream reads.
+            return wait_and_call(STATE(fallback_to_datagram));
+        }
         return wait_and_call(STATE(cleanup_after_error));
     }
 
+    /// Called when the target rejected the stream read request, after the
+    /// stream receiver is cancelled. Reads the same data using datagrams.
+    Action fallback_to_datagram()
+    {
+        LOG(VERBOSE,
+            "Memory Config client: stream read rejected with 0x%04x, falling "
+            "back to datagrams",
+            (unsigned)request()->resultCode);
+        request()->resultCode = OPERATION_PENDING;
+        offset_ = request()->address;
+        return call_immediately(STATE(send_next_read));
+    }
+
     Action cleanup_after_error()
     {
         cleanup_read();
         return return_with_error(request()->resultCode);
     }
 
+    Action do_stream_write()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        memoryConfigHandler_->set_client(&responseFlow_);
+        return allocate_and_call(
+            STATE(have_stream_sender), stream_transport()->sender_allocator());
+    }
+
+    Action have_stream_sender()
+    {
+        sender_ =
+            full_allocation_result(stream_transport()->sender_allocator());
+        srcStreamId_ = stream_transport()->get_send_stream_id();
+        if (srcStreamId_ == StreamDefs::INVALID_STREAM_ID)
+        {
+            return handle_stream_write_error(Defs::ERROR_TEMPORARY);
+        }
+        return allocate_and_call(dg_service()->iface()->dispatcher(),
+            STATE(send_stream_write_datagram));
+    }
+
+    Action send_stream_write_datagram()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        b->set_done(bn_.reset(this));
+        b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(), request()->dst,
+            MemoryConfigDefs::write_stream_datagram(
+                request()->memory_space, request()->address, srcStreamId_));
+
+        isWaitingForTimer_ = 0;
+        responseCode_ = DatagramClient::OPERATION_PENDING;
+        dgClient_->write_datagram(b);
+        return wait_and_call(STATE(stream_write_dg_complete));
+    }
+
+    /// Called when the target acked the stream write datagram. The target is
+    /// then listening for the stream; the Write Stream Reply (or Failed)
+    /// comes only after the stream is closed and all data is written.
+    Action stream_write_dg_complete()
+    {
+        if (!(dgClient_->result() & DatagramClient::OPERATION_SUCCESS))
+        {
+            // some error occurred.
+            return handle_stream_write_error(dgClient_->result());
+        }
+        if (!(responseCode_ & DatagramClient::OPERATION_PENDING) &&
+            is_write_stream_failed())
+        {
+            // Target refused the write before the stream.
+            return call_immediately(STATE(stream_write_response));
+        }
+        // The stream data frames need the alias of the target, which is now
+        // in the cache. The destination stream ID comes in the stream
+        // initiate reply.
+        NodeHandle dst = request()->dst;
+        node_->iface()->canonicalize_handle(&dst);
+        sender_->start_stream(node_, dst, srcStreamId_);
+        if (request()->stream_window)
+        {
+            sender_->set_proposed_window_size(request()->stream_window);
+        }
+        // The payload stays alive in the request until the stream is closed.
+        auto *b = sender_->alloc();
+        b->data()->set_from(&request()->payload);
+        sender_->send(b);
+        sender_->close_stream();
+        return call_immediately(STATE(wait_for_stream_write_close));
+    }
+
+    Action wait_for_stream_write_close()
+    {
+        auto state = sender_->get_state();
+        if (state == StreamSender::CLOSING && sender_->is_waiting())
+        {
+            // Sender is done and empty.
+            release_stream_sender();
+            if (responseCode_ & DatagramClient::OPERATION_PENDING)
+            {
+                isWaitingForTimer_ = 1;
+                return sleep_and_call(&timer_,
+                    SEC_TO_NSEC(STREAM_WRITE_REPLY_TIMEOUT_SEC),
+                    STATE(stream_write_response));
+            }
+            return call_immediately(STATE(stream_write_response));
+        }
+        if (state == StreamSender::STATE_ERROR && sender_->is_waiting())
+        {
+            // Sender has errored and consumed / thrown away all data.
+            return handle_stream_write_error(sender_->get_error());
+        }
+        return sleep_and_call(
+            &timer_, MSEC_TO_NSEC(3), STATE(wait_for_stream_write_close));
+    }
+
+    /// @return true if the response datagram is a Write Stream Failed.
+    bool is_write_stream_failed()
+    {
+        return MemoryConfigDefs::payload_min_length_check(
+                   responsePayload_, 2) &&
+            (MemoryConfigDefs::payload_bytes(responsePayload_)[1] &
+                MemoryConfigDefs::COMMAND_MASK) ==
+            MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED;
+    }
+
+    /// Evaluates the Write Stream Reply or Failed datagram from the target.
+    Action stream_write_response()
+    {
+        isWaitingForTimer_ = 0;
+        if (responseCode_ & DatagramClient::OPERATION_PENDING)
+        {
+            return handle_stream_write_error(Defs::OPENMRN_TIMEOUT);
+        }
+        const uint8_t *bytes =
+            MemoryConfigDefs::payload_bytes(responsePayload_);
+        if (!MemoryConfigDefs::payload_min_length_check(responsePayload_, 2))
+        {
+            LOG(INFO,
+                "Memory Config client: response datagram payload not "
+                "long enough");
+            return handle_stream_write_error(
+                Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+        }
+        unsigned ofs = MemoryConfigDefs::get_payload_offset(responsePayload_);
+        unsigned address = MemoryConfigDefs::get_address(responsePayload_);
+        uint8_t space = MemoryConfigDefs::get_space(responsePayload_);
+        uint8_t cmd = bytes[1] & MemoryConfigDefs::COMMAND_MASK;
+        if (address != request()->address ||
+            space != request()->memory_space)
+        {
+            return handle_stream_write_error(Defs::ERROR_OUT_OF_ORDER);
+        }
+        if (cmd == MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED)
+        {
+            uint16_t error = bytes[ofs++];
+            error <<= 8;
+            error |= bytes[ofs];
+            return handle_stream_write_error(error);
+        }
+        if (cmd != MemoryConfigDefs::COMMAND_WRITE_STREAM_REPLY)
+        {
+            return handle_stream_write_error(Defs::ERROR_UNIMPLEMENTED);
+        }
+        release_stream_sender();
+        cleanup_write();
+        return return_ok();
+    }
+
+    /// Called upon various error conditions of the stream write.
+    Action handle_stream_write_error(int error)
+    {
+        release_stream_sender();
+        if ((error & 0xfff0) == Defs::ERROR_UNIMPLEMENTED)
+        {
+            // The target does not know about stream writes.
+            LOG(VERBOSE,
+                "Memory Config client: stream write rejected with 0x%04x, "
+                "falling back to datagrams",
+                (unsigned)error);
+            offset_ = request()->address;
+            payloadOffset_ = 0;
+            return call_immediately(STATE(send_next_write));
+        }
+        cleanup_write();
+        return return_with_error(error);
+    }
+
+    /// Returns the stream sender and the source stream ID to the stream
+    /// transport.
+    void release_stream_sender()
+    {
+        if (!sender_)
+        {
+            return;
+        }
+        sender_->clear();
+        stream_transport()->sender_allocator()->typed_insert(sender_);
+        sender_ = nullptr;
+        if (srcStreamId_ != StreamDefs::INVALID_STREAM_ID)
+        {
+            stream_transport()->release_send_stream_id(srcStreamId_);
+            srcStreamId_ = StreamDefs::INVALID_STREAM_ID;
+        }
+    }
+
+    /// @return the stream transport of the local interface.
+    StreamTransport *stream_transport()
+    {
+        return node_->iface()->stream_transport();
+    }
+
     /// Stores incoming stream data into the request()->payload object
     /// (which is a string).
     struct DefaultSink : public ByteSink
@@ -1027,11 +1291,19 @@ protected:
         MemoryConfigClientWithStream *parent_;
     } defaultSink_{this};
 
+    /// How many seconds we wait for the Write Stream Reply after the stream
+    /// was closed. The target sends it when the last data is written.
+    static constexpr unsigned STREAM_WRITE_REPLY_TIMEOUT_SEC = 3;
+
     std::unique_ptr<StreamReceiverInterface> receiver_;
     /// stream ID on the local device.
     uint8_t dstStreamId_;
     /// Holds a ref to the stream receiver request.
     BufferPtr<StreamReceiveRequest> streamRecvRequest_;
+    /// Stream sender used for stream writes.
+    StreamSender *sender_ {nullptr};
+    /// Stream ID on the local device for stream writes.
+    uint8_t srcStreamId_ {StreamDefs::INVALID_STREAM_ID};
 }; // class MemoryConfigClientWithStream
 
 } // namespace openlcb
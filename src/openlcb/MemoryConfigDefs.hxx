@@ -46,7 +46,7 @@ namespace openlcb
 /// Protocol.
 struct MemoryConfigDefs
 {
-    using DatagramPayload = string;
+    using DatagramPayload = Payload;
 
     /** Possible Commands for a configuration datagram.
      */
@@ -232,6 +232,29 @@ struct MemoryConfigDefs
         return p;
     }
     
+    static DatagramPayload write_stream_datagram(
+        uint8_t space, uint32_t offset, uint8_t src_stream_id)
+    {
+        DatagramPayload p;
+        p.reserve(8);
+        p.push_back(DatagramDefs::CONFIGURATION);
+        p.push_back(COMMAND_WRITE_STREAM);
+        p.push_back(0xff & (offset >> 24));
+        p.push_back(0xff & (offset >> 16));
+        p.push_back(0xff & (offset >> 8));
+        p.push_back(0xff & (offset));
+        if (is_special_space(space))
+        {
+            p[1] |= space & ~SPACE_SPECIAL;
+        }
+        else
+        {
+            p.push_back(space);
+        }
+        p.push_back(src_stream_id);
+        return p;
+    }
+
     /// @return true if the payload has minimum number of bytes you need in a
     /// read or write datagram message to cover for the necessary fields
     /// (command, offset, space).
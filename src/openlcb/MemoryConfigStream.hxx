@@ -37,6 +37,7 @@
 
 #include "openlcb/If.hxx"
 #include "openlcb/MemoryConfig.hxx"
+#include "openlcb/StreamReceiver.hxx"
 #include "openlcb/StreamSender.hxx"
 #include "openlcb/StreamTransport.hxx"
 
@@ -102,10 +103,6 @@ private:
         LOG(INFO, "got sender");
         sender_ =
             full_allocation_result(stream_transport()->sender_allocator());
-        /// @todo the APIs are not on the right object in StreamSender, so we
-        /// have to do this down cast.
-        senderCan_ = static_cast<StreamSenderCan *>(sender_);
-        HASSERT(senderCan_);
         return call_immediately(STATE(initiate_stream));
     }
 
@@ -113,22 +110,22 @@ private:
     {
         LOG(INFO, "initiate");
         srcStreamId_ = stream_transport()->get_send_stream_id();
-        senderCan_->start_stream(node_, dst_, srcStreamId_, dstStreamId_);
+        sender_->start_stream(node_, dst_, srcStreamId_, dstStreamId_);
         return call_immediately(STATE(wait_for_started));
     }
 
     Action wait_for_started()
     {
-        auto state = senderCan_->get_state();
+        auto state = sender_->get_state();
         if (state == StreamSender::RUNNING)
         {
-            dstStreamId_ = senderCan_->get_dst_stream_id();
+            dstStreamId_ = sender_->get_dst_stream_id();
             startedCb_(0);
             return call_immediately(STATE(alloc_buffer));
         }
         if (state == StreamSender::STATE_ERROR)
         {
-            auto err = senderCan_->get_error();
+            auto err = sender_->get_error();
             LOG(INFO, "failed to start stream: 0x%04x", err);
             startedCb_(err);
             return call_immediately(STATE(done_stream));
@@ -158,7 +155,7 @@ private:
         if (!len_)
         {
             sender_->send(sendBuffer_.release());
-            senderCan_->close_stream();
+            sender_->close_stream();
             return call_immediately(STATE(wait_for_close));
         }
         size_t free = sendBuffer_->data()->free_space();
@@ -185,7 +182,7 @@ private:
         if (err == MemoryConfigDefs::ERROR_OUT_OF_BOUNDS)
         {
             sender_->send(sendBuffer_.release());
-            senderCan_->close_stream();
+            sender_->close_stream();
             return call_immediately(STATE(wait_for_close));
         }
         if (!err)
@@ -196,24 +193,24 @@ private:
         {
             LOG(INFO, "error reading input stream: %04x", err);
             sender_->send(sendBuffer_.release());
-            senderCan_->close_stream(err);
+            sender_->close_stream(err);
             return call_immediately(STATE(wait_for_close));
         }
     }
 
     Action wait_for_close()
     {
-        auto state = senderCan_->get_state();
-        if (state == StreamSender::CLOSING && senderCan_->is_waiting())
+        auto state = sender_->get_state();
+        if (state == StreamSender::CLOSING && sender_->is_waiting())
         {
             // Sender is done and empty.
             return call_immediately(STATE(done_stream));
         }
-        if (state == StreamSender::STATE_ERROR && senderCan_->is_waiting())
+        if (state == StreamSender::STATE_ERROR && sender_->is_waiting())
         {
             // Sender has errored and consumed / thrown away all data.
             // There is no place really to show the error.
-            LOG(INFO, "Stream sender error: 0x%04x", senderCan_->get_error());
+            LOG(INFO, "Stream sender error: 0x%04x", sender_->get_error());
             return call_immediately(STATE(done_stream));
         }
         return sleep_and_call(&timer_, MSEC_TO_NSEC(3), STATE(wait_for_close));
@@ -221,7 +218,7 @@ private:
 
     Action done_stream()
     {
-        senderCan_->clear();
+        sender_->clear();
         stream_transport()->sender_allocator()->typed_insert(sender_);
         sender_ = nullptr;
         return delete_this();
@@ -258,10 +255,243 @@ private:
     /// How many bytes are left to read. 0xFFFFFFFF if all bytes until EOF need
     /// to be read.
     uint32_t len_;
+    /// Stream sender allocated from the stream transport.
+    StreamSender *sender_;
+};
+
+/// This flow receives a stream and writes the incoming data into a memory
+/// space. The data buffers coming from the stream receiver are written to the
+/// memory space as they arrive; the stream receiver only sends the next stream
+/// proceed when the buffers of the previous window were released, so a slow
+/// memory space throttles the sender.
+///
+/// One stream write can be in progress at any given time. When the stream is
+/// closed (or broken), the flow notifies the caller, who then sends the Write
+/// Stream Reply or Write Stream Failed datagram with get_error().
+class MemorySpaceStreamWriteFlow : public StateFlowBase
+{
+public:
+    /// Constructor.
     ///
+    /// @param iface interface to receive the streams on. Must have a stream
+    /// transport.
+    /// @param local_stream_id stream ID to use on the local side for the
+    /// incoming streams.
+    MemorySpaceStreamWriteFlow(If *iface, uint8_t local_stream_id)
+        : StateFlowBase(iface)
+        , receiver_(
+              iface->stream_transport()->create_receiver(local_stream_id))
+        , localStreamId_(local_stream_id)
+        , isBusy_(0)
+        , isSleeping_(0)
+        , streamDone_(0)
+    { }
+
+    /// @return true if there is a stream write in progress.
+    bool is_busy()
+    {
+        return isBusy_;
+    }
+
+    /// @return the stream ID on the local side.
+    uint8_t get_dst_stream_id()
+    {
+        return localStreamId_;
+    }
+
+    /// @return the OpenLCB error code of the last stream write, 0 if it was
+    /// successful. Valid after the done notifiable was called.
+    uint16_t get_error()
+    {
+        return errorCode_;
+    }
+
+    /// Prepares for receiving an announced stream, and writing its data to a
+    /// memory space. May only be called when the flow is not busy. The stream
+    /// receiver is started synchronously.
     ///
-    StreamSenderCan *senderCan_;
-    StreamSender *sender_;
+    /// @param node local node where the stream will arrive.
+    /// @param space memory space to write into
+    /// @param src node that will send the stream
+    /// @param src_stream_id stream ID on the source node
+    /// @param ofs address in the memory space where the first byte of the
+    /// stream should be written.
+    /// @param done will be notified when the stream is complete and all data
+    /// was written (or an error occurred).
+    void start(Node *node, MemorySpace *space, NodeHandle src,
+        uint8_t src_stream_id, uint32_t ofs, Notifiable *done)
+    {
+        HASSERT(!isBusy_);
+        LOG(INFO, "starting streamed write, src %02x", src_stream_id);
+        isBusy_ = 1;
+        isSleeping_ = 0;
+        streamDone_ = 0;
+        space_ = space;
+        ofs_ = ofs;
+        errorCode_ = 0;
+        done_ = done;
+        receiver_->pool()->alloc(&recvRequest_);
+        recvRequest_->data()->reset(
+            &sink_, node, src, src_stream_id, localStreamId_);
+        recvRequest_->data()->done.reset(&doneNotifiable_);
+        receiver_->send(recvRequest_->ref());
+        start_flow(STATE(wait_for_data));
+    }
+
+private:
+    Action wait_for_data()
+    {
+        if (!pendingData_.empty())
+        {
+            currentBuffer_.reset(
+                static_cast<ByteBuffer *>(pendingData_.next(0)));
+            return call_immediately(STATE(try_write));
+        }
+        if (streamDone_)
+        {
+            return call_immediately(STATE(done_stream));
+        }
+        isSleeping_ = 1;
+        return sleep_and_call(&timer_, SEC_TO_NSEC(STREAM_DATA_TIMEOUT_SEC),
+            STATE(data_timeout));
+    }
+
+    Action data_timeout()
+    {
+        if (isSleeping_)
+        {
+            // Nothing arrived, the source is probably gone.
+            isSleeping_ = 0;
+            LOG(INFO, "streamed write: timed out waiting for data");
+            receiver_->cancel_request();
+        }
+        return call_immediately(STATE(wait_for_data));
+    }
+
+    Action try_write()
+    {
+        auto *chunk = currentBuffer_->data();
+        if (!chunk->size() || errorCode_)
+        {
+            // After an error we still consume the data, otherwise the stream
+            // would get stuck.
+            currentBuffer_.reset();
+            return call_immediately(STATE(wait_for_data));
+        }
+        MemorySpace::errorcode_t err = 0;
+        size_t written =
+            space_->write(ofs_, chunk->data_, chunk->size(), &err, this);
+        chunk->advance(written);
+        ofs_ += written;
+        if (err == MemorySpace::ERROR_AGAIN)
+        {
+            return wait();
+        }
+        if (err)
+        {
+            LOG(INFO, "error writing memory space from stream: %04x", err);
+            errorCode_ = err;
+        }
+        else if (!written)
+        {
+            // End of the memory space.
+            LOG(INFO, "streamed write past the end of the memory space");
+            errorCode_ = MemoryConfigDefs::ERROR_OUT_OF_BOUNDS;
+        }
+        return again();
+    }
+
+    Action done_stream()
+    {
+        if (recvRequest_->data()->resultCode)
+        {
+            LOG(INFO, "streamed write: stream error 0x%04x",
+                (unsigned)recvRequest_->data()->resultCode);
+            if (!errorCode_)
+            {
+                // The data did not arrive in full.
+                errorCode_ = Defs::ERROR_TEMPORARY;
+            }
+        }
+        recvRequest_.reset();
+        isBusy_ = 0;
+        done_->notify();
+        return exit();
+    }
+
+    /// Wakes up the flow if it is waiting for data.
+    void wakeup()
+    {
+        if (isSleeping_)
+        {
+            isSleeping_ = 0;
+            timer_.trigger();
+        }
+    }
+
+    /// Receives the data from the stream receiver.
+    struct DataSink : public ByteSink
+    {
+        DataSink(MemorySpaceStreamWriteFlow *parent)
+            : parent_(parent)
+        { }
+
+        void send(ByteBuffer *msg, unsigned prio) override
+        {
+            parent_->pendingData_.insert(msg);
+            parent_->wakeup();
+        }
+
+        MemorySpaceStreamWriteFlow *parent_;
+    } sink_ {this};
+
+    /// Gets called when the stream receiver is done. All data buffers have
+    /// been handed over to the sink by that time.
+    struct DoneNotifiable : public Notifiable
+    {
+        DoneNotifiable(MemorySpaceStreamWriteFlow *parent)
+            : parent_(parent)
+        { }
+
+        void notify() override
+        {
+            parent_->streamDone_ = 1;
+            parent_->wakeup();
+        }
+
+        MemorySpaceStreamWriteFlow *parent_;
+    } doneNotifiable_ {this};
+
+    /// How many seconds we wait for the next chunk of stream data before
+    /// giving up.
+    static constexpr unsigned STREAM_DATA_TIMEOUT_SEC = 20;
+
+    /// Receives the stream data.
+    std::unique_ptr<StreamReceiverInterface> receiver_;
+    /// Holds a ref to the stream receiver request.
+    BufferPtr<StreamReceiveRequest> recvRequest_;
+    /// Data buffers that arrived but have not been written yet.
+    Q pendingData_;
+    /// The buffer that we are currently writing into the memory space.
+    ByteBufferPtr currentBuffer_;
+    /// Helper object for waiting.
+    StateFlowTimer timer_ {this};
+    /// Memory space we are writing.
+    MemorySpace *space_;
+    /// Notified when the stream write is complete.
+    Notifiable *done_;
+    /// Next byte to write.
+    uint32_t ofs_;
+    /// Error from the memory space, 0 if none.
+    uint16_t errorCode_;
+    /// Stream ID on the local side.
+    uint8_t localStreamId_;
+    /// 1 if a stream write is in progress.
+    uint8_t isBusy_ : 1;
+    /// 1 if the flow is waiting for data.
+    uint8_t isSleeping_ : 1;
+    /// 1 if the stream receiver returned.
+    uint8_t streamDone_ : 1;
 };
 
 /// Handler for the stream read/write commands in the memory config protocol
@@ -291,7 +521,10 @@ public:
             {
                 return call_immediately(STATE(handle_read_stream));
             }
-                /// @todo handle write stream
+            case MemoryConfigDefs::COMMAND_WRITE_STREAM:
+            {
+                return call_immediately(STATE(handle_write_stream));
+            }
         }
         return respond_reject(Defs::ERROR_UNIMPLEMENTED_SUBCMD);
     }
@@ -386,6 +619,85 @@ private:
         return respond_ok(DatagramClient::REPLY_PENDING);
     }
 
+    Action handle_write_stream()
+    {
+        size_t len = message()->data()->payload.size();
+        const uint8_t *bytes = in_bytes();
+
+        MemorySpace *space = get_space();
+        if (!space)
+        {
+            return respond_reject(MemoryConfigDefs::ERROR_SPACE_NOT_KNOWN);
+        }
+        if (space->read_only())
+        {
+            return respond_reject(MemoryConfigDefs::ERROR_WRITE_TO_RO);
+        }
+
+        size_t stream_data_offset = 6;
+        if (has_custom_space())
+        {
+            ++stream_data_offset;
+        }
+        if (len < stream_data_offset + 1)
+        {
+            return respond_reject(Defs::ERROR_INVALID_ARGS);
+        }
+        uint8_t src_stream_id = bytes[stream_data_offset];
+
+        if (!writeFlow_)
+        {
+            If *iface = dg_service()->iface();
+            if (!iface->stream_transport())
+            {
+                return respond_reject(Defs::ERROR_UNIMPLEMENTED_SUBCMD);
+            }
+            writeFlow_.reset(new MemorySpaceStreamWriteFlow(
+                iface, iface->stream_transport()->get_next_stream_receive_id()));
+        }
+        // This flow is blocked until the stream is done, so the write flow is
+        // never busy here. The receiver has to be listening before the
+        // datagram is acked, because the ack is what makes the client open the
+        // stream.
+        writeFlow_->start(message()->data()->dst, space,
+            message()->data()->src, src_stream_id, get_address(), this);
+        inline_respond_ok(
+            static_cast<uint8_t>(DatagramClient::REPLY_PENDING));
+        return wait_and_call(STATE(write_stream_done));
+    }
+
+    /// Called when the stream write flow is done. Sends the Write Stream
+    /// Reply or Write Stream Failed datagram.
+    Action write_stream_done()
+    {
+        uint16_t error = writeFlow_->get_error();
+        size_t stream_data_offset = 6;
+        if (has_custom_space())
+        {
+            ++stream_data_offset;
+        }
+        response_.reserve(stream_data_offset + 2);
+        response_.resize(stream_data_offset + 2);
+        uint8_t *response_bytes = out_bytes();
+        response_bytes[0] = DATAGRAM_ID;
+        response_bytes[1] = error
+            ? MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED
+            : MemoryConfigDefs::COMMAND_WRITE_STREAM_REPLY;
+        set_address_and_space();
+        if (error)
+        {
+            response_bytes[stream_data_offset] = error >> 8;
+            response_bytes[stream_data_offset + 1] = error & 0xff;
+        }
+        else
+        {
+            response_bytes[stream_data_offset] = in_bytes()[stream_data_offset];
+            response_bytes[stream_data_offset + 1] =
+                writeFlow_->get_dst_stream_id();
+        }
+        return call_immediately(STATE(ok_response_sent));
+    }
+
     /** Looks up the memory space for the current datagram. Returns NULL if no
      * space was registered (for neither the current node, nor global). */
     MemorySpace *get_space()
@@ -431,6 +743,10 @@ private:
         /// stream.
         MemorySpaceStreamReadFlow *readFlow_;
     };
+
+    /// Flow for writing incoming streams into a memory space. Created upon
+    /// the first stream write request.
+    std::unique_ptr<MemorySpaceStreamWriteFlow> writeFlow_;
 }; // class MemoryConfigStreamHandler
 
 } // namespace openlcb
@@ -26,8 +26,7 @@
  *
  * \file Payload.hxx
  *
- * Forward declaration of the class storing the payload value in an NMRAnet
- * message object.
+ * Container class storing the payload value in an NMRAnet message object.
  *
  * @author Balazs Racz
  * @date 18 May 2014
@@ -36,11 +35,553 @@
 #ifndef _OPENLCB_PAYLOAD_HXX_
 #define _OPENLCB_PAYLOAD_HXX_
 
+#include <stdint.h>
+#include <string.h>
 #include <string>
+#include <type_traits>
+
+#ifdef GTEST
+#include <ostream>
+#endif
+
+#include "utils/macros.h"
+
+#ifndef OPENMRN_PAYLOAD_INLINE_SIZE
+/// How many payload bytes an OpenLCB message stores without a heap
+/// allocation. The default covers a full datagram (72 bytes).
+#define OPENMRN_PAYLOAD_INLINE_SIZE 72
+#endif
 
 namespace openlcb {
 
-typedef string Payload;
+/// Container for the data bytes of an OpenLCB message. Has the subset of the
+/// std::string API that the stack uses. Implicitly constructible from a
+/// std::string; the conversion back is explicit, so that hidden copies do not
+/// sneak into the message paths.
+///
+/// Up to INLINE_SIZE bytes are stored inside the object, which covers
+/// everything except the long SNIP and CDI replies and stream data. Longer
+/// payloads are moved to the heap. Copying or clearing a payload keeps the
+/// heap buffer of the destination, similar to std::string.
+///
+/// The data is always followed by a terminating zero, thus c_str() is the
+/// same as data().
+class Payload
+{
+public:
+    typedef char value_type;
+    typedef size_t size_type;
+    typedef char *iterator;
+    typedef const char *const_iterator;
+
+    /// Marker for "until the end" in substr() and for "not found" in find().
+    static constexpr size_t npos = std::string::npos;
+    /// Number of bytes stored without heap allocation.
+    static constexpr size_t INLINE_SIZE = OPENMRN_PAYLOAD_INLINE_SIZE;
+
+    /// Creates an empty payload.
+    Payload()
+    {
+        inline_[0] = 0;
+    }
+
+    /// Creates a payload with repeated bytes. @param n number of bytes.
+    /// @param c value of each byte.
+    Payload(size_t n, char c)
+    {
+        inline_[0] = 0;
+        assign(n, c);
+    }
+
+    /// Creates a payload from a C string. @param s zero-terminated string.
+    Payload(const char *s)
+    {
+        inline_[0] = 0;
+        assign(s, strlen(s));
+    }
+
+    /// Creates a payload from bytes. @param s first byte. @param n number of
+    /// bytes.
+    Payload(const char *s, size_t n)
+    {
+        inline_[0] = 0;
+        assign(s, n);
+    }
+
+    /// Creates a payload from a string. @param s the bytes to copy.
+    Payload(const std::string &s)
+    {
+        inline_[0] = 0;
+        assign(s.data(), s.size());
+    }
+
+    /// Creates a payload from a range of bytes. @param first begin of range.
+    /// @param last end of range.
+    template <class It,
+        typename = typename std::enable_if<!std::is_integral<It>::value>::type>
+    Payload(It first, It last)
+    {
+        inline_[0] = 0;
+        for (; first != last; ++first)
+        {
+            push_back(*first);
+        }
+    }
+
+    Payload(const Payload &o)
+    {
+        inline_[0] = 0;
+        assign(o.data(), o.size());
+    }
+
+    Payload(Payload &&o) noexcept
+    {
+        inline_[0] = 0;
+        take(&o);
+    }
+
+    ~Payload()
+    {
+        delete[] heap_;
+    }
+
+    Payload &operator=(const Payload &o)
+    {
+        if (&o != this)
+        {
+            assign(o.data(), o.size());
+        }
+        return *this;
+    }
+
+    Payload &operator=(Payload &&o) noexcept
+    {
+        if (&o != this)
+        {
+            take(&o);
+        }
+        return *this;
+    }
+
+    Payload &operator=(const std::string &s)
+    {
+        return assign(s.data(), s.size());
+    }
+
+    Payload &operator=(const char *s)
+    {
+        return assign(s, strlen(s));
+    }
+
+    /// @return a std::string copy of the payload.
+    explicit operator std::string() const
+    {
+        return std::string(data(), size_);
+    }
+
+    /// @return pointer to the first byte.
+    char *data()
+    {
+        return heap_ ? heap_ : inline_;
+    }
+
+    /// @return pointer to the first byte.
+    const char *data() const
+    {
+        return heap_ ? heap_ : inline_;
+    }
+
+    /// @return pointer to the first byte. The payload is zero-terminated.
+    const char *c_str() const
+    {
+        return data();
+    }
+
+    /// @return number of bytes in the payload.
+    size_t size() const
+    {
+        return size_;
+    }
+
+    /// @return number of bytes in the payload.
+    size_t length() const
+    {
+        return size_;
+    }
+
+    /// @return true if the payload has no bytes.
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    /// @return how many bytes fit before the next reallocation.
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    char &operator[](size_t i)
+    {
+        return data()[i];
+    }
+
+    const char &operator[](size_t i) const
+    {
+        return data()[i];
+    }
+
+    /// @param i byte offset, must be less than size(). @return the byte.
+    const char &at(size_t i) const
+    {
+        HASSERT(i < size_);
+        return data()[i];
+    }
+
+    char &front()
+    {
+        return data()[0];
+    }
+
+    const char &front() const
+    {
+        return data()[0];
+    }
+
+    char &back()
+    {
+        return data()[size_ - 1];
+    }
+
+    const char &back() const
+    {
+        return data()[size_ - 1];
+    }
+
+    iterator begin()
+    {
+        return data();
+    }
+
+    iterator end()
+    {
+        return data() + size_;
+    }
+
+    const_iterator begin() const
+    {
+        return data();
+    }
+
+    const_iterator end() const
+    {
+        return data() + size_;
+    }
+
+    /// Removes all bytes. Keeps the heap buffer, if any.
+    void clear()
+    {
+        set_size(0);
+    }
+
+    /// Makes sure that a given number of bytes fit without reallocation.
+    /// @param n number of bytes.
+    void reserve(size_t n)
+    {
+        if (n > capacity_)
+        {
+            delete[] grow(n);
+        }
+    }
+
+    /// Changes the number of bytes. @param n new size. @param c value of the
+    /// added bytes, if any.
+    void resize(size_t n, char c = 0)
+    {
+        reserve(n);
+        if (n > size_)
+        {
+            memset(data() + size_, c, n - size_);
+        }
+        set_size(n);
+    }
+
+    /// Appends a byte. @param c the byte to append.
+    void push_back(char c)
+    {
+        if (size_ == capacity_)
+        {
+            delete[] grow(size_ + 1);
+        }
+        data()[size_] = c;
+        set_size(size_ + 1);
+    }
+
+    /// Removes the last byte.
+    void pop_back()
+    {
+        set_size(size_ - 1);
+    }
+
+    /// Replaces the contents. @param s first byte. @param n number of bytes.
+    /// @return *this
+    Payload &assign(const char *s, size_t n)
+    {
+        char *old = n > capacity_ ? grow(n) : nullptr;
+        memmove(data(), s, n);
+        delete[] old;
+        set_size(n);
+        return *this;
+    }
+
+    /// Replaces the contents with repeated bytes. @param n number of bytes.
+    /// @param c value of each byte. @return *this
+    Payload &assign(size_t n, char c)
+    {
+        reserve(n);
+        memset(data(), c, n);
+        set_size(n);
+        return *this;
+    }
+
+    Payload &assign(const char *s)
+    {
+        return assign(s, strlen(s));
+    }
+
+    Payload &assign(const std::string &s)
+    {
+        return assign(s.data(), s.size());
+    }
+
+    Payload &assign(const Payload &o)
+    {
+        return assign(o.data(), o.size());
+    }
+
+    /// Appends bytes. @param s first byte. @param n number of bytes.
+    /// @return *this
+    Payload &append(const char *s, size_t n)
+    {
+        char *old = size_ + n > capacity_ ? grow(size_ + n) : nullptr;
+        memmove(data() + size_, s, n);
+        delete[] old;
+        set_size(size_ + n);
+        return *this;
+    }
+
+    /// Appends repeated bytes. @param n number of bytes. @param c value of
+    /// each byte. @return *this
+    Payload &append(size_t n, char c)
+    {
+        reserve(size_ + n);
+        memset(data() + size_, c, n);
+        set_size(size_ + n);
+        return *this;
+    }
+
+    Payload &append(const char *s)
+    {
+        return append(s, strlen(s));
+    }
+
+    Payload &append(const std::string &s)
+    {
+        return append(s.data(), s.size());
+    }
+
+    Payload &append(const Payload &o)
+    {
+        return append(o.data(), o.size());
+    }
+
+    Payload &operator+=(char c)
+    {
+        push_back(c);
+        return *this;
+    }
+
+    Payload &operator+=(const char *s)
+    {
+        return append(s);
+    }
+
+    Payload &operator+=(const std::string &s)
+    {
+        return append(s);
+    }
+
+    Payload &operator+=(const Payload &o)
+    {
+        return append(o);
+    }
+
+    /// Removes bytes. @param pos offset of the first byte to remove. @param n
+    /// number of bytes to remove. @return *this
+    Payload &erase(size_t pos = 0, size_t n = npos)
+    {
+        HASSERT(pos <= size_);
+        if (n > size_ - pos)
+        {
+            n = size_ - pos;
+        }
+        memmove(data() + pos, data() + pos + n, size_ - pos - n);
+        set_size(size_ - n);
+        return *this;
+    }
+
+    /// @param pos offset of the first byte. @param n number of bytes.
+    /// @return a copy of a part of the payload.
+    Payload substr(size_t pos = 0, size_t n = npos) const
+    {
+        HASSERT(pos <= size_);
+        if (n > size_ - pos)
+        {
+            n = size_ - pos;
+        }
+        return Payload(data() + pos, n);
+    }
+
+    /// @param c byte to look for. @param pos where to start searching.
+    /// @return offset of the first occurrence, or npos.
+    size_t find(char c, size_t pos = 0) const
+    {
+        if (pos >= size_)
+        {
+            return npos;
+        }
+        const void *p = memchr(data() + pos, c, size_ - pos);
+        return p ? static_cast<const char *>(p) - data() : npos;
+    }
+
+    /// Exchanges the contents with another payload. @param o the other
+    /// payload.
+    void swap(Payload &o)
+    {
+        if (heap_ && o.heap_)
+        {
+            std::swap(heap_, o.heap_);
+            std::swap(size_, o.size_);
+            std::swap(capacity_, o.capacity_);
+            return;
+        }
+        Payload tmp(std::move(o));
+        o = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    /// @param s first byte. @param n number of bytes. @return true if the
+    /// payload has exactly these bytes.
+    bool equals(const char *s, size_t n) const
+    {
+        return n == size_ && memcmp(data(), s, n) == 0;
+    }
+
+    friend bool operator==(const Payload &a, const Payload &b)
+    {
+        return a.equals(b.data(), b.size());
+    }
+    friend bool operator==(const Payload &a, const std::string &b)
+    {
+        return a.equals(b.data(), b.size());
+    }
+    friend bool operator==(const std::string &a, const Payload &b)
+    {
+        return b.equals(a.data(), a.size());
+    }
+    friend bool operator==(const Payload &a, const char *b)
+    {
+        return a.equals(b, strlen(b));
+    }
+    friend bool operator==(const char *a, const Payload &b)
+    {
+        return b.equals(a, strlen(a));
+    }
+    template <class T> friend bool operator!=(const Payload &a, const T &b)
+    {
+        return !(a == b);
+    }
+    friend bool operator!=(const std::string &a, const Payload &b)
+    {
+        return !(b == a);
+    }
+    friend bool operator!=(const char *a, const Payload &b)
+    {
+        return !(b == a);
+    }
+    friend bool operator<(const Payload &a, const Payload &b)
+    {
+        int r = memcmp(
+            a.data(), b.data(), a.size() < b.size() ? a.size() : b.size());
+        return r < 0 || (r == 0 && a.size() < b.size());
+    }
+
+private:
+    /// Moves the contents of another payload here. @param o the payload to
+    /// take from; will be empty afterwards.
+    void take(Payload *o)
+    {
+        if (o->heap_)
+        {
+            delete[] heap_;
+            heap_ = o->heap_;
+            size_ = o->size_;
+            capacity_ = o->capacity_;
+            o->heap_ = nullptr;
+            o->capacity_ = INLINE_SIZE;
+            o->set_size(0);
+        }
+        else
+        {
+            assign(o->inline_, o->size_);
+            o->set_size(0);
+        }
+    }
+
+    /// Moves the contents to a new, larger heap buffer.
+    /// @param n the minimum new capacity.
+    /// @return the previous heap buffer, which the caller must delete[] (it
+    /// may be nullptr).
+    char *grow(size_t n)
+    {
+        size_t cap = capacity_ * 2;
+        if (cap < n)
+        {
+            cap = n;
+        }
+        char *b = new char[cap + 1];
+        memcpy(b, data(), size_ + 1);
+        char *old = heap_;
+        heap_ = b;
+        capacity_ = cap;
+        return old;
+    }
+
+    /// Sets the size and the terminating zero. @param n new size.
+    void set_size(size_t n)
+    {
+        size_ = n;
+        data()[n] = 0;
+    }
+
+    /// Heap buffer, if the payload did not fit into inline_.
+    char *heap_ {nullptr};
+    /// Number of bytes in the payload.
+    uint32_t size_ {0};
+    /// Number of bytes that fit into the current buffer (excluding the
+    /// terminating zero).
+    uint32_t capacity_ {INLINE_SIZE};
+    /// Storage for short payloads.
+    char inline_[INLINE_SIZE + 1];
+};
+
+#ifdef GTEST
+/// Prints a payload in test failure messages.
+inline std::ostream &operator<<(std::ostream &o, const Payload &p)
+{
+    return o << std::string(p);
+}
+#endif
 
 } // namespace openlcb
 
@@ -111,6 +111,16 @@ void SimpleCanStackBase::add_stream_support()
     additionalComponents_.emplace_back(mem_stream);
 }
 
+void SimpleTcpStackBase::add_stream_support()
+{
+    Destructable *t =
+        new StreamTransportTcp(iface(), config_num_stream_senders());
+    additionalComponents_.emplace_back(t);
+    Destructable *mem_stream =
+        new MemoryConfigStreamHandler(memory_config_handler());
+    additionalComponents_.emplace_back(mem_stream);
+}
+
 void SimpleStackBase::start_stack(bool delay_start)
 {
 #if OPENMRN_HAVE_POSIX_FD
@@ -446,7 +456,7 @@ void SimpleCanStackBase::add_socketcan_port_select(
     int s = socketcan_open(device, loopback);
     if (s >= 0)
     {
-        auto *port = new HubDeviceSelect<CanHubFlow>(can_hub(), s);
+        auto *port = new HubDeviceSocketCan(can_hub(), s);
         additionalComponents_.emplace_back(port);
     }
 }
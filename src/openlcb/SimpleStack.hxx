@@ -250,7 +250,7 @@ public:
     /// @param dst is the node to send message to.
     /// @param payload is the contents of the message
     void send_message_to(
-        Defs::MTI mti, NodeHandle dst, const string &payload = EMPTY_PAYLOAD)
+        Defs::MTI mti, NodeHandle dst, const Payload &payload = EMPTY_PAYLOAD)
     {
         auto *b = node()->iface()->addressed_message_write_flow()->alloc();
         b->data()->reset(mti, node()->node_id(), dst, payload);
@@ -536,6 +536,25 @@ public:
         if_tcp()->add_network_fd(fd, on_error);
     }
 
+    /// Enables stream transport in the interface and in the memory config
+    /// protocol.
+    void add_stream_support();
+
+    /// Helper class to add stream support straight after construction.
+    /// Usage: add following at toplevel in main.cxx
+    /// ```
+    /// SimpleTcpStack stack(NODE_ID);
+    /// SimpleTcpStack::WithStreamSupport stream_support(&stack);
+    /// ```
+    class WithStreamSupport
+    {
+    public:
+        WithStreamSupport(SimpleTcpStackBase *p)
+        {
+            p->add_stream_support();
+        }
+    };
+
 protected:
     /// Helper function for start_stack et al.
     void start_iface(bool restart) override;
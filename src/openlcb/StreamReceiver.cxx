@@ -40,30 +40,32 @@
 #include "nmranet_config.h"
 #include "openlcb/CanDefs.hxx"
 #include "openlcb/Defs.hxx"
+#include "os/os.h"
 #include "utils/format_utils.hxx"
 
 namespace openlcb
 {
 
-void StreamReceiverCan::announced_stream()
+void StreamReceiverBase::announced_stream()
 {
     // Resets state bits.
     streamClosed_ = 0;
     pendingInit_ = 0;
     pendingCancel_ = 0;
     isWaiting_ = 0;
+    isRunning_ = 0;
+    proceedPending_ = 0;
 
     if (!request()->streamWindowSize_)
     {
-        request()->streamWindowSize_ =
-            config_stream_receiver_default_window_size();
+        request()->streamWindowSize_ = defaultWindowSize_;
     }
     streamWindowRemaining_ = 0;
     node()->iface()->dispatcher()->register_handler(&streamInitiateHandler_,
         Defs::MTI_STREAM_INITIATE_REQUEST, Defs::MTI_EXACT);
 }
 
-void StreamReceiverCan::send(Buffer<StreamReceiveRequest> *msg, unsigned prio)
+void StreamReceiverBase::send(Buffer<StreamReceiveRequest> *msg, unsigned prio)
 {
     reset_message(msg, prio);
 
@@ -84,7 +86,7 @@ void StreamReceiverCan::send(Buffer<StreamReceiveRequest> *msg, unsigned prio)
     wait_for_wakeup();
 }
 
-void StreamReceiverCan::handle_stream_initiate(Buffer<GenMessage> *message)
+void StreamReceiverBase::handle_stream_initiate(Buffer<GenMessage> *message)
 {
     auto rb = get_buffer_deleter(message);
 
@@ -135,7 +137,10 @@ void StreamReceiverCan::handle_stream_initiate(Buffer<GenMessage> *message)
     }
 
     streamWindowRemaining_ = request()->streamWindowSize_;
+    proceedLead_ = request()->streamWindowSize_ / 2;
     totalByteCount_ = 0;
+    avgDataGap_ = 0;
+    windowStarting_ = 1;
 
     node()->iface()->dispatcher()->register_handler(
         &streamCompleteHandler_, Defs::MTI_STREAM_COMPLETE, Defs::MTI_EXACT);
@@ -144,11 +149,12 @@ void StreamReceiverCan::handle_stream_initiate(Buffer<GenMessage> *message)
         Defs::MTI_STREAM_INITIATE_REQUEST, Defs::MTI_EXACT);
 
     pendingInit_ = 1;
-    notify();
+    maybe_wakeup();
 }
 
-void StreamReceiverCan::handle_bytes_received(const uint8_t *data, size_t len)
+void StreamReceiverBase::handle_bytes_received(const uint8_t *data, size_t len)
 {
+    update_proceed_lead();
     while (len > 0)
     {
         if (!currentBuffer_)
@@ -187,15 +193,64 @@ void StreamReceiverCan::handle_bytes_received(const uint8_t *data, size_t len)
             // Sends off the buffer and clears currentBuffer_.
             request()->target_->send(currentBuffer_.release());
         }
+        if (!streamWindowRemaining_ && proceedPending_ && !streamClosed_)
+        {
+            start_next_window();
+        }
     } // while len > 0
-    if (!streamWindowRemaining_)
+    if (streamWindowRemaining_ <= proceedLead_)
     {
         // wake up state flow to send ack to the stream
-        notify();
+        maybe_wakeup();
+    }
+}
+
+void StreamReceiverBase::start_next_window()
+{
+    // Drops the last buffer of the previous window if it was not used.
+    lastBuffer_ = std::move(nextLastBuffer_);
+    streamWindowRemaining_ = request()->streamWindowSize_;
+    proceedPending_ = 0;
+    windowStarting_ = 1;
+}
+
+void StreamReceiverBase::update_proceed_lead()
+{
+    long long now = os_get_time_monotonic();
+    long long gap = now - lastDataTime_;
+    lastDataTime_ = now;
+    if (!windowStarting_)
+    {
+        // Tracks the usual time between two chunks of data within a window.
+        avgDataGap_ = avgDataGap_ ? (avgDataGap_ * 7 + gap) / 8 : gap;
+        return;
+    }
+    windowStarting_ = 0;
+    if (!avgDataGap_ || totalByteCount_ == 0)
+    {
+        // First data of the stream.
+        return;
+    }
+    if (gap > avgDataGap_ * 4 && gap > MIN_STALL_NSEC)
+    {
+        // The sender had to wait for the stream proceed message. Grants the
+        // next window earlier.
+        uint16_t window = request()->streamWindowSize_;
+        uint16_t step = window / 4 ? window / 4 : 1;
+        if (window - proceedLead_ > step)
+        {
+            proceedLead_ += step;
+        }
+        else
+        {
+            proceedLead_ = window;
+        }
+        LOG(VERBOSE, "stream stalled for %u usec, proceed lead %u",
+            (unsigned)(gap / 1000), proceedLead_);
     }
 }
 
-void StreamReceiverCan::handle_stream_complete(Buffer<GenMessage> *message)
+void StreamReceiverBase::handle_stream_complete(Buffer<GenMessage> *message)
 {
     auto rb = get_buffer_deleter(message);
 
@@ -244,94 +299,46 @@ void StreamReceiverCan::handle_stream_complete(Buffer<GenMessage> *message)
     if (!streamWindowRemaining_)
     {
         // wake up the flow.
-        notify();
+        maybe_wakeup();
     }
 
     node()->iface()->dispatcher()->unregister_handler(
         &streamCompleteHandler_, Defs::MTI_STREAM_COMPLETE, Defs::MTI_EXACT);
 }
 
-class StreamReceiverCan::StreamDataHandler : public IncomingFrameHandler
-{
-public:
-    StreamDataHandler(StreamReceiverCan *parent)
-        : parent_(parent)
-    { }
-
-    /// Starts registration for receiving stream data with the given aliases.
-    void start(NodeAlias remote_alias, NodeAlias local_alias)
-    {
-        HASSERT(remote_alias);
-        HASSERT(local_alias);
-        uint32_t frame_id = 0;
-        CanDefs::set_datagram_fields(
-            &frame_id, remote_alias, local_alias, CanDefs::STREAM_DATA);
-        LOG(VERBOSE, "register frame ID %x", (unsigned)frame_id);
-        parent_->if_can()->frame_dispatcher()->register_handler(
-            this, frame_id, CanDefs::STREAM_DG_RECV_MASK);
-    }
-
-    /// Stops receiving stream data.
-    void stop()
-    {
-        parent_->if_can()->frame_dispatcher()->unregister_handler_all(this);
-    }
-
-    /// Handler callback for incoming messages.
-    void send(Buffer<CanMessageData> *message, unsigned priority) override
-    {
-        auto rb = get_buffer_deleter(message);
-
-        if (message->data()->can_dlc <= 0)
-        {
-            return; // no payload
-        }
-        if (message->data()->data[0] != parent_->request()->localStreamId_)
-        {
-            return; // different stream
-        }
-        parent_->handle_bytes_received(
-            message->data()->data + 1, message->data()->can_dlc - 1);
-    }
-
-private:
-    /// Owning stream receiver object.
-    StreamReceiverCan *parent_;
-};
-
-StreamReceiverCan::StreamReceiverCan(IfCan *interface, uint8_t local_stream_id)
+StreamReceiverBase::StreamReceiverBase(
+    If *interface, uint8_t local_stream_id, uint16_t default_window)
     : StreamReceiverInterface(interface)
-    , dataHandler_(new StreamDataHandler(this))
+    , defaultWindowSize_(default_window)
     , assignedStreamId_(local_stream_id)
     , streamClosed_(0)
     , pendingInit_(0)
     , pendingCancel_(0)
     , isWaiting_(0)
+    , isRunning_(0)
+    , proceedPending_(0)
+    , windowStarting_(0)
 { }
 
-StreamReceiverCan::~StreamReceiverCan()
+StreamReceiverBase::~StreamReceiverBase()
 { }
 
-void StreamReceiverCan::cancel_request()
+void StreamReceiverBase::cancel_request()
 {
     pendingCancel_ = 1;
-    if (isWaiting_)
-    {
-        isWaiting_ = 0;
-        notify();
-    }
+    maybe_wakeup();
 }
 
-void StreamReceiverCan::unregister_handlers()
+void StreamReceiverBase::unregister_handlers()
 {
-    dataHandler_->stop();
+    stop_data();
     node()->iface()->dispatcher()->unregister_handler_all(
         &streamInitiateHandler_);
     node()->iface()->dispatcher()->unregister_handler_all(
         &streamCompleteHandler_);
 }
 
-StateFlowBase::Action StreamReceiverCan::wakeup()
+StateFlowBase::Action StreamReceiverBase::wakeup()
 {
     isWaiting_ = 0;
     // Checks reason for wakeup.
@@ -343,6 +350,9 @@ StateFlowBase::Action StreamReceiverCan::wakeup()
             // Sends off the buffer and clears currentBuffer_.
             request()->target_->send(currentBuffer_.release());
         }
+        isRunning_ = 0;
+        lastBuffer_.reset();
+        nextLastBuffer_.reset();
         return return_with_error(StreamReceiveRequest::ERROR_CANCELED);
     }
     if (pendingInit_)
@@ -350,62 +360,187 @@ StateFlowBase::Action StreamReceiverCan::wakeup()
         pendingInit_ = 0;
         return call_immediately(STATE(init_reply));
     }
-    if (!streamWindowRemaining_)
+    if (isRunning_ && !streamWindowRemaining_ && streamClosed_)
     {
-        if (streamClosed_)
+        streamClosed_ = 0;
+        isRunning_ = 0;
+        stop_data();
+        if (currentBuffer_)
         {
-            streamClosed_ = 0;
-            dataHandler_->stop();
-            if (currentBuffer_)
-            {
-                // Sends off the buffer and clears currentBuffer_.
-                request()->target_->send(currentBuffer_.release());
-            }
-            return return_ok();
+            // Sends off the buffer and clears currentBuffer_.
+            request()->target_->send(currentBuffer_.release());
         }
-        // Need to send an ack.
+        lastBuffer_.reset();
+        nextLastBuffer_.reset();
+        return return_ok();
+    }
+    if (isRunning_ && !streamClosed_ && !proceedPending_ &&
+        (!streamWindowRemaining_ ||
+            (streamWindowRemaining_ <= proceedLead_ &&
+                lastBufferPool_.free_items())))
+    {
+        // Need to send an ack. Before the end of the window we only do this
+        // if the data sink has consumed enough data that we have a free
+        // buffer.
         return call_immediately(STATE(window_reached));
     }
+    isWaiting_ = 1;
     return wait();
 }
 
-StateFlowBase::Action StreamReceiverCan::init_reply()
+StateFlowBase::Action StreamReceiverBase::init_reply()
 {
     // Initialize the last buffer for the first window.
     return allocate_and_call<RawData>(
         nullptr, STATE(init_buffer_ready), &lastBufferPool_);
 }
 
-StateFlowBase::Action StreamReceiverCan::init_buffer_ready()
+StateFlowBase::Action StreamReceiverBase::init_buffer_ready()
 {
     lastBuffer_.reset(get_allocation_result<RawData>(nullptr));
 
     node()->iface()->canonicalize_handle(&request()->src_);
-    NodeHandle local(node()->node_id());
-    node()->iface()->canonicalize_handle(&local);
-    dataHandler_->start(request()->src_.alias, local.alias);
+    start_data();
 
     send_message(node(), Defs::MTI_STREAM_INITIATE_REPLY, request()->src_,
         StreamDefs::create_initiate_response(request()->streamWindowSize_,
             request()->srcStreamId_, request()->localStreamId_));
 
-    return wait_for_wakeup();
+    isRunning_ = 1;
+    return call_immediately(STATE(wakeup));
 }
 
-StateFlowBase::Action StreamReceiverCan::window_reached()
+StateFlowBase::Action StreamReceiverBase::window_reached()
 {
     return allocate_and_call<RawData>(
         nullptr, STATE(have_raw_buffer), &lastBufferPool_);
 }
 
-StateFlowBase::Action StreamReceiverCan::have_raw_buffer()
+StateFlowBase::Action StreamReceiverBase::have_raw_buffer()
 {
-    lastBuffer_.reset(get_allocation_result<RawData>(nullptr));
-    streamWindowRemaining_ = request()->streamWindowSize_;
+    RawBufferPtr rb(get_allocation_result<RawData>(nullptr));
+    if (streamClosed_ || pendingCancel_)
+    {
+        // The sender will not need another window.
+        return call_immediately(STATE(wakeup));
+    }
+    nextLastBuffer_ = std::move(rb);
+    proceedPending_ = 1;
     send_message(node(), Defs::MTI_STREAM_PROCEED, request()->src_,
         StreamDefs::create_data_proceed(
             request()->srcStreamId_, request()->localStreamId_));
-    return wait_for_wakeup();
+    if (!streamWindowRemaining_)
+    {
+        start_next_window();
+    }
+    return call_immediately(STATE(wakeup));
+}
+
+class StreamReceiverCan::StreamDataHandler : public IncomingFrameHandler
+{
+public:
+    StreamDataHandler(StreamReceiverCan *parent)
+        : parent_(parent)
+    { }
+
+    /// Starts registration for receiving stream data with the given aliases.
+    void start(NodeAlias remote_alias, NodeAlias local_alias)
+    {
+        HASSERT(remote_alias);
+        HASSERT(local_alias);
+        uint32_t frame_id = 0;
+        CanDefs::set_datagram_fields(
+            &frame_id, remote_alias, local_alias, CanDefs::STREAM_DATA);
+        LOG(VERBOSE, "register frame ID %x", (unsigned)frame_id);
+        parent_->if_can()->frame_dispatcher()->register_handler(
+            this, frame_id, CanDefs::STREAM_DG_RECV_MASK);
+    }
+
+    /// Stops receiving stream data.
+    void stop()
+    {
+        parent_->if_can()->frame_dispatcher()->unregister_handler_all(this);
+    }
+
+    /// Handler callback for incoming messages.
+    void send(Buffer<CanMessageData> *message, unsigned priority) override
+    {
+        auto rb = get_buffer_deleter(message);
+
+        if (message->data()->can_dlc <= 0)
+        {
+            return; // no payload
+        }
+        if (message->data()->data[0] != parent_->request()->localStreamId_)
+        {
+            return; // different stream
+        }
+        parent_->handle_bytes_received(
+            message->data()->data + 1, message->data()->can_dlc - 1);
+    }
+
+private:
+    /// Owning stream receiver object.
+    StreamReceiverCan *parent_;
+};
+
+StreamReceiverCan::StreamReceiverCan(IfCan *interface, uint8_t local_stream_id)
+    : StreamReceiverBase(interface, local_stream_id,
+          config_stream_receiver_default_window_size())
+    , dataHandler_(new StreamDataHandler(this))
+{ }
+
+StreamReceiverCan::~StreamReceiverCan()
+{ }
+
+void StreamReceiverCan::start_data()
+{
+    NodeHandle local(node()->node_id());
+    node()->iface()->canonicalize_handle(&local);
+    dataHandler_->start(request()->src_.alias, local.alias);
+}
+
+void StreamReceiverCan::stop_data()
+{
+    dataHandler_->stop();
+}
+
+StreamReceiverTcp::StreamReceiverTcp(If *interface, uint8_t local_stream_id)
+    : StreamReceiverBase(interface, local_stream_id,
+          config_stream_receiver_tcp_window_size())
+{ }
+
+StreamReceiverTcp::~StreamReceiverTcp()
+{ }
+
+void StreamReceiverTcp::start_data()
+{
+    node()->iface()->dispatcher()->register_handler(
+        &streamDataHandler_, Defs::MTI_STREAM_DATA, Defs::MTI_EXACT);
+}
+
+void StreamReceiverTcp::stop_data()
+{
+    node()->iface()->dispatcher()->unregister_handler_all(&streamDataHandler_);
+}
+
+void StreamReceiverTcp::handle_stream_data(Buffer<GenMessage> *message)
+{
+    auto rb = get_buffer_deleter(message);
+
+    if (message->data()->dstNode != node() ||
+        !node()->iface()->matching_node(request()->src_, message->data()->src))
+    {
+        return; // not for me
+    }
+    const auto &payload = message->data()->payload;
+    if (payload.empty() ||
+        (uint8_t)payload[0] != request()->localStreamId_)
+    {
+        return; // different stream
+    }
+    handle_bytes_received(
+        (const uint8_t *)payload.data() + 1, payload.size() - 1);
 }
 
 } // namespace openlcb
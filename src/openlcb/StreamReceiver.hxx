@@ -46,17 +46,31 @@
 namespace openlcb
 {
 
-class StreamReceiverCan : public StreamReceiverInterface
+/// Implements the receiving side of the stream protocol (initiate, flow
+/// control, close), independent of the interface type. Subclasses implement
+/// receiving the data bytes in the format of the specific interface.
+///
+/// Flow control: the stream proceed for the next window is sent before the
+/// current window is complete, when only proceedLead_ bytes are left of it. So
+/// the sender can keep sending without waiting for a round trip at every
+/// window boundary. The lead starts at half of the window, and grows when we
+/// see that the sender had stalled at a window boundary. The next window is
+/// only granted when the data sink has freed up the buffers of earlier windows
+/// (see lastBufferPool_), so a slow consumer throttles the sender.
+class StreamReceiverBase : public StreamReceiverInterface
 {
 public:
     /// Constructor.
     ///
-    /// @param interface the CAN interface that owns this stream receiver.
+    /// @param interface the interface that owns this stream receiver.
     /// @param local_stream_id what should be the local stream ID for the
     /// streams used for this receiver.
-    StreamReceiverCan(IfCan *interface, uint8_t local_stream_id);
+    /// @param default_window stream window size to use when the request does
+    /// not specify one.
+    StreamReceiverBase(
+        If *interface, uint8_t local_stream_id, uint16_t default_window);
 
-    ~StreamReceiverCan();
+    ~StreamReceiverBase();
 
     /// Implements the flow interface for the request API. This is not based on
     /// entry() because the registration has to be synchrnous with the calling
@@ -67,7 +81,25 @@ public:
     /// then be asynchronously returned using the regular mechanism with a
     /// temporary error.
     void cancel_request() override;
-    
+
+protected:
+    /// Starts receiving the stream data from the interface. Called when the
+    /// stream initiate request was accepted. request()->src_ is already
+    /// canonicalized.
+    virtual void start_data() = 0;
+
+    /// Stops receiving the stream data from the interface.
+    virtual void stop_data() = 0;
+
+    /// Handles data arriving from the network.
+    void handle_bytes_received(const uint8_t *data, size_t len);
+
+    /// @return the local node pointer.
+    Node *node()
+    {
+        return request()->dst_;
+    }
+
 private:
     /// Helper function for send() when a stream has to start synchronously.
     void announced_stream();
@@ -78,6 +110,9 @@ private:
         return return_ok();
     }
 
+    /// Sets the flow to wait for a notification. Used outside of the state
+    /// flow; the states call wakeup() directly instead, to pick up the events
+    /// that arrived while the flow was busy.
     Action wait_for_wakeup()
     {
         if (pendingCancel_)
@@ -88,19 +123,38 @@ private:
         return wait_and_call(STATE(wakeup));
     }
 
-    /// Root of the flow when something happens in the handlers.
+    /// Root of the flow when something happens in the handlers. Checks what
+    /// needs to be done, and if nothing, waits for the next notification.
     Action wakeup();
 
+    /// Notifies the state flow if it is waiting in wakeup().
+    void maybe_wakeup()
+    {
+        if (isWaiting_)
+        {
+            isWaiting_ = 0;
+            notify();
+        }
+    }
+
+    /// Switches the data reception to the next stream window, which was
+    /// already granted to the sender.
+    void start_next_window();
+
+    /// Called when data arrives. Detects if the sender had to stall at the
+    /// beginning of this window, and if so, increases the proceed lead.
+    void update_proceed_lead();
+
     /// Invoked when we get the stream initiate request. Initializes receive
     /// buffers and sends stream init response.
     Action init_reply();
     Action init_buffer_ready();
 
-    /// Invoked when the stream window runs out. Maybe waits for the data to be
-    /// consumed below the low-watermark.
+    /// Invoked when the remaining stream window goes below the proceed lead.
+    /// Maybe waits for the data to be consumed below the low-watermark.
     Action window_reached();
     /// Called when the allocation of the raw buffer is successful. Sends off
-    /// the stream proceed message.
+    /// the stream proceed message for the next window.
     Action have_raw_buffer();
 
     /// Invoked by the GenericHandler when a stream initiate message arrives.
@@ -109,9 +163,6 @@ private:
     ///
     void handle_stream_initiate(Buffer<GenMessage> *message);
 
-    /// Handles data arriving from the network.
-    inline void handle_bytes_received(const uint8_t *data, size_t len);
-
     /// Invoked by the GenericHandler when a stream complete message arrives.
     ///
     /// @param message buffer with stream complete message.
@@ -120,34 +171,25 @@ private:
 
     /// Removes all handlers that are registered.
     void unregister_handlers();
-    
-    /// @return the local CAN interface.
-    IfCan *if_can()
-    {
-        return static_cast<IfCan *>(service());
-    }
 
-    /// @return the local node pointer.
-    Node *node()
-    {
-        return request()->dst_;
-    }
+    /// If the data at the beginning of a window arrives this much later than
+    /// the previous data, we consider that the sender has stalled.
+    static constexpr long long MIN_STALL_NSEC = MSEC_TO_NSEC(1);
 
     /// Helper class for incoming message for stream initiate.
     MessageHandler::GenericHandler streamInitiateHandler_ {
-        this, &StreamReceiverCan::handle_stream_initiate};
-
-    class StreamDataHandler;
-    friend class StreamDataHandler;
+        this, &StreamReceiverBase::handle_stream_initiate};
 
     /// Helper class for incoming message for stream complete.
     MessageHandler::GenericHandler streamCompleteHandler_ {
-        this, &StreamReceiverCan::handle_stream_complete};
+        this, &StreamReceiverBase::handle_stream_complete};
 
     /// This pool is used to allocate one raw buffer per stream window
     /// size. This pool therefore functions as a throttling for the data
     /// producer. We have a fixed size of 2, meaning that we are allowing
-    /// ourselves to load 2x the stream window size into our RAM.
+    /// ourselves to load 2x the stream window size into our RAM. This counts
+    /// the windows granted to the sender but not arrived yet, as well as the
+    /// windows arrived but not consumed by the data sink.
     LimitedPool lastBufferPool_ {sizeof(RawBuffer), 2, rawBufferPool};
 
     /// The buffer that we are currently filling with incoming data.
@@ -157,14 +199,29 @@ private:
     /// comes from the lastBufferPool_ to function as throttling signal.
     RawBufferPtr lastBuffer_;
 
-    /// Helper object that receives the actual stream CAN frames.
-    std::unique_ptr<StreamDataHandler> dataHandler_;
+    /// The buffer that will be the last one in the next stream window, if we
+    /// already sent the stream proceed for that window.
+    RawBufferPtr nextLastBuffer_;
 
     /// How many bytes we have transmitted in this stream so far.
     size_t totalByteCount_;
 
-    /// Remaining stream window size.
-    uint16_t streamWindowRemaining_;
+    /// When the last stream data arrived (os_get_time_monotonic).
+    long long lastDataTime_ {0};
+
+    /// Average time between two chunks of stream data arriving, in nsec.
+    long long avgDataGap_ {0};
+
+    /// Remaining stream window size. After the stream complete message
+    /// arrived, this is the number of bytes still to arrive.
+    uint32_t streamWindowRemaining_;
+
+    /// When this many bytes are left from the current window, we send the
+    /// stream proceed for the next window.
+    uint16_t proceedLead_;
+
+    /// Window size to use when the request does not specify one.
+    const uint16_t defaultWindowSize_;
 
     /// Unique stream ID at the destination (local) node, assigned at
     /// construction time.
@@ -178,7 +235,75 @@ private:
     uint8_t pendingCancel_ : 1;
     /// 1 if we are currently waiting for a notification
     uint8_t isWaiting_ : 1;
-}; // class StreamReceiver
+    /// 1 if we sent the stream initiate reply, and the data is flowing.
+    uint8_t isRunning_ : 1;
+    /// 1 if we already sent the stream proceed for the next window.
+    uint8_t proceedPending_ : 1;
+    /// 1 if the current window has not received any data yet.
+    uint8_t windowStarting_ : 1;
+}; // class StreamReceiverBase
+
+/// Stream receiver for a CAN interface. The stream data arrives in dedicated
+/// CAN frames.
+class StreamReceiverCan : public StreamReceiverBase
+{
+public:
+    /// Constructor.
+    ///
+    /// @param interface the CAN interface that owns this stream receiver.
+    /// @param local_stream_id what should be the local stream ID for the
+    /// streams used for this receiver.
+    StreamReceiverCan(IfCan *interface, uint8_t local_stream_id);
+
+    ~StreamReceiverCan();
+
+private:
+    void start_data() override;
+    void stop_data() override;
+
+    /// @return the local CAN interface.
+    IfCan *if_can()
+    {
+        return static_cast<IfCan *>(service());
+    }
+
+    class StreamDataHandler;
+    friend class StreamDataHandler;
+
+    /// Helper object that receives the actual stream CAN frames.
+    std::unique_ptr<StreamDataHandler> dataHandler_;
+}; // class StreamReceiverCan
+
+/// Stream receiver for an interface that carries whole OpenLCB messages, such
+/// as OpenLCB-TCP. The stream data arrives in Stream Data Send messages. The
+/// default stream window is larger than on CAN (see
+/// config_stream_receiver_tcp_window_size()).
+class StreamReceiverTcp : public StreamReceiverBase
+{
+public:
+    /// Constructor.
+    ///
+    /// @param interface the interface that owns this stream receiver.
+    /// @param local_stream_id what should be the local stream ID for the
+    /// streams used for this receiver.
+    StreamReceiverTcp(If *interface, uint8_t local_stream_id);
+
+    ~StreamReceiverTcp();
+
+private:
+    void start_data() override;
+    void stop_data() override;
+
+    /// Invoked by the GenericHandler when a stream data message arrives.
+    ///
+    /// @param message buffer with stream data message.
+    ///
+    void handle_stream_data(Buffer<GenMessage> *message);
+
+    /// Helper class for incoming stream data messages.
+    MessageHandler::GenericHandler streamDataHandler_ {
+        this, &StreamReceiverTcp::handle_stream_data};
+}; // class StreamReceiverTcp
 
 } // namespace openlcb
 
@@ -36,6 +36,8 @@
 #ifndef _OPENLCB_STREAMSENDER_HXX_
 #define _OPENLCB_STREAMSENDER_HXX_
 
+#include <functional>
+
 #include "executor/StateFlow.hxx"
 #include "openlcb/CanDefs.hxx"
 #include "openlcb/DatagramDefs.hxx"
@@ -48,14 +50,30 @@
 namespace openlcb
 {
 
+/// Helper class for sending stream data to a remote node. Implements the
+/// stream protocol (initiate, flow control, close), independent of the
+/// interface type. Subclasses implement sending the data bytes in the format
+/// of the specific interface.
+///
+/// The receiver may grant more windows before the current one is used up;
+/// these add up, so the sender only stalls when it has used all granted
+/// windows.
 class StreamSender : public StateFlow<ByteBuffer, QList<1>>
 {
 public:
     StreamSender(Service *s)
         : StateFlow<ByteBuffer, QList<1>>(s)
+        , isLoopbackStream_(false)
+        , sleeping_(false)
+        , requestClose_(false)
+        , requestInit_(false)
     {
     }
 
+    /// Callback for reporting the progress of the stream.
+    /// @param bytes_sent total number of bytes sent in the stream so far.
+    typedef std::function<void(uint32_t bytes_sent)> ProgressCallback;
+
     /// Describes the different states in the stream sender.
     enum StreamSenderState : uint8_t
     {
@@ -74,21 +92,6 @@ public:
         /// An error occurred.
         STATE_ERROR
     };
-};
-
-/// Helper class for sending stream data to a CAN interface.
-/// @todo add progress report API.
-class StreamSenderCan : public StreamSender
-{
-public:
-    StreamSenderCan(Service *service, IfCan *iface)
-        : StreamSender(service)
-        , ifCan_(iface)
-        , sleeping_(false)
-        , requestClose_(false)
-        , requestInit_(false)
-    {
-    }
 
     /// Initiates using the stream sender. May be called only on idle stream
     /// senders.
@@ -102,7 +105,7 @@ public:
     ///
     /// @return *this for calling optional settings API commands.
     ///
-    StreamSenderCan &start_stream(Node *src, NodeHandle dst,
+    StreamSender &start_stream(Node *src, NodeHandle dst,
         uint8_t source_stream_id,
         uint8_t dst_stream_id = StreamDefs::INVALID_STREAM_ID)
     {
@@ -116,12 +119,14 @@ public:
         HASSERT(sleeping_ == false);
         HASSERT(requestClose_ == 0);
         requestInit_ = true;
-        trigger();
         streamFlags_ = 0;
         streamAdditionalFlags_ = 0;
         streamWindowSize_ = StreamDefs::MAX_PAYLOAD;
         streamWindowRemaining_ = 0;
         errorCode_ = 0;
+        // Must be last, because the state flow might start running right
+        // away on a different thread.
+        trigger();
         return *this;
     }
 
@@ -142,20 +147,34 @@ public:
     /// @param window_size in bytes, what should we propose in the stream
     /// initiate call
     ///
-    StreamSenderCan &set_proposed_window_size(uint16_t window_size)
+    StreamSender &set_proposed_window_size(uint16_t window_size)
     {
         HASSERT(state_ == STARTED);
         streamWindowSize_ = window_size;
         return *this;
     }
 
+    /// Sets a function to be called every time the destination grants a new
+    /// stream window (sends a stream proceed message). Must be called before
+    /// start_stream, because after that the state flow may already be
+    /// running on the executor of the interface, which is where the callback
+    /// is invoked. The callback stays in effect until clear() is called.
+    ///
+    /// @param cb the callback; nullptr to clear.
+    ///
+    StreamSender &set_progress_callback(ProgressCallback cb)
+    {
+        progressCallback_ = std::move(cb);
+        return *this;
+    }
+
     /// Specifies the Stream UID to send in the stream initiate request. May be
     /// called only after start_stream. This function must be used if opening
     /// an unannounced stream to a destination.
     ///
     /// @param stream_uid a valid 6-byte stream identifier.
     ///
-    StreamSenderCan &set_stream_uid(NodeID stream_uid)
+    StreamSender &set_stream_uid(NodeID stream_uid)
     {
         HASSERT(state_ == STARTED);
         /// @todo implement opening unannounced streams.
@@ -169,6 +188,7 @@ public:
         if (state_ == STATE_ERROR || state_ == CLOSING)
         {
             state_ = IDLE;
+            progressCallback_ = nullptr;
         }
     }
 
@@ -241,7 +261,54 @@ public:
             }
             return release_and_exit();
         }
-        return call_immediately(STATE(allocate_can_buffer));
+        return send_data();
+    }
+
+protected:
+    /// Sends (some of) the data from the current chunk to the destination,
+    /// then continues with entry(). Called only when there is data to send
+    /// and the stream window is not exhausted.
+    virtual Action send_data() = 0;
+
+    /// @param max_len how many bytes we can send in a single message (or
+    /// frame) on the interface.
+    /// @return how many bytes of data we can put into the next message.
+    size_t compute_next_length(size_t max_len)
+    {
+        size_t ret = remaining();
+        // Cannot exceed the message's max payload.
+        if (ret > max_len)
+        {
+            ret = max_len;
+        }
+        // Cannot exceed remaining bytes in stream window.
+        if (ret > streamWindowRemaining_)
+        {
+            ret = streamWindowRemaining_;
+        }
+        return ret;
+    }
+
+    /// @return the number of bytes available in the current chunk.
+    size_t remaining()
+    {
+        return message()->data()->size_;
+    }
+
+    /// @return pointer to the beginning of the data to send.
+    uint8_t *payload()
+    {
+        return message()->data()->data_;
+    }
+
+    /// Consumes a certain number of bytes from the beginning of the data to
+    /// send.
+    /// @param num_bytes how much data to consume.
+    void advance(size_t num_bytes)
+    {
+        message()->data()->advance(num_bytes);
+        totalByteCount_ += num_bytes;
+        streamWindowRemaining_ -= num_bytes;
     }
 
 private:
@@ -289,7 +356,7 @@ private:
     void stream_initiate_replied(Buffer<GenMessage> *message)
     {
         LOG(VERBOSE, "stream init reply: %s",
-            string_to_hex(message->data()->payload).c_str());
+            string_to_hex(string(message->data()->payload)).c_str());
         auto rb = get_buffer_deleter(message);
         if (message->data()->dstNode != node_ ||
             !node_->iface()->matching_node(dst_, message->data()->src))
@@ -385,45 +452,6 @@ private:
         return entry();
     }
 
-    /// Allocates a buffer for a CAN frame (for payload send).
-    Action allocate_can_buffer()
-    {
-        return allocate_and_call(
-            ifCan_->frame_write_flow(), STATE(got_frame), &canFramePool_);
-    }
-
-    /// Got a buffer for an output frame (payload send).
-    Action got_frame()
-    {
-        auto *b = get_allocation_result(ifCan_->frame_write_flow());
-
-        uint32_t can_id;
-        NodeAlias local_alias =
-            ifCan_->local_aliases()->lookup(node_->node_id());
-        NodeAlias remote_alias = dst_.alias;
-        CanDefs::set_datagram_fields(
-            &can_id, local_alias, remote_alias, CanDefs::STREAM_DATA);
-        auto *frame = b->data()->mutable_frame();
-        SET_CAN_FRAME_ID_EFF(*frame, can_id);
-
-        size_t len = compute_next_can_length();
-
-        frame->can_dlc = len + 1;
-        frame->data[0] = dstStreamId_;
-        memcpy(&frame->data[1], payload(), len);
-        advance(len);
-
-        if (!isLoopbackStream_)
-        {
-            ifCan_->frame_write_flow()->send(b);
-        }
-        else
-        {
-            ifCan_->loopback_frame_write_flow()->send(b);
-        }
-        return entry();
-    }
-
     /// Starts sleeping until a proceed message arrives. Run this state when
     /// streamWindowRemaining_ == 0.
     Action wait_for_stream_proceed()
@@ -457,9 +485,11 @@ private:
             return;
         }
 
-        /// @todo add progress callback API
-
         streamWindowRemaining_ += streamWindowSize_;
+        if (progressCallback_)
+        {
+            progressCallback_(totalByteCount_);
+        }
         if (sleeping_)
         {
             sleeping_ = false;
@@ -481,46 +511,6 @@ private:
         return entry();
     }
 
-private:
-    /// @return how many bytes of data we can put into the next CAN frame.
-    size_t compute_next_can_length()
-    {
-        size_t ret = remaining();
-        // Cannot exceed CAN frame max payload.
-        if (ret > MAX_BYTES_PAYLOAD_PER_CAN_FRAME)
-        {
-            ret = MAX_BYTES_PAYLOAD_PER_CAN_FRAME;
-        }
-        // Cannot exceed remaining bytes in stream window.
-        if (ret > streamWindowRemaining_)
-        {
-            ret = streamWindowRemaining_;
-        }
-        return ret;
-    }
-
-    /// @return the number of bytes available in the current chunk.
-    size_t remaining()
-    {
-        return message()->data()->size_;
-    }
-
-    /// @return pointer to the beginning of the data to send.
-    uint8_t *payload()
-    {
-        return message()->data()->data_;
-    }
-
-    /// Consumes a certain number of bytes from the beginning of the data to
-    /// send.
-    /// @param num_bytes how much data to consume.
-    void advance(size_t num_bytes)
-    {
-        message()->data()->advance(num_bytes);
-        totalByteCount_ += num_bytes;
-        streamWindowRemaining_ -= num_bytes;
-    }
-
     Action return_error(uint32_t code, string message)
     {
         LOG(INFO, "error %x: %s", (unsigned)code, message.c_str());
@@ -537,42 +527,37 @@ private:
     /// with a timeout.
     static constexpr size_t STREAM_INIT_TIMEOUT_SEC = 20;
 
-    /// How many bytes payload we can copy into a single CAN frame.
-    static constexpr size_t MAX_BYTES_PAYLOAD_PER_CAN_FRAME = 7;
-
-    /// How many CAN frames should we allocate at a given time.
-    static constexpr size_t MAX_FRAMES_IN_FLIGHT = 4;
-
-    /// How many bytes the allocation of a single CAN frame should be.
-    static constexpr size_t CAN_FRAME_ALLOC_SIZE =
-        sizeof(CanFrameWriteFlow::message_type);
-
     /// Handles incoming stream proceed messages.
     MessageHandler::GenericHandler streamProceedHandler_ {
-        this, &StreamSenderCan::stream_proceed_received};
+        this, &StreamSender::stream_proceed_received};
     /// Handles incoming stream initiate reply messages.
     MessageHandler::GenericHandler streamInitiateReplyHandler_ {
-        this, &StreamSenderCan::stream_initiate_replied};
+        this, &StreamSender::stream_initiate_replied};
 
-    /// CAN-bus interface.
-    IfCan *ifCan_;
+protected:
     /// Which node are we sending the outgoing data from. This is a local
     /// virtual node.
     Node *node_ {nullptr};
     /// Destination node that we are sending to. It is important that the alias
     /// is filled in here.
     NodeHandle dst_;
+
+private:
     /// How many bytes we have transmitted in this stream so far.
     size_t totalByteCount_ {0};
     /// What state the current class is in.
     StreamSenderState state_ {IDLE};
     /// Stream ID at the source node. @todo fill in
     uint8_t localStreamId_ {StreamDefs::INVALID_STREAM_ID};
+
+protected:
     /// Stream ID at the destination node. @todo fill in
     uint8_t dstStreamId_ {StreamDefs::INVALID_STREAM_ID};
     /// Determines whether the stream transmission is happening to
     /// localhost. Almost never true.
     uint8_t isLoopbackStream_ : 1;
+
+private:
     /// True if we are waiting for the timer.
     uint8_t sleeping_ : 1;
     /// 1 if there is a pending close request.
@@ -585,16 +570,140 @@ private:
     uint8_t streamAdditionalFlags_ {0};
     /// Total stream window size. @todo fill in
     uint16_t streamWindowSize_ {StreamDefs::MAX_PAYLOAD};
-    /// Remaining stream window size. @todo fill in
-    uint16_t streamWindowRemaining_ {0};
+    /// How many bytes we may send before we need another stream proceed
+    /// message. This may be more than one window if the receiver sent the
+    /// stream proceed messages ahead of time.
+    uint32_t streamWindowRemaining_ {0};
     /// When the stream process fails, this variable contains an error code.
     uint32_t errorCode_ {0};
+    /// Called when a stream proceed message arrives.
+    ProgressCallback progressCallback_;
+    /// Helper object for timeouts.
+    StateFlowTimer timer_ {this};
+};
+
+/// Helper class for sending stream data to a CAN interface.
+class StreamSenderCan : public StreamSender
+{
+public:
+    StreamSenderCan(Service *service, IfCan *iface)
+        : StreamSender(service)
+        , ifCan_(iface)
+    {
+    }
+
+private:
+    Action send_data() override
+    {
+        return call_immediately(STATE(allocate_can_buffer));
+    }
+
+    /// Allocates a buffer for a CAN frame (for payload send).
+    Action allocate_can_buffer()
+    {
+        return allocate_and_call(
+            ifCan_->frame_write_flow(), STATE(got_frame), &canFramePool_);
+    }
+
+    /// Got a buffer for an output frame (payload send).
+    Action got_frame()
+    {
+        auto *b = get_allocation_result(ifCan_->frame_write_flow());
+
+        uint32_t can_id;
+        NodeAlias local_alias =
+            ifCan_->local_aliases()->lookup(node_->node_id());
+        NodeAlias remote_alias = dst_.alias;
+        CanDefs::set_datagram_fields(
+            &can_id, local_alias, remote_alias, CanDefs::STREAM_DATA);
+        auto *frame = b->data()->mutable_frame();
+        SET_CAN_FRAME_ID_EFF(*frame, can_id);
+
+        size_t len = compute_next_length(MAX_BYTES_PAYLOAD_PER_CAN_FRAME);
+
+        frame->can_dlc = len + 1;
+        frame->data[0] = dstStreamId_;
+        memcpy(&frame->data[1], payload(), len);
+        advance(len);
+
+        if (!isLoopbackStream_)
+        {
+            ifCan_->frame_write_flow()->send(b);
+        }
+        else
+        {
+            ifCan_->loopback_frame_write_flow()->send(b);
+        }
+        return entry();
+    }
+
+    /// How many bytes payload we can copy into a single CAN frame.
+    static constexpr size_t MAX_BYTES_PAYLOAD_PER_CAN_FRAME = 7;
+
+    /// How many CAN frames should we allocate at a given time.
+    static constexpr size_t MAX_FRAMES_IN_FLIGHT = 4;
+
+    /// How many bytes the allocation of a single CAN frame should be.
+    static constexpr size_t CAN_FRAME_ALLOC_SIZE =
+        sizeof(CanFrameWriteFlow::message_type);
+
+    /// CAN-bus interface.
+    IfCan *ifCan_;
     /// Source of buffers for outgoing CAN frames. Limtedpool is allocating and
     /// releasing to the mainBufferPool, but blocks when we exceed a certain
     /// number of allocations until some buffers get freed.
     LimitedPool canFramePool_ {CAN_FRAME_ALLOC_SIZE, MAX_FRAMES_IN_FLIGHT};
-    /// Helper object for timeouts.
-    StateFlowTimer timer_ {this};
+};
+
+/// Helper class for sending stream data to an interface that carries whole
+/// OpenLCB messages, such as OpenLCB-TCP. The data is sent in Stream Data
+/// Send messages that are as large as fit into a TCP segment.
+class StreamSenderTcp : public StreamSender
+{
+public:
+    StreamSenderTcp(Service *service, If *iface)
+        : StreamSender(service)
+        , iface_(iface)
+    {
+    }
+
+    /// How many bytes of stream payload we put into a single message. This
+    /// fills a 1460 byte TCP segment with the 17 bytes OpenLCB-TCP header,
+    /// 14 bytes addressed message header and the destination stream ID.
+    static constexpr size_t MAX_BYTES_PAYLOAD_PER_MESSAGE = 1460 - 17 - 14 - 1;
+
+private:
+    Action send_data() override
+    {
+        return allocate_and_call(iface_->addressed_message_write_flow(),
+            STATE(got_message), &messagePool_);
+    }
+
+    /// Got a buffer for an outgoing message (payload send).
+    Action got_message()
+    {
+        auto *b = get_allocation_result(iface_->addressed_message_write_flow());
+        size_t len = compute_next_length(MAX_BYTES_PAYLOAD_PER_MESSAGE);
+        b->data()->reset(Defs::MTI_STREAM_DATA, node_->node_id(), dst_,
+            EMPTY_PAYLOAD);
+        auto &p = b->data()->payload;
+        p.reserve(len + 1);
+        p.push_back(dstStreamId_);
+        p.append((const char *)payload(), len);
+        advance(len);
+        iface_->addressed_message_write_flow()->send(b);
+        return entry();
+    }
+
+    /// How many messages should we allocate at a given time.
+    static constexpr size_t MAX_MESSAGES_IN_FLIGHT = 4;
+
+    /// OpenLCB interface.
+    If *iface_;
+    /// Source of buffers for outgoing messages. Limits how much of the data
+    /// gets copied into messages ahead of the network.
+    LimitedPool messagePool_ {
+        sizeof(Buffer<GenMessage>), MAX_MESSAGES_IN_FLIGHT};
 };
 
 class StreamRendererCan : public StateFlow<ByteBuffer, QList<1>>
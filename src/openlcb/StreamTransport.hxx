@@ -44,6 +44,7 @@ namespace openlcb
 {
 
 class StreamSender;
+class StreamReceiverInterface;
 class IfCan;
 class If;
 
@@ -105,6 +106,13 @@ public:
         return nextReceiveStreamId_++;
     }
 
+    /// Creates a stream receiver that matches the interface type.
+    /// @param local_stream_id stream ID of the receiver on the local node,
+    /// usually from get_next_stream_receive_id().
+    /// @return a new stream receiver. Ownership is transferred to the caller.
+    virtual StreamReceiverInterface *create_receiver(
+        uint8_t local_stream_id) = 0;
+
 protected:
     /// Stream Sender objects.
     TypedQAsync<StreamSender> senders_;
@@ -135,6 +143,33 @@ public:
 
     /// Destructor.
     ~StreamTransportCan();
+
+    StreamReceiverInterface *create_receiver(uint8_t local_stream_id) override;
+
+private:
+    /// CAN interface object.
+    IfCan *iface_;
+};
+
+/// Stream transport for interfaces that carry whole OpenLCB messages, such as
+/// OpenLCB-TCP.
+class StreamTransportTcp : public StreamTransport
+{
+public:
+    /// Constructor
+    ///
+    /// @param iface OpenLCB interface object pointer.
+    /// @param num_senders How many stream senders to instantiate.
+    StreamTransportTcp(If *iface, unsigned num_senders);
+
+    /// Destructor.
+    ~StreamTransportTcp();
+
+    StreamReceiverInterface *create_receiver(uint8_t local_stream_id) override;
+
+private:
+    /// OpenLCB interface object.
+    If *iface_;
 };
 
 } // namespace openlcb
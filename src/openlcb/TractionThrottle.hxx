@@ -385,7 +385,7 @@ private:
         }
 
         AutoReleaseBuffer<GenMessage> rb(handler_.response());
-        const string &payload = handler_.response()->data()->payload;
+        const Payload &payload = handler_.response()->data()->payload;
         if (payload.size() < 3)
         {
             return return_with_error(Defs::ERROR_INVALID_ARGS);
@@ -559,7 +559,7 @@ private:
         }
 
         AutoReleaseBuffer<GenMessage> rb(handler_.response());
-        const string &payload = handler_.response()->data()->payload;
+        const Payload &payload = handler_.response()->data()->payload;
         if (payload.size() < 9)
         {
             return return_with_error(Defs::ERROR_INVALID_ARGS);
@@ -616,7 +616,7 @@ private:
         }
 
         AutoReleaseBuffer<GenMessage> rb(handler_.response());
-        const string &payload = handler_.response()->data()->payload;
+        const Payload &payload = handler_.response()->data()->payload;
         if (payload.size() < 3)
         {
             return return_with_error(Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
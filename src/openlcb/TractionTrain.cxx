@@ -56,10 +56,6 @@ TrainNode::~TrainNode()
 
 TrainNodeWithConsist::~TrainNodeWithConsist()
 {
-    while (!consistSlaves_.empty())
-    {
-        delete consistSlaves_.pop_front();
-    }
 }
 
 DefaultTrainNode::~DefaultTrainNode()
@@ -201,8 +197,7 @@ struct TrainService::Impl
                 {
                     SpeedType sp = fp16_to_speed(payload() + 1);
                     train_node()->train()->set_speed(sp);
-                    nextConsistIndex_ = 0;
-                    return call_immediately(STATE(maybe_forward_consist));
+                    return start_forward_consist();
                 }
                 case TractionDefs::REQ_SET_FN:
                 {
@@ -232,14 +227,12 @@ struct TrainService::Impl
                     {
                         train_node()->train()->set_fn(address, value);
                     }
-                    nextConsistIndex_ = 0;
-                    return call_immediately(STATE(maybe_forward_consist));
+                    return start_forward_consist();
                 }
                 case TractionDefs::REQ_EMERGENCY_STOP:
                 {
                     train_node()->train()->set_emergencystop();
-                    nextConsistIndex_ = 0;
-                    return call_immediately(STATE(maybe_forward_consist));
+                    return start_forward_consist();
                 }
                 case TractionDefs::REQ_QUERY_SPEED: // fall through
                 case TractionDefs::REQ_QUERY_FN:
@@ -460,24 +453,39 @@ struct TrainService::Impl
             }
         }
 
-        Action maybe_forward_consist()
+        /// Starts forwarding the current message to the consist members.
+        /// @return next action.
+        Action start_forward_consist()
+        {
+            nextConsistIndex_ = 0;
+            if (trainService_->batchConsistForwarding_)
+            {
+                return call_immediately(STATE(forward_consist_batch));
+            }
+            return call_immediately(STATE(maybe_forward_consist));
+        }
+
+        /// Decides whether the current message needs to be forwarded to a
+        /// given consist member.
+        /// @param idx index of the consist member.
+        /// @param dst will be filled with the node ID of the consist member.
+        /// @param flip_speed will be set to true if the direction of a speed
+        /// command needs to be reversed for this member.
+        /// @return true if the message should be sent to this member.
+        bool consist_target(unsigned idx, NodeID *dst, bool *flip_speed)
         {
-            auto* train_node = this->train_node();
-            unsigned count = train_node->query_consist_length();
-            if (count <= nextConsistIndex_)
-                return release_and_exit();
             uint8_t flags = 0;
-            NodeID dst = train_node->query_consist(nextConsistIndex_, &flags);
-            if (iface()->matching_node(nmsg()->src, NodeHandle(dst)))
+            *dst = train_node()->query_consist(idx, &flags);
+            *flip_speed = false;
+            if (!*dst ||
+                iface()->matching_node(nmsg()->src, NodeHandle(*dst)))
             {
-                ++nextConsistIndex_;
-                return again();
+                return false;
             }
             uint8_t cmd = payload()[0] & TractionDefs::REQ_MASK;
-            bool flip_speed = false;
             if (cmd == TractionDefs::REQ_SET_SPEED) {
                 if (flags & TractionDefs::CNSTFLAGS_REVERSE) {
-                    flip_speed = true;
+                    *flip_speed = true;
                 }
             } else if (cmd == TractionDefs::REQ_SET_FN) {
                 uint32_t address = payload()[1];
@@ -487,31 +495,105 @@ struct TrainService::Impl
                 address |= payload()[3];
                 if (address == 0) {
                     if ((flags & TractionDefs::CNSTFLAGS_LINKF0) == 0) {
-                        // skip
-                        ++nextConsistIndex_;
-                        return again();
+                        return false;
                     }
                 } else {
                     if ((flags & TractionDefs::CNSTFLAGS_LINKFN) == 0) {
-                        // skip
-                        ++nextConsistIndex_;
-                        return again();
+                        return false;
                     }
                 }
             }
+            return true;
+        }
+
+        /// Fills in a copy of the current message for a consist member and
+        /// sends it to the interface.
+        /// @param b freshly allocated buffer from the addressed write flow.
+        /// @param dst node ID of the consist member.
+        /// @param flip_speed true if the direction needs to be reversed.
+        void send_consist_copy(Buffer<GenMessage> *b, NodeID dst,
+            bool flip_speed)
+        {
+            b->data()->reset(message()->data()->mti, train_node()->node_id(),
+                             NodeHandle(dst), message()->data()->payload);
+            b->data()->payload[0] |= TractionDefs::REQ_LISTENER;
+            if (flip_speed)
+            {
+                b->data()->payload[1] ^= 0x80;
+            }
+            iface()->addressed_message_write_flow()->send(b);
+        }
+
+        /// Sends the current message itself to the last consist member.
+        /// @param dst node ID of the consist member.
+        /// @param flip_speed true if the direction needs to be reversed.
+        /// @return next action.
+        Action send_consist_last(NodeID dst, bool flip_speed)
+        {
+            // train_node() looks at the current message, so it has to be
+            // evaluated before the transfer.
+            NodeID src = train_node()->node_id();
+            auto *b = transfer_message();
+            b->data()->src = NodeHandle(src);
+            b->data()->dst = NodeHandle(dst);
+            b->data()->dstNode = nullptr;
+            if (flip_speed) {
+                b->data()->payload[1] ^= 0x80;
+            }
+            b->data()->payload[0] |= TractionDefs::REQ_LISTENER;
+            iface()->addressed_message_write_flow()->send(b);
+            return exit();
+        }
+
+        /// Forwards the current message to all consist members at once. The
+        /// last member gets the incoming buffer, the others get copies.
+        Action forward_consist_batch()
+        {
+            unsigned count = train_node()->query_consist_length();
+            NodeID pending = 0;
+            bool pending_flip = false;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                NodeID dst;
+                bool flip;
+                if (!consist_target(i, &dst, &flip))
+                {
+                    continue;
+                }
+                if (pending)
+                {
+                    send_consist_copy(
+                        iface()->addressed_message_write_flow()->alloc(),
+                        pending, pending_flip);
+                }
+                pending = dst;
+                pending_flip = flip;
+            }
+            if (!pending)
+            {
+                return release_and_exit();
+            }
+            return send_consist_last(pending, pending_flip);
+        }
+
+        /// Forwards the current message to the consist member at
+        /// nextConsistIndex_, one member at a time.
+        Action maybe_forward_consist()
+        {
+            unsigned count = train_node()->query_consist_length();
+            if (count <= nextConsistIndex_)
+                return release_and_exit();
+            NodeID dst;
+            bool flip_speed;
+            if (!consist_target(nextConsistIndex_, &dst, &flip_speed))
+            {
+                ++nextConsistIndex_;
+                return again();
+            }
             if (count == nextConsistIndex_ + 1u)
             {
                 // last node: we can transfer the message.
-                auto *b = transfer_message();
-                b->data()->src = NodeHandle(train_node->node_id());
-                b->data()->dst = NodeHandle(dst);
-                b->data()->dstNode = nullptr;
-                if (flip_speed) {
-                    b->data()->payload[1] ^= 0x80;
-                }
-                b->data()->payload[0] |= TractionDefs::REQ_LISTENER;
-                iface()->addressed_message_write_flow()->send(b);
-                return exit();
+                return send_consist_last(dst, flip_speed);
             }
             else
             {
@@ -525,25 +607,16 @@ struct TrainService::Impl
         {
             auto *b =
                 get_allocation_result(iface()->addressed_message_write_flow());
-            uint8_t flags;
-            NodeID dst = train_node()->query_consist(nextConsistIndex_, &flags);
-            if (!dst)
+            NodeID dst;
+            bool flip_speed;
+            if (!consist_target(nextConsistIndex_, &dst, &flip_speed))
             {
                 // Strange. The consist destination should exist and never be
                 // zero once we got here.
                 b->unref();
                 return release_and_exit();
             }
-            b->data()->reset(message()->data()->mti, train_node()->node_id(),
-                             NodeHandle(dst), message()->data()->payload);
-            b->data()->payload[0] |= TractionDefs::REQ_LISTENER;
-            if (((payload()[0] & TractionDefs::REQ_MASK) ==
-                    TractionDefs::REQ_SET_SPEED) &&
-                (flags & TractionDefs::CNSTFLAGS_REVERSE))
-            {
-                b->data()->payload[1] ^= 0x80;
-            }
-            iface()->addressed_message_write_flow()->send(b);
+            send_consist_copy(b, dst, flip_speed);
             ++nextConsistIndex_;
             return call_immediately(STATE(maybe_forward_consist));
         }
@@ -36,6 +36,7 @@
 #define _OPENLCB_TRACTIONTRAIN_HXX_
 
 #include <set>
+#include <vector>
 
 #include "executor/Service.hxx"
 #include "openlcb/DefaultNodeRegistry.hxx"
@@ -128,9 +129,8 @@ public:
     virtual int query_consist_length() = 0;
 };
 
-/// Linked list entry for all registered consist clients for a given train
-/// node.
-struct ConsistEntry : public QMember
+/// Entry in the list of registered consist clients for a given train node.
+struct ConsistEntry
 {
     /// Creates a new consist entry storage.
     /// @param s the stored node ID
@@ -193,16 +193,13 @@ public:
         {
             return false;
         }
-        auto it = consistSlaves_.begin();
-        for (; it != consistSlaves_.end(); ++it)
+        int idx = find_consist(tgt);
+        if (idx >= 0)
         {
-            if (it->get_slave() == tgt)
-            {
-                it->set_flags(flags);
-                return false;
-            }
+            consistSlaves_[idx].set_flags(flags);
+            return false;
         }
-        consistSlaves_.insert(it, new ConsistEntry(tgt, flags));
+        consistSlaves_.emplace_back(tgt, flags);
         return true;
     }
 
@@ -210,48 +207,51 @@ public:
      * was removed, false if the target was not on the list. */
     bool remove_consist(NodeID tgt) override
     {
-        for (auto it = consistSlaves_.begin(); it != consistSlaves_.end(); ++it)
+        int idx = find_consist(tgt);
+        if (idx < 0)
         {
-            if (it->get_slave() == tgt)
-            {
-                auto* p = it.operator->();
-                consistSlaves_.erase(it);
-                delete p;
-                return true;
-            }
+            return false;
         }
-        return false;
+        // Keeps the order of the remaining entries.
+        consistSlaves_.erase(consistSlaves_.begin() + idx);
+        return true;
     }
 
     /** Returns the consist target with offset id, or NodeID(0) if there are
      * fewer than id consist targets. id is zero-based. */
     NodeID query_consist(int id, uint8_t* flags) override
     {
-        int k = 0;
-        for (auto it = consistSlaves_.begin();
-             it != consistSlaves_.end(); ++it, ++k)
+        if (id < 0 || (unsigned)id >= consistSlaves_.size())
         {
-            if (k == id)
-            {
-                if (flags) *flags = it->get_flags();
-                return it->get_slave();
-            }
+            return 0;
         }
-        return 0;
+        if (flags) *flags = consistSlaves_[id].get_flags();
+        return consistSlaves_[id].get_slave();
     }
 
     /** Returns the number of slaves in this consist. */
     int query_consist_length() override
     {
-        int ret = 0;
-        for (auto it = consistSlaves_.begin(); it != consistSlaves_.end();
-             ++it, ++ret)
+        return consistSlaves_.size();
+    }
+
+    /// @return the index of a node in the consist list, or -1 if it is not a
+    /// member. @param tgt the node ID to look for.
+    int find_consist(NodeID tgt)
+    {
+        for (unsigned i = 0; i < consistSlaves_.size(); ++i)
         {
+            if (consistSlaves_[i].get_slave() == tgt)
+            {
+                return i;
+            }
         }
-        return ret;
+        return -1;
     }
 
-    TypedQueue<ConsistEntry> consistSlaves_;
+    /// Consist members in the order they were added. Indexed by the
+    /// query_consist() argument.
+    std::vector<ConsistEntry> consistSlaves_;
 };
 
 /// Default implementation of a train node.
@@ -387,6 +387,16 @@ public:
         return nodes_->is_node_registered(node);
     }
 
+    /// Selects how the commands are forwarded to the members of a consist.
+    /// @param batch if true (default), the commands to all members are
+    /// allocated and handed to the interface's write flow in one go. If false,
+    /// one member is handled at a time, each waiting for a buffer allocation,
+    /// which keeps the number of buffers in use low.
+    void set_consist_batch_forwarding(bool batch)
+    {
+        batchConsistForwarding_ = batch;
+    }
+
 private:
     struct Impl;
     /** Implementation flows. */
@@ -395,6 +405,8 @@ private:
     If *iface_;
     /** List of train nodes managed by this Service. */
     std::unique_ptr<NodeRegistry> nodes_;
+    /// @see set_consist_batch_forwarding().
+    bool batchConsistForwarding_{true};
 };
 
 } // namespace openlcb
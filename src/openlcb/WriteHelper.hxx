@@ -52,7 +52,7 @@ class WriteHelper : public Executable
 {
 public:
     typedef Node *node_type;
-    typedef string payload_type;
+    typedef Payload payload_type;
 
     static NodeHandle global()
     {
@@ -75,6 +75,22 @@ DEFAULT_CONST_TRUE(node_init_identify);
  * time. */
 DEFAULT_CONST(bulk_alias_num_can_frames, 20);
 
+/** Number of preallocated reassembly buffers for multi-frame addressed
+ * messages and for multi-frame datagrams (each) on a CAN interface. */
+DEFAULT_CONST(can_reassembly_table_size, 8);
+
+/** A partially received multi-frame message or datagram on a CAN interface is
+ * dropped if there was no frame for it for this many milliseconds. */
+DEFAULT_CONST(can_reassembly_timeout_msec, 3000);
+
+/** Writes to a @ref MappedFileMemorySpace are synced to disk this many
+ * milliseconds after the first unsynced write. */
+DEFAULT_CONST(mapped_file_sync_delay_msec, 1000);
+
 /** Default number of bytes in maximum stream window size for { @ref
  * StreamReceiver }. */
 DEFAULT_CONST(stream_receiver_default_window_size, 2 * 1024);
+
+/** Default number of bytes in maximum stream window size for { @ref
+ * StreamReceiverTcp }. */
+DEFAULT_CONST(stream_receiver_tcp_window_size, 16 * 1024);
@@ -37,6 +37,9 @@
 #define _DARWIN_C_SOURCE // pselect
 #endif
 
+#include <errno.h>
+#include <limits.h>
+
 void empty_signal_handler(int)
 {
 }
@@ -112,6 +115,56 @@ int OSSelectWakeup::select(int nfds, fd_set *readfds,
     return ret;
 }
 
+#if OPENMRN_HAVE_EPOLL
+int OSSelectWakeup::epoll_wait(int epfd, struct epoll_event *events,
+    int maxevents, long long deadline_nsec)
+{
+    {
+        AtomicHolder l(this);
+        inSelect_ = true;
+        if (pendingWakeup_)
+        {
+            deadline_nsec = 0;
+        }
+    }
+    int ret = -1;
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+    // epoll_pwait2 has a nanosecond resolution timeout. It needs Linux 5.11.
+    static bool have_pwait2 = true;
+    if (have_pwait2)
+    {
+        struct timespec timeout;
+        timeout.tv_sec = deadline_nsec / 1000000000;
+        timeout.tv_nsec = deadline_nsec % 1000000000;
+        ret = ::epoll_pwait2(epfd, events, maxevents,
+            deadline_nsec >= 0 ? &timeout : nullptr, &origMask_);
+        if (ret < 0 && errno == ENOSYS)
+        {
+            have_pwait2 = false;
+        }
+    }
+    if (!have_pwait2)
+#endif
+    {
+        int timeout_msec = -1;
+        if (deadline_nsec >= 0)
+        {
+            // Rounds up, otherwise we would wake up before the timer expires
+            // and then spin until it does.
+            long long msec = (deadline_nsec + 999999) / 1000000;
+            timeout_msec = msec > INT_MAX ? INT_MAX : msec;
+        }
+        ret = ::epoll_pwait(epfd, events, maxevents, timeout_msec, &origMask_);
+    }
+    {
+        AtomicHolder l(this);
+        pendingWakeup_ = false;
+        inSelect_ = false;
+    }
+    return ret;
+}
+#endif // OPENMRN_HAVE_EPOLL
+
 #ifdef ESP_PLATFORM
 #include "freertos_includes.h"
 
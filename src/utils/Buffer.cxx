@@ -34,6 +34,12 @@
 #include "utils/Buffer.hxx"
 #include "utils/ByteBuffer.hxx"
 
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+#include <vector>
+
+#include "nmranet_config.h"
+#endif
+
 DynamicPool *mainBufferPool = nullptr;
 Pool *rawBufferPool = nullptr;
 
@@ -47,6 +53,13 @@ Pool* init_main_buffer_pool()
     {
         mainBufferPool =
             new DynamicPool(Bucket::init(32, 48, LARGEST_BUFFERPOOL_BUCKET, 0));
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+        if (config_buffer_thread_cache_size())
+        {
+            mainBufferPool->enable_thread_cache(
+                config_buffer_thread_cache_size());
+        }
+#endif
     }
     return mainBufferPool;
 }
@@ -60,6 +73,9 @@ size_t DynamicPool::free_items()
     for (Bucket *current = buckets; current->size() != 0; ++current)
     {
         total += current->pending();
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+        total += cached_items(current);
+#endif
     }
     return total;
 }
@@ -74,7 +90,11 @@ size_t DynamicPool::free_items(size_t size)
     {
         if (current->size() >= size)
         {
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+            return current->pending() + cached_items(current);
+#else
             return current->pending();
+#endif
         }
     }
     return 0;
@@ -110,7 +130,13 @@ BufferBase *DynamicPool::alloc_untyped(size_t size, Executable *flow)
     {
         if (size <= current->size())
         {
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+            result = magazineSize_
+                ? cache_alloc(current)
+                : static_cast<BufferBase *>(current->next().item);
+#else
             result = static_cast<BufferBase*>(current->next().item);
+#endif
             if (result == NULL)
             {
                 result = (BufferBase*)buffer_malloc(current->size());
@@ -174,6 +200,13 @@ void DynamicPool::free(BufferBase *item)
     {
         if (item->size() <= current->size())
         {
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+            if (magazineSize_)
+            {
+                cache_free(current, item);
+                return;
+            }
+#endif
             current->insert(item);
             return;
         }
@@ -186,6 +219,226 @@ void DynamicPool::free(BufferBase *item)
     free_large(item);
 }
 
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+
+/// Free buffers of one DynamicPool held by one thread. For each bucket there
+/// is a singly linked list ("magazine") of buffers, using the QMember link.
+struct DynamicPool::ThreadCache
+{
+    /// One list of free buffers.
+    struct Magazine
+    {
+        /// First buffer in the list.
+        QMember *head_ {nullptr};
+        /// Number of buffers in the list. Written only by the owning thread
+        /// (or with the owning thread gone), read by free_items().
+        std::atomic<unsigned> count_ {0};
+    };
+
+    /// Constructor. @param pool owning pool. @param num_buckets how many
+    /// buckets the pool has.
+    ThreadCache(DynamicPool *pool, unsigned num_buckets)
+        : pool_(pool)
+        , magazines_(new Magazine[num_buckets])
+    {
+    }
+
+    /// Which pool this cache belongs to. Set to nullptr when the pool is
+    /// destroyed.
+    std::atomic<DynamicPool *> pool_;
+    /// Next cache of the same pool (in another thread).
+    ThreadCache *next_ {nullptr};
+    /// One entry per bucket of the pool.
+    std::unique_ptr<Magazine[]> magazines_;
+};
+
+/// Lock protecting the list of thread caches in each pool, as well as
+/// detaching the caches from their pool.
+static Atomic g_thread_cache_lock;
+
+struct DynamicPool::ThreadCacheList
+{
+    /// Returns the buffers to their pools when the thread exits.
+    ~ThreadCacheList()
+    {
+        AtomicHolder h(&g_thread_cache_lock);
+        for (ThreadCache *c : caches_)
+        {
+            DynamicPool *pool = c->pool_.load(std::memory_order_relaxed);
+            if (pool)
+            {
+                pool->flush_thread_cache(c);
+                ThreadCache **p = &pool->threadCaches_;
+                while (*p != c)
+                {
+                    p = &(*p)->next_;
+                }
+                *p = c->next_;
+            }
+            delete c;
+        }
+    }
+
+    /// Caches of this thread, one for each pool with caching enabled that
+    /// the thread used.
+    std::vector<ThreadCache *> caches_;
+};
+
+thread_local DynamicPool::ThreadCacheList DynamicPool::threadCacheList_;
+thread_local DynamicPool::ThreadCache *DynamicPool::lastThreadCache_ = nullptr;
+
+void DynamicPool::enable_thread_cache(unsigned magazine_size)
+{
+    HASSERT(magazine_size >= 2);
+    magazineSize_ = magazine_size;
+}
+
+DynamicPool::ThreadCache *DynamicPool::thread_cache()
+{
+    ThreadCache *last = lastThreadCache_;
+    if (last && last->pool_.load(std::memory_order_relaxed) == this)
+    {
+        return last;
+    }
+    auto &caches = threadCacheList_.caches_;
+    for (ThreadCache *c : caches)
+    {
+        if (c->pool_.load(std::memory_order_relaxed) == this)
+        {
+            lastThreadCache_ = c;
+            return c;
+        }
+    }
+    unsigned num_buckets = 0;
+    while (buckets[num_buckets].size() != 0)
+    {
+        ++num_buckets;
+    }
+    ThreadCache *c = new ThreadCache(this, num_buckets);
+    AtomicHolder h(&g_thread_cache_lock);
+    // Drops the caches of pools that were destroyed since.
+    for (unsigned i = 0; i < caches.size();)
+    {
+        if (!caches[i]->pool_.load(std::memory_order_relaxed))
+        {
+            delete caches[i];
+            caches[i] = caches.back();
+            caches.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    caches.push_back(c);
+    c->next_ = threadCaches_;
+    threadCaches_ = c;
+    lastThreadCache_ = c;
+    return c;
+}
+
+BufferBase *DynamicPool::cache_alloc(Bucket *bucket)
+{
+    ThreadCache::Magazine &m = thread_cache()->magazines_[bucket - buckets];
+    unsigned count = m.count_.load(std::memory_order_relaxed);
+    if (!count)
+    {
+        // Refills half a magazine with one lock.
+        AtomicHolder h(bucket->lock());
+        while (count < magazineSize_ / 2)
+        {
+            QMember *item = bucket->next_locked().item;
+            if (!item)
+            {
+                break;
+            }
+            item->next = m.head_;
+            m.head_ = item;
+            ++count;
+        }
+        if (!count)
+        {
+            return nullptr;
+        }
+    }
+    QMember *item = m.head_;
+    m.head_ = item->next;
+    item->next = nullptr;
+    m.count_.store(count - 1, std::memory_order_relaxed);
+    return static_cast<BufferBase *>(item);
+}
+
+void DynamicPool::cache_free(Bucket *bucket, BufferBase *item)
+{
+    ThreadCache::Magazine &m = thread_cache()->magazines_[bucket - buckets];
+    unsigned count = m.count_.load(std::memory_order_relaxed);
+    if (count >= magazineSize_)
+    {
+        // Returns half a magazine with one lock.
+        AtomicHolder h(bucket->lock());
+        while (count > magazineSize_ / 2)
+        {
+            QMember *q = m.head_;
+            m.head_ = q->next;
+            q->next = nullptr;
+            bucket->insert_locked(q);
+            --count;
+        }
+    }
+    item->next = m.head_;
+    m.head_ = item;
+    m.count_.store(count + 1, std::memory_order_relaxed);
+}
+
+void DynamicPool::flush_thread_cache(ThreadCache *cache)
+{
+    for (unsigned i = 0; buckets[i].size() != 0; ++i)
+    {
+        ThreadCache::Magazine &m = cache->magazines_[i];
+        AtomicHolder h(buckets[i].lock());
+        while (m.head_)
+        {
+            QMember *q = m.head_;
+            m.head_ = q->next;
+            q->next = nullptr;
+            buckets[i].insert_locked(q);
+        }
+        m.count_.store(0, std::memory_order_relaxed);
+    }
+}
+
+void DynamicPool::release_thread_caches()
+{
+    AtomicHolder h(&g_thread_cache_lock);
+    while (threadCaches_)
+    {
+        ThreadCache *c = threadCaches_;
+        flush_thread_cache(c);
+        threadCaches_ = c->next_;
+        c->next_ = nullptr;
+        // The owning thread will delete it.
+        c->pool_.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+size_t DynamicPool::cached_items(Bucket *bucket)
+{
+    if (!magazineSize_)
+    {
+        return 0;
+    }
+    size_t total = 0;
+    AtomicHolder h(&g_thread_cache_lock);
+    for (ThreadCache *c = threadCaches_; c; c = c->next_)
+    {
+        total += c->magazines_[bucket - buckets].count_.load(
+            std::memory_order_relaxed);
+    }
+    return total;
+}
+
+#endif // OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+
 /** Get a free item out of the pool.
  * @param size how many payload bytes should he allocated buffer have. Usually
  * sizeof<T> for Buffer<T>.
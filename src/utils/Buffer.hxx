@@ -502,6 +502,9 @@ public:
     /** default destructor */
     ~DynamicPool()
     {
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+        release_thread_caches();
+#endif
 #ifdef GTEST
         for (unsigned i = 0; buckets[i].size() != 0; ++i)
         {
@@ -531,6 +534,19 @@ public:
      */
     size_t free_items(size_t size) override;
 
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+    /** Puts a small cache of free buffers for each bucket size in front of
+     * the pool in every thread that uses it. Allocations and frees are served
+     * from the thread's own cache; the shared buckets are only locked when a
+     * cache runs empty or full, and then half a cache worth of buffers is
+     * moved at once. Buffers in the caches still count as free_items().
+     *
+     * Must be called before the pool is used by more than one thread.
+     * @param magazine_size how many buffers of each size a thread may keep,
+     * at least 2. */
+    void enable_thread_cache(unsigned magazine_size);
+#endif
+
 protected:
     /** Free buffer queue */
     Bucket *buckets;
@@ -558,6 +574,43 @@ private:
      */
     void free(BufferBase *item) override;
 
+#if OPENMRN_FEATURE_BUFFER_THREAD_CACHE
+    /// Free buffers of one pool held by one thread.
+    struct ThreadCache;
+    /// Set of all thread caches of the calling thread.
+    struct ThreadCacheList;
+
+    /// @return the cache of the calling thread for this pool, creating it if
+    /// needed.
+    ThreadCache *thread_cache();
+    /// Takes a buffer from the cache of the calling thread. @param bucket is
+    /// where the buffer belongs. @return the buffer, or nullptr if there is
+    /// no free buffer of this size.
+    BufferBase *cache_alloc(Bucket *bucket);
+    /// Puts a buffer to the cache of the calling thread. @param bucket is
+    /// where the buffer belongs. @param item is the buffer.
+    void cache_free(Bucket *bucket, BufferBase *item);
+    /// Returns all buffers in a thread cache to the buckets. Caller must hold
+    /// the registry lock. @param cache the cache to empty.
+    void flush_thread_cache(ThreadCache *cache);
+    /// Empties and detaches the caches of all threads. Called from the
+    /// destructor.
+    void release_thread_caches();
+    /// @param bucket one of our buckets. @return how many buffers of this
+    /// bucket are held in thread caches.
+    size_t cached_items(Bucket *bucket);
+
+    /// Capacity of a thread cache for each bucket; 0 if the thread caches are
+    /// disabled.
+    unsigned magazineSize_ {0};
+    /// Caches of all threads for this pool. Protected by the registry lock.
+    ThreadCache *threadCaches_ {nullptr};
+    /// Caches of the calling thread (for all pools).
+    static thread_local ThreadCacheList threadCacheList_;
+    /// The cache of the calling thread that was used last.
+    static thread_local ThreadCache *lastThreadCache_;
+#endif
+
     /** Default constructor.
      */
     DynamicPool();
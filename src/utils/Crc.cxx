@@ -33,10 +33,16 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
+#include "openmrn_features.h"
 #include "utils/Crc.hxx"
 #include "utils/macros.h"
 
+#if CRC16_SLICE_BY_8 && OPENMRN_HAVE_X86_CLMUL
+#include <immintrin.h>
+#endif
+
 /// Initialization value for the CRC-16-IBM calculator.
 static const uint16_t crc_16_ibm_init_value = 0x0000; // TODO: check
 /// Polynomial for the CRC-16-IBM calculator.
@@ -152,15 +158,500 @@ inline uint16_t crc_16_ibm_finish(uint16_t state)
     return state;
 }
 
+#if CRC16_SLICE_BY_8
+
+/// Lookup tables for computing a CRC-16 eight bytes at a time. Table k gives
+/// the effect of a byte that is followed by k more bytes in the same step.
+struct Crc16Slice8
+{
+    /// Constructor. Computes the tables.
+    /// @param poly the polynomial, in the bit order of the CRC state.
+    /// @param lsb_first true for reflected CRCs (CRC-16-IBM), false for
+    /// CRCs processing the most significant bit first (CCITT).
+    Crc16Slice8(uint16_t poly, bool lsb_first)
+    {
+        for (unsigned b = 0; b < 256; ++b)
+        {
+            uint16_t s = lsb_first ? b : b << 8;
+            for (int i = 0; i < 8; ++i)
+            {
+                if (lsb_first)
+                {
+                    s = (s & 1) ? (s >> 1) ^ poly : s >> 1;
+                }
+                else
+                {
+                    s = (s & 0x8000) ? (s << 1) ^ poly : s << 1;
+                }
+            }
+            t[0][b] = s;
+        }
+        for (unsigned k = 1; k < 8; ++k)
+        {
+            for (unsigned b = 0; b < 256; ++b)
+            {
+                uint16_t s = t[k - 1][b];
+                t[k][b] = lsb_first ? (s >> 8) ^ t[0][s & 0xff]
+                                    : (s << 8) ^ t[0][s >> 8];
+            }
+        }
+    }
+
+    /// Lookup tables.
+    uint16_t t[8][256];
+};
+
+/// @return the slicing tables for CRC-16-IBM.
+static const Crc16Slice8 &ibm_tables()
+{
+    static const Crc16Slice8 tables(crc_16_ibm_poly, true);
+    return tables;
+}
+
+/// @return the slicing tables for CRC-16-CCITT.
+static const Crc16Slice8 &ccitt_tables()
+{
+    static const Crc16Slice8 tables(0x1021, false);
+    return tables;
+}
+
+/// Loads eight bytes. @param p data (any alignment). @return the bytes with
+/// p[0] in the least significant position.
+static inline uint64_t load_le64(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+/// Loads eight bytes. @param p data (any alignment). @return the bytes with
+/// p[0] in the most significant position.
+static inline uint64_t load_be64(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+#if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+/// Picks bytes 0, 2, 4 and 6 (counting from the least significant) of a
+/// word. @param w input. @return the four bytes in the low half, in order.
+static inline uint64_t even_bytes(uint64_t w)
+{
+    w &= 0x00FF00FF00FF00FFull;
+    w = (w | (w >> 8)) & 0x0000FFFF0000FFFFull;
+    return (w | (w >> 16)) & 0xFFFFFFFFull;
+}
+
+/// Processes one byte of a reflected CRC. @param t tables. @param s state.
+/// @param b next byte. @return new state.
+static inline uint16_t lsb_step1(const Crc16Slice8 &t, uint16_t s, uint8_t b)
+{
+    return (s >> 8) ^ t.t[0][(s ^ b) & 0xff];
+}
+
+/// Processes eight bytes of a reflected CRC. @param t tables. @param s state.
+/// @param w next eight bytes, first byte in the least significant position.
+/// @return new state.
+static inline uint16_t lsb_step8(const Crc16Slice8 &t, uint16_t s, uint64_t w)
+{
+    w ^= s;
+    return t.t[7][w & 0xff] ^ t.t[6][(w >> 8) & 0xff] ^
+        t.t[5][(w >> 16) & 0xff] ^ t.t[4][(w >> 24) & 0xff] ^
+        t.t[3][(w >> 32) & 0xff] ^ t.t[2][(w >> 40) & 0xff] ^
+        t.t[1][(w >> 48) & 0xff] ^ t.t[0][w >> 56];
+}
+
+/// Processes one byte of an MSB-first CRC. @param t tables. @param s state.
+/// @param b next byte. @return new state.
+static inline uint16_t msb_step1(const Crc16Slice8 &t, uint16_t s, uint8_t b)
+{
+    return (s << 8) ^ t.t[0][(s >> 8) ^ b];
+}
+
+/// Processes eight bytes of an MSB-first CRC. @param t tables. @param s state.
+/// @param w next eight bytes, first byte in the most significant position.
+/// @return new state.
+static inline uint16_t msb_step8(const Crc16Slice8 &t, uint16_t s, uint64_t w)
+{
+    w ^= (uint64_t)s << 48;
+    return t.t[7][w >> 56] ^ t.t[6][(w >> 48) & 0xff] ^
+        t.t[5][(w >> 40) & 0xff] ^ t.t[4][(w >> 32) & 0xff] ^
+        t.t[3][(w >> 24) & 0xff] ^ t.t[2][(w >> 16) & 0xff] ^
+        t.t[1][(w >> 8) & 0xff] ^ t.t[0][w & 0xff];
+}
+
+/// Advances a CRC state over a buffer.
+/// @param LSB_FIRST true for a reflected CRC.
+/// @param t tables. @param s state. @param p data. @param len length of data.
+/// @return new state.
+template <bool LSB_FIRST>
+static uint16_t slice8_update(
+    const Crc16Slice8 &t, uint16_t s, const uint8_t *p, size_t len)
+{
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        s = LSB_FIRST ? lsb_step8(t, s, load_le64(p))
+                      : msb_step8(t, s, load_be64(p));
+    }
+    for (; len; ++p, --len)
+    {
+        s = LSB_FIRST ? lsb_step1(t, s, *p) : msb_step1(t, s, *p);
+    }
+    return s;
+}
+
+/// Computes a triple CRC, 16 bytes per step. The three states in checksum
+/// are updated in place.
+/// @param LSB_FIRST true for a reflected CRC.
+/// @param t tables. @param p data. @param len length of data.
+/// @param checksum CRC states of all bytes, the even index and the odd index
+/// bytes.
+template <bool LSB_FIRST>
+static void slice8_crc3(
+    const Crc16Slice8 &t, const uint8_t *p, size_t len, uint16_t checksum[3])
+{
+    uint16_t s_all = checksum[0];
+    uint16_t s_even = checksum[1];
+    uint16_t s_odd = checksum[2];
+    for (; len >= 16; p += 16, len -= 16)
+    {
+        if (LSB_FIRST)
+        {
+            uint64_t w0 = load_le64(p);
+            uint64_t w1 = load_le64(p + 8);
+            s_all = lsb_step8(t, lsb_step8(t, s_all, w0), w1);
+            s_even = lsb_step8(
+                t, s_even, even_bytes(w0) | (even_bytes(w1) << 32));
+            s_odd = lsb_step8(
+                t, s_odd, even_bytes(w0 >> 8) | (even_bytes(w1 >> 8) << 32));
+        }
+        else
+        {
+            uint64_t w0 = load_be64(p);
+            uint64_t w1 = load_be64(p + 8);
+            s_all = msb_step8(t, msb_step8(t, s_all, w0), w1);
+            s_even = msb_step8(
+                t, s_even, (even_bytes(w0 >> 8) << 32) | even_bytes(w1 >> 8));
+            s_odd = msb_step8(
+                t, s_odd, (even_bytes(w0) << 32) | even_bytes(w1));
+        }
+    }
+    // The processed length is even, so the index parity is unchanged.
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (LSB_FIRST)
+        {
+            s_all = lsb_step1(t, s_all, p[i]);
+        }
+        else
+        {
+            s_all = msb_step1(t, s_all, p[i]);
+        }
+        uint16_t &s = (i & 1) ? s_odd : s_even;
+        s = LSB_FIRST ? lsb_step1(t, s, p[i]) : msb_step1(t, s, p[i]);
+    }
+    checksum[0] = s_all;
+    checksum[1] = s_even;
+    checksum[2] = s_odd;
+}
+
+#if OPENMRN_HAVE_X86_CLMUL
+
+/// Set to false to use the table implementation even if the CPU has
+/// carry-less multiplication. Used by the tests and benchmarks.
+bool g_crc16_clmul_enabled = true;
+
+/// Buffers shorter than this are not worth setting up the SIMD registers for.
+static constexpr size_t CLMUL_MIN_LENGTH = 64;
+
+/// @return true if the carry-less multiply kernels can be used.
+static bool clmul_available()
+{
+    static const bool available = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") &&
+            __builtin_cpu_supports("ssse3");
+    }();
+    return available && g_crc16_clmul_enabled;
+}
+
+/// Computes x^n mod P.
+/// @param n exponent.
+/// @param poly the polynomial P without the x^16 term, MSB-first bit order.
+/// @return the remainder, bit i is the coefficient of x^i.
+static uint16_t xpow_mod(unsigned n, uint16_t poly)
+{
+    uint16_t r = 1;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        r = (r & 0x8000) ? (r << 1) ^ poly : r << 1;
+    }
+    return r;
+}
+
+/// Reverses the bits of a 64-bit word. @param v input. @return reversed.
+static uint64_t reverse64(uint64_t v)
+{
+    uint64_t r = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+/// Folding constants for a polynomial. The 128-bit accumulator X = H * x^64 +
+/// L is replaced by H * (x^192 mod P) + L * (x^128 mod P) for every block of
+/// 16 bytes; this keeps X congruent to the data consumed so far.
+struct ClmulConstants
+{
+    /// Constructor.
+    /// @param poly the polynomial P without the x^16 term, MSB-first bit
+    /// order.
+    /// @param lsb_first true for reflected CRCs.
+    ClmulConstants(uint16_t poly, bool lsb_first)
+    {
+        if (lsb_first)
+        {
+            // In reflected order the low qword holds H. The product of two
+            // reflected 64-bit values comes out multiplied by x, which is
+            // compensated for in the exponents.
+            k_lo = reverse64(xpow_mod(191, poly));
+            k_hi = reverse64(xpow_mod(127, poly));
+        }
+        else
+        {
+            k_lo = xpow_mod(128, poly);
+            k_hi = xpow_mod(192, poly);
+        }
+    }
+
+    /// Multiplier for the low qword of the accumulator.
+    uint64_t k_lo;
+    /// Multiplier for the high qword of the accumulator.
+    uint64_t k_hi;
+};
+
+/// @return folding constants for CRC-16-IBM.
+static const ClmulConstants &ibm_clmul()
+{
+    // 0x8005 is 0xA001 in MSB-first bit order.
+    static const ClmulConstants k(0x8005, true);
+    return k;
+}
+
+/// @return folding constants for CRC-16-CCITT.
+static const ClmulConstants &ccitt_clmul()
+{
+    static const ClmulConstants k(0x1021, false);
+    return k;
+}
+
+/// One stream of data being folded with carry-less multiplication.
+/// @param LSB_FIRST true for a reflected CRC.
+template <bool LSB_FIRST> struct ClmulStream
+{
+    /// Constructor. @param state CRC state before the stream. @param k folding
+    /// constants.
+    __attribute__((target("pclmul,ssse3")))
+    ClmulStream(uint16_t state, const ClmulConstants &k)
+    {
+        k_ = _mm_set_epi64x(k.k_hi, k.k_lo);
+        // The CRC state is merged into the first two bytes of the data.
+        acc_ = _mm_cvtsi32_si128(state);
+        if (!LSB_FIRST)
+        {
+            acc_ = _mm_slli_si128(acc_, 14);
+        }
+    }
+
+    /// Reverses the byte order for MSB-first CRCs. @param v 16 bytes in
+    /// memory order. @return v in the order used for the polynomial math.
+    __attribute__((target("pclmul,ssse3")))
+    static __m128i order(__m128i v)
+    {
+        if (!LSB_FIRST)
+        {
+            v = _mm_shuffle_epi8(v,
+                _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                    15));
+        }
+        return v;
+    }
+
+    /// Adds the first block of the stream. @param v 16 bytes of data in
+    /// memory order.
+    __attribute__((target("pclmul,ssse3")))
+    void first(__m128i v)
+    {
+        acc_ = _mm_xor_si128(acc_, order(v));
+    }
+
+    /// Adds the next block of the stream. @param v 16 bytes of data in memory
+    /// order.
+    __attribute__((target("pclmul,ssse3")))
+    void next(__m128i v)
+    {
+        __m128i lo = _mm_clmulepi64_si128(acc_, k_, 0x00);
+        __m128i hi = _mm_clmulepi64_si128(acc_, k_, 0x11);
+        acc_ = _mm_xor_si128(_mm_xor_si128(lo, hi), order(v));
+    }
+
+    /// Reduces the accumulator to a CRC state.
+    /// @param t tables for the same polynomial.
+    /// @return the CRC state after all the data added.
+    __attribute__((target("pclmul,ssse3")))
+    uint16_t finish(const Crc16Slice8 &t)
+    {
+        // The accumulator is congruent to the data, so its CRC from a zero
+        // state is the same as the data's.
+        uint8_t buf[16];
+        _mm_storeu_si128((__m128i *)buf, order(acc_));
+        return slice8_update<LSB_FIRST>(t, 0, buf, 16);
+    }
+
+    /// Folding constants.
+    __m128i k_;
+    /// Accumulator.
+    __m128i acc_;
+};
+
+/// Advances a CRC state over a buffer using carry-less multiplication.
+/// @param LSB_FIRST true for a reflected CRC.
+/// @param t tables. @param k folding constants. @param s state. @param p data.
+/// @param len length of data, at least 32. @return new state.
+template <bool LSB_FIRST>
+__attribute__((target("pclmul,ssse3"))) static uint16_t clmul_update(
+    const Crc16Slice8 &t, const ClmulConstants &k, uint16_t s,
+    const uint8_t *p, size_t len)
+{
+    ClmulStream<LSB_FIRST> st(s, k);
+    st.first(_mm_loadu_si128((const __m128i *)p));
+    p += 16;
+    len -= 16;
+    for (; len >= 16; p += 16, len -= 16)
+    {
+        st.next(_mm_loadu_si128((const __m128i *)p));
+    }
+    return slice8_update<LSB_FIRST>(t, st.finish(t), p, len);
+}
+
+/// Computes a triple CRC using carry-less multiplication. The three states in
+/// checksum are updated in place.
+/// @param LSB_FIRST true for a reflected CRC.
+/// @param t tables. @param k folding constants. @param p data.
+/// @param len length of data, at least 32.
+/// @param checksum CRC states of all bytes, the even index and the odd index
+/// bytes.
+template <bool LSB_FIRST>
+__attribute__((target("pclmul,ssse3"))) static void clmul_crc3(
+    const Crc16Slice8 &t, const ClmulConstants &k, const uint8_t *p,
+    size_t len, uint16_t checksum[3])
+{
+    ClmulStream<LSB_FIRST> s_all(checksum[0], k);
+    ClmulStream<LSB_FIRST> s_even(checksum[1], k);
+    ClmulStream<LSB_FIRST> s_odd(checksum[2], k);
+    // Moves the even index bytes to the low half and the odd index bytes to
+    // the high half.
+    const __m128i split = _mm_set_epi8(
+        15, 13, 11, 9, 7, 5, 3, 1, 14, 12, 10, 8, 6, 4, 2, 0);
+    bool first = true;
+    for (; len >= 32; p += 32, len -= 32)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)p);
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+        __m128i sa = _mm_shuffle_epi8(a, split);
+        __m128i sb = _mm_shuffle_epi8(b, split);
+        __m128i even = _mm_unpacklo_epi64(sa, sb);
+        __m128i odd = _mm_unpackhi_epi64(sa, sb);
+        if (first)
+        {
+            s_all.first(a);
+            s_even.first(even);
+            s_odd.first(odd);
+            first = false;
+        }
+        else
+        {
+            s_all.next(a);
+            s_even.next(even);
+            s_odd.next(odd);
+        }
+        s_all.next(b);
+    }
+    checksum[0] = s_all.finish(t);
+    checksum[1] = s_even.finish(t);
+    checksum[2] = s_odd.finish(t);
+    slice8_crc3<LSB_FIRST>(t, p, len, checksum);
+}
+
+#endif // OPENMRN_HAVE_X86_CLMUL
+
+/// Advances a CRC-16-IBM state over a buffer. @param s state. @param p data.
+/// @param len length of data. @return new state.
+static uint16_t crc_16_ibm_update(uint16_t s, const uint8_t *p, size_t len)
+{
+#if OPENMRN_HAVE_X86_CLMUL
+    if (len >= CLMUL_MIN_LENGTH && clmul_available())
+    {
+        return clmul_update<true>(ibm_tables(), ibm_clmul(), s, p, len);
+    }
+#endif
+    return slice8_update<true>(ibm_tables(), s, p, len);
+}
+
+// static
+uint16_t Crc16CCITT::update_slice8(
+    uint16_t state, const void *data, size_t length_bytes)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+#if OPENMRN_HAVE_X86_CLMUL
+    if (length_bytes >= CLMUL_MIN_LENGTH && clmul_available())
+    {
+        return clmul_update<false>(
+            ccitt_tables(), ccitt_clmul(), state, p, length_bytes);
+    }
+#endif
+    return slice8_update<false>(ccitt_tables(), state, p, length_bytes);
+}
+
+void crc3_crc16_ccitt(
+    const void* data, size_t length_bytes, uint16_t checksum[3])
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    checksum[0] = checksum[1] = checksum[2] = 0xFFFF;
+#if OPENMRN_HAVE_X86_CLMUL
+    if (length_bytes >= CLMUL_MIN_LENGTH && clmul_available())
+    {
+        clmul_crc3<false>(
+            ccitt_tables(), ccitt_clmul(), p, length_bytes, checksum);
+        return;
+    }
+#endif
+    slice8_crc3<false>(ccitt_tables(), p, length_bytes, checksum);
+}
+
+#endif // CRC16_SLICE_BY_8
 
 uint16_t crc_16_ibm(const void* data, size_t length)
 {
     const uint8_t *payload = static_cast<const uint8_t*>(data);
     uint16_t state = crc_16_ibm_init_value;
+#if CRC16_SLICE_BY_8
+    state = crc_16_ibm_update(state, payload, length);
+#else
     for (size_t i = 0; i < length; ++i)
     {
         crc_16_ibm_add(state, payload[i]);
     }
+#endif
     return crc_16_ibm_finish(state);
 }
 
@@ -170,7 +661,25 @@ void crc3_crc16_ibm(const void* data, size_t length_bytes, uint16_t* checksum)
     uint16_t state2 = crc_16_ibm_init_value;
     uint16_t state3 = crc_16_ibm_init_value;
 
-#ifdef ESP_NONOS
+#if CRC16_SLICE_BY_8
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    checksum[0] = state1;
+    checksum[1] = state2;
+    checksum[2] = state3;
+#if OPENMRN_HAVE_X86_CLMUL
+    if (length_bytes >= CLMUL_MIN_LENGTH && clmul_available())
+    {
+        clmul_crc3<true>(ibm_tables(), ibm_clmul(), p, length_bytes, checksum);
+    }
+    else
+#endif
+    {
+        slice8_crc3<true>(ibm_tables(), p, length_bytes, checksum);
+    }
+    state1 = checksum[0];
+    state2 = checksum[1];
+    state3 = checksum[2];
+#elif defined(ESP_NONOS)
     // Aligned reads only.
     const uint32_t* payload = static_cast<const uint32_t*>(data);
     HASSERT((((uint32_t)payload) & 3) == 0);
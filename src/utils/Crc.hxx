@@ -46,6 +46,16 @@
 /// Use the larger (faster) table by default.
 #define CRC16CCITT_TABLE_SIZE 256
 #endif
+#ifndef CRC16_SLICE_BY_8
+#if defined(__linux__) || defined(__MACH__) || defined(__WINNT__)
+/// The bulk CRC-16 functions (crc_16_ibm, crc3_crc16_ibm, Crc16CCITT::crc,
+/// crc3_crc16_ccitt) process eight bytes per step, using 4 kbytes of lookup
+/// tables per polynomial. Off by default on microcontrollers.
+#define CRC16_SLICE_BY_8 1
+#else
+#define CRC16_SLICE_BY_8 0
+#endif
+#endif
 
 
 /** Computes the 16-bit CRC value over data using the CRC16-ANSI (aka
@@ -280,19 +290,41 @@ public:
 #endif
     }
 
-    /// Computes the 16-bit CRC value over data
-    /// @param data what to compute the checksum over
+    /// Processes a sequence of bytes of the incoming message.
+    /// @param data next bytes in the message.
     /// @param length_bytes how long data is
-    void crc(const void* data, size_t length_bytes)
+    void update(const void *data, size_t length_bytes)
     {
+#if CRC16_SLICE_BY_8
+        state_ = update_slice8(state_, data, length_bytes);
+#else
         const uint8_t *payload = static_cast<const uint8_t*>(data);
-        init();
         for (size_t i = 0; i < length_bytes; ++i)
         {
             update(payload[i]);
         }
+#endif
     }
 
+    /// Computes the 16-bit CRC value over data
+    /// @param data what to compute the checksum over
+    /// @param length_bytes how long data is
+    void crc(const void* data, size_t length_bytes)
+    {
+        init();
+        update(data, length_bytes);
+    }
+
+#if CRC16_SLICE_BY_8
+    /// Advances a CRC state over a sequence of bytes, eight bytes per step.
+    /// @param state CRC state before the data.
+    /// @param data next bytes in the message.
+    /// @param length_bytes how long data is
+    /// @return CRC state after the data.
+    static uint16_t update_slice8(
+        uint16_t state, const void *data, size_t length_bytes);
+#endif
+
 private:
     // Of the static tables here only those will be linked into a binary which
     // have been used there.
@@ -322,6 +354,10 @@ private:
 /// @param data what to compute the checksum over
 /// @param length_bytes how long data is
 /// @param checksum is the output buffer where to store the 48-bit checksum.
+#if CRC16_SLICE_BY_8
+void crc3_crc16_ccitt(
+    const void* data, size_t length_bytes, uint16_t checksum[3]);
+#else
 static inline void crc3_crc16_ccitt(
     const void* data, size_t length_bytes, uint16_t checksum[3])
 {
@@ -350,5 +386,6 @@ static inline void crc3_crc16_ccitt(
     checksum[1] = crc_even.get();
     checksum[2] = crc_odd.get();
 }
+#endif // CRC16_SLICE_BY_8
 
 #endif // _UTILS_CRC_HXX_
\ No newline at end of file
@@ -146,6 +146,24 @@ public:
     QueueType pendingSend_;
 };
 
+const LinkedDataBufferPtr *MessageAccessor<uint8_t[]>::convert(
+    DirectHubSegmentType type)
+{
+    unsigned idx = (unsigned)type;
+    if (convertedMask_ & (1u << idx))
+    {
+        return converted_[idx].size() ? &converted_[idx] : nullptr;
+    }
+    convertedMask_ |= (1u << idx);
+    MessageConverter *c = converters_[(unsigned)type_][idx];
+    if (!c || !buf_.size() || !c->convert(buf_, &converted_[idx]))
+    {
+        converted_[idx].reset();
+        return nullptr;
+    }
+    return &converted_[idx];
+}
+
 template <class T>
 class DirectHubImpl : public DirectHubInterface<T>,
                       protected StateFlowBase,
@@ -209,6 +227,30 @@ public:
         return &msg_;
     }
 
+    void set_converter(DirectHubSegmentType from, DirectHubSegmentType to,
+        std::unique_ptr<MessageConverter> converter) override
+    {
+        // Runs on the service to ensure that no message is being converted
+        // while we swap the converter out.
+        MessageConverter *c = converter.release();
+        service()->enqueue_caller(new CallbackExecutable([this, from, to, c]() {
+            install_converter(from, to, c);
+            service()->on_done();
+        }));
+    }
+
+    /// Installs a converter right away. Must be called either on the hub's
+    /// service, or before the hub is handed out to any port or sender.
+    /// @param from segment type of the source messages.
+    /// @param to segment type of the output.
+    /// @param c the conversion implementation, ownership is transferred.
+    void install_converter(
+        DirectHubSegmentType from, DirectHubSegmentType to, MessageConverter *c)
+    {
+        converters_[(unsigned)from][(unsigned)to].reset(c);
+        msg_.converters_[(unsigned)from][(unsigned)to] = c;
+    }
+
     void do_send() override
     {
         unsigned next_port = 0;
@@ -253,6 +295,10 @@ private:
 
     /// The message we are trying to send.
     MessageAccessor<T> msg_;
+
+    /// Owns the message converters. Indexed by [from][to].
+    std::unique_ptr<MessageConverter> converters_[NUM_DIRECT_HUB_SEGMENT_TYPES]
+                                                 [NUM_DIRECT_HUB_SEGMENT_TYPES];
 }; // class DirectHubImpl
 
 /// Temporary function to instantiate the hub.
@@ -260,6 +306,12 @@ DirectHubInterface<uint8_t[]> *create_hub(ExecutorBase *e)
 {
     auto *s = new DirectHubService(e);
     auto *dh = new DirectHubImpl<uint8_t[]>(s);
+    // Nobody can send to the hub yet, so the converters are installed
+    // synchronously; they are in place before the first message.
+    dh->install_converter(DirectHubSegmentType::GRIDCONNECT,
+        DirectHubSegmentType::CAN_FRAMES, create_gc_to_can_frame_converter());
+    dh->install_converter(DirectHubSegmentType::CAN_FRAMES,
+        DirectHubSegmentType::GRIDCONNECT, create_can_frame_to_gc_converter());
     return dh;
 }
 
@@ -271,6 +323,9 @@ class DirectHubPortSelect : public DirectHubPort<uint8_t[]>,
                             private StateFlowBase
 {
 private:
+    /// Format of the data on this port, both for reading and writing.
+    DirectHubSegmentType type_;
+
     /// State flow that reads the FD and sends the read data to the direct hub.
     class DirectHubReadFlow : public StateFlowBase
     {
@@ -466,6 +521,7 @@ private:
             auto *m = parent_->hub_->mutable_message();
             m->set_done(buf_.tail()->new_child());
             m->source_ = parent_;
+            m->type_ = parent_->type_;
             // This call transfers the chained head of the current buffers,
             // taking additional references where necessary or transferring the
             // existing reference. It adjusts the skip_ and size_ arguments in
@@ -539,6 +595,7 @@ public:
         std::unique_ptr<MessageSegmenter> segmenter,
         Notifiable *on_error = nullptr)
         : StateFlowBase(hub->get_service())
+        , type_(segmenter->segment_type())
         , readFlow_(this, std::move(segmenter))
         , readFlowPending_(1)
         , writeFlowPending_(1)
@@ -575,9 +632,15 @@ public:
             // Port already closed. Ignore data to send.
             return;
         }
+        const LinkedDataBufferPtr *payload = msg->payload(type_);
+        if (!payload)
+        {
+            // Not representable in the format of this port.
+            return;
+        }
         {
             AtomicHolder h(lock());
-            if (pendingTail_ && pendingTail_->buf_.try_append_from(msg->buf_))
+            if (pendingTail_ && pendingTail_->buf_.try_append_from(*payload))
             {
                 // Successfully enqueued the bytes into the tail of the queue.
                 // Nothing else to do here.
@@ -589,7 +652,7 @@ public:
         /// enqueueing them.
         BufferType *b;
         mainBufferPool->alloc(&b);
-        b->data()->buf_.reset(msg->buf_);
+        b->data()->buf_.reset(*payload);
         if (msg->done_)
         {
             b->set_done(msg->done_->new_child());
@@ -604,7 +667,7 @@ public:
                 return;
             }
             pendingQueue_.insert_locked(b);
-            totalPendingSize_ += msg->buf_.size();
+            totalPendingSize_ += payload->size();
             pendingTail_ = b->data();
             if (notRunning_)
             {
@@ -900,7 +963,11 @@ public:
     /// @param can_hub Which CAN-hub should we attach the TCP gridconnect hub
     /// onto.
     /// @param port TCp port number to listen on.
-    DirectGcTcpHub(DirectHubInterface<uint8_t[]> *gc_hub, int port);
+    /// @param segmenter_factory creates the segmenter for each incoming
+    /// connection; determines the protocol spoken on the port.
+    DirectGcTcpHub(DirectHubInterface<uint8_t[]> *gc_hub, int port,
+        MessageSegmenter *(*segmenter_factory)() =
+            &create_gc_message_segmenter);
     ~DirectGcTcpHub();
 
     /// @return true of the listener is ready to accept incoming connections.
@@ -918,6 +985,8 @@ private:
 
     /// Direct GridConnect hub.
     DirectHubInterface<uint8_t[]> *gcHub_;
+    /// Creates the segmenter for incoming connections.
+    MessageSegmenter *(*segmenterFactory_)();
     /// Helper object representing the listening on the socket.
     SocketListener tcpListener_;
 };
@@ -933,12 +1002,14 @@ void DirectGcTcpHub::OnNewConnection(int fd)
         LOG(ALWAYS, "Socket rcvbuf %u", (unsigned)rcvbuf);
     }
 #endif    
-    create_port_for_fd(gcHub_, fd,
-        std::unique_ptr<MessageSegmenter>(create_gc_message_segmenter()));
+    create_port_for_fd(
+        gcHub_, fd, std::unique_ptr<MessageSegmenter>(segmenterFactory_()));
 }
 
-DirectGcTcpHub::DirectGcTcpHub(DirectHubInterface<uint8_t[]> *gc_hub, int port)
+DirectGcTcpHub::DirectGcTcpHub(DirectHubInterface<uint8_t[]> *gc_hub, int port,
+    MessageSegmenter *(*segmenter_factory)())
     : gcHub_(gc_hub)
+    , segmenterFactory_(segmenter_factory)
     , tcpListener_(port,
           std::bind(
               &DirectGcTcpHub::OnNewConnection, this, std::placeholders::_1))
@@ -955,4 +1026,9 @@ void create_direct_gc_tcp_hub(DirectHubInterface<uint8_t[]> *hub, int port)
     new DirectGcTcpHub(hub, port);
 }
 
+void create_direct_openlcb_tcp_hub(DirectHubInterface<uint8_t[]> *hub, int port)
+{
+    new DirectGcTcpHub(hub, port, &create_openlcb_tcp_message_segmenter);
+}
+
 #endif // OPENMRN_FEATURE_BSD_SOCKETS
\ No newline at end of file
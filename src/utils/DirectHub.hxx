@@ -37,6 +37,10 @@
 #ifndef _UTILS_DIRECTHUB_HXX_
 #define _UTILS_DIRECTHUB_HXX_
 
+#include <algorithm>
+#include <string.h>
+
+#include "can_frame.h"
 #include "executor/Executor.hxx"
 #include "utils/DataBuffer.hxx"
 
@@ -102,6 +106,44 @@ public:
     BufferPtr<T> payload_;
 };
 
+/// Describes how the bytes of a message on a byte stream typed hub have to be
+/// interpreted.
+enum class DirectHubSegmentType : uint8_t
+{
+    /// GridConnect text, or an arbitrary byte stream. This is the default.
+    GRIDCONNECT = 0,
+    /// One or more binary struct can_frame objects back to back.
+    CAN_FRAMES,
+    /// A single binary OpenLCB-TCP message, starting with the TCP transport
+    /// header.
+    OPENLCB_TCP,
+    /// Number of entries in this enum.
+    NUM_SEGMENT_TYPES
+};
+
+/// Number of different segment types a byte stream typed hub knows about.
+static constexpr unsigned NUM_DIRECT_HUB_SEGMENT_TYPES =
+    (unsigned)DirectHubSegmentType::NUM_SEGMENT_TYPES;
+
+/// Abstract base class for converting the payload of a message from one
+/// segment type to another.
+///
+/// Converters are owned by the hub and are called on the hub's flow,
+/// therefore implementations do not need to be thread-safe, and may keep
+/// state (such as a partially filled output buffer) between calls.
+class MessageConverter : public Destructable
+{
+public:
+    /// Converts a message.
+    /// @param src payload of the message in the source format.
+    /// @param dst empty buffer, to be filled with the payload in the target
+    /// format.
+    /// @return true if the conversion was successful, false if the message
+    /// has no representation in the target format.
+    virtual bool convert(
+        const LinkedDataBufferPtr &src, LinkedDataBufferPtr *dst) = 0;
+};
+
 /// Type specializer for message interface when we are sending untyped data
 /// (i.e., byte streams).
 template <> struct MessageAccessor<uint8_t[]> : public MessageMetadata
@@ -110,14 +152,98 @@ template <> struct MessageAccessor<uint8_t[]> : public MessageMetadata
     {
         // Walks the buffer links and unrefs everything we own.
         buf_.reset();
+        type_ = DirectHubSegmentType::GRIDCONNECT;
+        if (convertedMask_)
+        {
+            for (auto &c : converted_)
+            {
+                c.reset();
+            }
+            convertedMask_ = 0;
+        }
         MessageMetadata::clear();
     }
+
+    /// Accesses the payload of the message in a given format. If the message
+    /// was sent in a different format, it is converted. The conversion happens
+    /// at most once per message and format; all ports asking for the same
+    /// format get a reference to the same converted buffer.
+    /// @param type the format the caller needs.
+    /// @return the payload, or nullptr if the message cannot be represented
+    /// in the requested format.
+    const LinkedDataBufferPtr *payload(DirectHubSegmentType type)
+    {
+        if (type == type_)
+        {
+            return &buf_;
+        }
+        return convert(type);
+    }
+
     /// Owns a sequence of linked DataBuffers, holds the offset where to start
     /// reading in the first one, and how many bytes are total in scope for
     /// this message.
     LinkedDataBufferPtr buf_;
+    /// Format of the data in buf_.
+    DirectHubSegmentType type_ {DirectHubSegmentType::GRIDCONNECT};
+    /// Converters to use for payload(), indexed by [from][to]. Filled in by
+    /// the hub; not cleared between messages.
+    MessageConverter *converters_[NUM_DIRECT_HUB_SEGMENT_TYPES]
+                                 [NUM_DIRECT_HUB_SEGMENT_TYPES] = {};
+
+private:
+    /// Slow path of payload(). Performs or looks up the conversion.
+    /// @param type the format the caller needs.
+    /// @return converted payload, or nullptr.
+    const LinkedDataBufferPtr *convert(DirectHubSegmentType type);
+
+    /// Cached conversion results, indexed by segment type.
+    LinkedDataBufferPtr converted_[NUM_DIRECT_HUB_SEGMENT_TYPES];
+    /// Bit N is set if a conversion to segment type N was attempted.
+    uint8_t convertedMask_ {0};
 };
 
+/// Calls a function for each CAN frame in a CAN_FRAMES typed payload. The
+/// frames do not need to be aligned, and may span buffer boundaries.
+/// @param payload binary payload consisting of struct can_frame's.
+/// @param fn will be called with a const struct can_frame & argument, once
+/// for every frame.
+template <class F>
+void for_each_can_frame(const LinkedDataBufferPtr &payload, F fn)
+{
+    struct can_frame frame;
+    unsigned filled = 0;
+    DataBuffer *next = payload.head();
+    unsigned skip = payload.skip();
+    size_t len = payload.size();
+    while (len > 0)
+    {
+        uint8_t *ptr;
+        unsigned available;
+        next = next->get_read_pointer(skip, &ptr, &available);
+        skip = 0;
+        if (available > len)
+        {
+            available = len;
+        }
+        len -= available;
+        while (available > 0)
+        {
+            unsigned n = std::min(
+                available, (unsigned)sizeof(struct can_frame) - filled);
+            memcpy(((uint8_t *)&frame) + filled, ptr, n);
+            filled += n;
+            ptr += n;
+            available -= n;
+            if (filled == sizeof(struct can_frame))
+            {
+                fn(frame);
+                filled = 0;
+            }
+        }
+    }
+}
+
 /// Abstract base class for segmenting a byte stream typed input into
 /// meaningful packet sized chunks.
 ///
@@ -148,6 +274,13 @@ public:
     /// Resets internal state machine. The next call to segment_message()
     /// assumes no previous data present.
     virtual void clear() = 0;
+
+    /// @return the format of the messages this segmenter produces. This is
+    /// also the format in which the port will write messages to its output.
+    virtual DirectHubSegmentType segment_type()
+    {
+        return DirectHubSegmentType::GRIDCONNECT;
+    }
 };
 
 /// Interface for a downstream port of a hub (aka a target to send data to).
@@ -157,7 +290,8 @@ public:
     /// Send some data out on this port. The callee is responsible for
     /// buffering or enqueueing the data that came in this call.
     /// @param msg represents the message that needs to be sent. The callee
-    /// must not modify the message.
+    /// must not modify the message, except by calling payload() to get it
+    /// in a different format.
     virtual void send(MessageAccessor<T> *msg) = 0;
 };
 
@@ -198,11 +332,25 @@ public:
     /// Sends a message to the hub. Before this is called, the message has to
     /// be filled in via mutable_message().
     virtual void do_send() = 0;
+
+    /// Installs a converter between two segment types. Messages are converted
+    /// only when a port asks for them in a different format than they were
+    /// sent in. Only meaningful for byte stream typed hubs.
+    /// @param from segment type of the source messages.
+    /// @param to segment type of the output.
+    /// @param converter the conversion implementation, ownership is
+    /// transferred. nullptr removes the converter.
+    virtual void set_converter(DirectHubSegmentType from,
+        DirectHubSegmentType to,
+        std::unique_ptr<MessageConverter> converter) = 0;
 };
 
 typedef DirectHubInterface<uint8_t[]> ByteDirectHubInterface;
 
-/// Creates a new byte stream typed hub.
+/// Creates a new byte stream typed hub. The hub will have converters
+/// installed between GRIDCONNECT and CAN_FRAMES typed messages by the time
+/// this function returns. There is no converter between OPENLCB_TCP and the
+/// CAN formats.
 ByteDirectHubInterface *create_hub(ExecutorBase *e);
 
 /// Creates a hub port of byte stream type reading/writing a given fd. This
@@ -230,10 +378,40 @@ void create_direct_gc_tcp_hub(ByteDirectHubInterface *hub, int port);
 /// off of a data stream.
 MessageSegmenter *create_gc_message_segmenter();
 
+/// Creates a new OpenLCB-TCP listener on a given TCP port. The object is
+/// leaked (never destroyed). The clients exchange traffic only with other
+/// OPENLCB_TCP ports of the hub, unless a converter to the CAN formats is
+/// installed with set_converter().
+/// @param hub incoming and outgoing data will be multiplexed through this hub
+/// instance.
+/// @param port the TCP port to listen on.
+void create_direct_openlcb_tcp_hub(ByteDirectHubInterface *hub, int port);
+
 /// Creates a message segmenter for arbitrary data. Each buffer is left alone.
 /// @return a newly allocated message segmenter.
 MessageSegmenter *create_trivial_message_segmenter();
 
+/// Creates a message segmenter for binary struct can_frame data, such as read
+/// from an OpenMRN CAN device driver. Each message is a batch of whole
+/// frames.
+/// @return a newly allocated message segmenter producing CAN_FRAMES typed
+/// messages.
+MessageSegmenter *create_can_frame_message_segmenter();
+
+/// Creates a message segmenter for the binary OpenLCB-TCP protocol.
+/// @return a newly allocated message segmenter producing OPENLCB_TCP typed
+/// messages, one OpenLCB-TCP message each.
+MessageSegmenter *create_openlcb_tcp_message_segmenter();
+
+/// Creates a converter that parses gridconnect text into CAN frames. Packets
+/// that are not valid gridconnect are dropped.
+/// @return a newly allocated converter from GRIDCONNECT to CAN_FRAMES.
+MessageConverter *create_gc_to_can_frame_converter();
+
+/// Creates a converter that renders CAN frames into gridconnect text.
+/// @return a newly allocated converter from CAN_FRAMES to GRIDCONNECT.
+MessageConverter *create_can_frame_to_gc_converter();
+
 // Forward declarations to avoid needing to include Hub.hxx here.
 template <class T> class GenericHubFlow;
 template <class T> class HubContainer;
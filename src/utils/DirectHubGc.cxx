@@ -34,6 +34,15 @@
 
 #include "utils/DirectHub.hxx"
 
+#include "utils/GcStreamParser.hxx"
+#include "utils/gc_format.h"
+
+extern DataBufferPool g_direct_hub_kbyte_pool;
+
+/// This object forwards allocations to mainBufferPool. The blocks allocated
+/// here are used to hold gridconnect packets converted to binary CAN frames.
+DataBufferPool g_direct_hub_frame_pool(16 * sizeof(struct can_frame));
+
 /// Message segmenter that chops incoming byte stream into gridconnect packets.
 class DirectHubGcSegmenter : public MessageSegmenter
 {
@@ -146,3 +155,181 @@ MessageSegmenter *create_trivial_message_segmenter()
 {
     return new DirectHubTrivialSegmenter();
 }
+
+/// Message segmenter that chops a binary stream of struct can_frame's into
+/// batches of whole frames.
+class DirectHubCanFrameSegmenter : public MessageSegmenter
+{
+public:
+    ssize_t segment_message(const void *d, size_t size) override
+    {
+        total_ += size;
+        // All complete frames go into one message. The partial frame at the
+        // end will be passed to us again after clear().
+        return total_ - (total_ % sizeof(struct can_frame));
+    }
+
+    void clear() override
+    {
+        total_ = 0;
+    }
+
+    DirectHubSegmentType segment_type() override
+    {
+        return DirectHubSegmentType::CAN_FRAMES;
+    }
+
+private:
+    /// How many bytes we have seen since the last clear.
+    size_t total_ {0};
+};
+
+MessageSegmenter *create_can_frame_message_segmenter()
+{
+    return new DirectHubCanFrameSegmenter();
+}
+
+/// Base class for converters that render their output into a shared series
+/// of buffers. Consecutive messages use consecutive bytes of the same buffer,
+/// the same way as the read flow of the ports does with its input.
+class DirectHubBufferedConverter : public MessageConverter
+{
+protected:
+    /// Constructor.
+    /// @param pool where to allocate the output buffers from.
+    DirectHubBufferedConverter(DataBufferPool *pool)
+        : pool_(pool)
+    {
+    }
+
+    /// Ensures there is enough space for writing the output.
+    /// @param len how many bytes the caller wants to write.
+    /// @return pointer where to write the bytes.
+    uint8_t *reserve(size_t len)
+    {
+        if (out_.free() < len)
+        {
+            DataBuffer *b;
+            pool_->alloc(&b);
+            out_.append_empty_buffer(b);
+        }
+        return out_.data_write_pointer();
+    }
+
+    /// Commits the output that was written into the space from reserve().
+    /// @param len how many bytes were written.
+    void commit(size_t len)
+    {
+        out_.data_write_advance(len);
+        pending_ += len;
+    }
+
+    /// Transfers the committed output to the caller.
+    /// @param dst where to put the output.
+    /// @return true if there was any output.
+    bool finish(LinkedDataBufferPtr *dst)
+    {
+        if (!pending_)
+        {
+            return false;
+        }
+        *dst = out_.transfer_head(pending_);
+        pending_ = 0;
+        return true;
+    }
+
+private:
+    /// Pool for allocating output buffers.
+    DataBufferPool *pool_;
+    /// Output buffer that we are rendering into.
+    LinkedDataBufferPtr out_;
+    /// How many bytes are in out_ that have not been transferred yet.
+    size_t pending_ {0};
+};
+
+/// Converts gridconnect packets to binary CAN frames.
+class DirectHubGcToCanFrameConverter : public DirectHubBufferedConverter
+{
+public:
+    DirectHubGcToCanFrameConverter()
+        : DirectHubBufferedConverter(&g_direct_hub_frame_pool)
+    {
+    }
+
+    bool convert(
+        const LinkedDataBufferPtr &src, LinkedDataBufferPtr *dst) override
+    {
+        GcStreamParser parser;
+        DataBuffer *next = src.head();
+        unsigned skip = src.skip();
+        size_t len = src.size();
+        while (len > 0)
+        {
+            uint8_t *ptr;
+            unsigned available;
+            next = next->get_read_pointer(skip, &ptr, &available);
+            skip = 0;
+            if (available > len)
+            {
+                available = len;
+            }
+            len -= available;
+            const char *b = (const char *)ptr;
+            const char *e = b + available;
+            while (parser.consume_data(&b, e))
+            {
+                struct can_frame frame;
+                // Avoids leaking uninitialized bytes to the output.
+                memset(&frame, 0, sizeof(frame));
+                if (!parser.parse_frame_to_output(&frame))
+                {
+                    continue;
+                }
+                memcpy(reserve(sizeof(frame)), &frame, sizeof(frame));
+                commit(sizeof(frame));
+            }
+        }
+        return finish(dst);
+    }
+};
+
+MessageConverter *create_gc_to_can_frame_converter()
+{
+    return new DirectHubGcToCanFrameConverter();
+}
+
+/// Converts binary CAN frames to gridconnect packets.
+class DirectHubCanFrameToGcConverter : public DirectHubBufferedConverter
+{
+public:
+    DirectHubCanFrameToGcConverter()
+        : DirectHubBufferedConverter(&g_direct_hub_kbyte_pool)
+    {
+    }
+
+    bool convert(
+        const LinkedDataBufferPtr &src, LinkedDataBufferPtr *dst) override
+    {
+        for_each_can_frame(src, [this](const struct can_frame &frame) {
+            if (IS_CAN_FRAME_ERR(frame))
+            {
+                // Has no gridconnect representation.
+                return;
+            }
+            char *start = (char *)reserve(MAX_GC_LEN);
+            char *end = gc_format_generate(&frame, start, 0);
+            commit(end - start);
+        });
+        return finish(dst);
+    }
+
+private:
+    /// Maximum length of a rendered gridconnect packet, including the
+    /// optional newline.
+    static constexpr unsigned MAX_GC_LEN = 29;
+};
+
+MessageConverter *create_can_frame_to_gc_converter()
+{
+    return new DirectHubCanFrameToGcConverter();
+}
@@ -34,12 +34,14 @@
 
 #include "utils/DirectHub.hxx"
 #include "utils/Hub.hxx"
-#include "utils/gc_format.h"
 
 extern DataBufferPool g_direct_hub_kbyte_pool;
 
-/// Bridge component that converts the outgoing CAN packets into gridconnect
-/// format and enqueues them into the DirectHub for sending.
+/// Bridge component that enqueues the outgoing CAN packets into the DirectHub
+/// as binary CAN frames, and forwards the CAN frames coming from the
+/// DirectHub to the CAN hub. The conversion to and from gridconnect format is
+/// done by the DirectHub, at most once per packet, and only if there is a
+/// port that needs it.
 class HubToGcPort : public CanHubPort, public DirectHubPort<uint8_t[]>
 {
 public:
@@ -62,17 +64,17 @@ public:
     Action entry() override
     {
         // Allocates output buffer if needed.
-        if (buf_.free() < MIN_GC_FREE)
+        if (buf_.free() < sizeof(struct can_frame))
         {
             // Need more output buffer.
             DataBuffer *b;
             g_direct_hub_kbyte_pool.alloc(&b);
             buf_.append_empty_buffer(b);
         }
-        // Generates gridconnect message and commits to buffer.
-        char *start = (char *)buf_.data_write_pointer();
-        char *end = gc_format_generate(message()->data(), start, 0);
-        packetSize_ = end - start;
+        // Copies the frame and commits to buffer.
+        const struct can_frame *frame = message()->data();
+        memcpy(buf_.data_write_pointer(), frame, sizeof(*frame));
+        packetSize_ = sizeof(*frame);
         buf_.data_write_advance(packetSize_);
         pktDone_ = message()->new_child();
         release();
@@ -98,6 +100,7 @@ public:
     {
         auto *m = targetHub_->mutable_message();
         m->buf_ = buf_.transfer_head(packetSize_);
+        m->type_ = DirectHubSegmentType::CAN_FRAMES;
         m->source_ = (DirectHubPort<uint8_t[]> *)this;
         m->done_ = pktDone_;
         targetHub_->do_send();
@@ -112,52 +115,32 @@ public:
         }
     }
 
-    /// GC to binary path. Called by the DirectHub with a text packet or a
-    /// garbage packet.
+    /// Binary path. Called by the DirectHub with a packet of any type; the
+    /// hub converts it to CAN frames if possible.
     void send(MessageAccessor<uint8_t[]> *msg) override
     {
-        auto &buf = msg->buf_;
-        uint8_t *p;
-        unsigned available;
-        buf.head()->get_read_pointer(buf.skip(), &p, &available);
-        if (buf.size() == 0 || *p != ':')
+        const LinkedDataBufferPtr *frames =
+            msg->payload(DirectHubSegmentType::CAN_FRAMES);
+        if (!frames)
         {
-            // Not a gridconnect packet. Do not do anything.
+            // Not a CAN packet. Do not do anything.
             return;
         }
-        Buffer<CanHubData> *can_buf = sourceHub_->alloc();
-        if (msg->done_)
-        {
-            can_buf->set_done(msg->done_->new_child());
-        }
-        can_buf->data()->skipMember_ = (CanHubPort *)this;
-        const char *text_packet = nullptr;
-        string assembled_packet;
-        if (available == buf.size())
-        {
-            // One block of data. Convert in place.
-            text_packet = (const char *)p;
-        }
-        else
-        {
-            buf.append_to(&assembled_packet);
-            text_packet = assembled_packet.c_str();
-        }
-        if (gc_format_parse(text_packet, can_buf->data()) < 0)
-        {
-            string debug(text_packet, buf.size());
-            LOG(INFO, "Failed to parse gridconnect packet: '%s'",
-                debug.c_str());
-            can_buf->unref();
-            return;
-        }
-        /// @todo consider if we need to set the priority here.
-        sourceHub_->send(can_buf, 0);
+        for_each_can_frame(*frames, [this, msg](const struct can_frame &f) {
+            Buffer<CanHubData> *can_buf = sourceHub_->alloc();
+            if (msg->done_)
+            {
+                can_buf->set_done(msg->done_->new_child());
+            }
+            can_buf->data()->skipMember_ = (CanHubPort *)this;
+            *can_buf->data()->mutable_frame() = f;
+            /// @todo consider if we need to set the priority here.
+            sourceHub_->send(can_buf, 0);
+        });
     }
 
 private:
-    /// Output buffer of gridconnect bytes that will be sent to the GC
-    /// DirectHub.
+    /// Output buffer of binary CAN frames that will be sent to the DirectHub.
     LinkedDataBufferPtr buf_;
     /// Where to send the target data.
     DirectHubInterface<uint8_t[]> *targetHub_;
@@ -172,11 +155,8 @@ private:
     bool inlineRun_ : 1;
     /// True if the send completed inline.
     bool inlineComplete_ : 1;
-    /// Number of bytes this gridconnect packet is.
+    /// Number of bytes this packet is.
     uint16_t packetSize_;
-    /// Minimum amount of free bytes in the current send buffer in order to use
-    /// it for gridconnect rendering.
-    static constexpr unsigned MIN_GC_FREE = 29;
 };
 
 Destructable *create_gc_to_legacy_can_bridge(
@@ -0,0 +1,108 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file DirectHubTcp.cxx
+ *
+ * OpenLCB-TCP support for DirectHub.
+ *
+ * @author Balazs Racz
+ * @date 18 Oct 2026
+ */
+
+#include "utils/DirectHub.hxx"
+
+/// Message segmenter that chops an incoming byte stream into binary
+/// OpenLCB-TCP messages, using the length field of the TCP transport header.
+class DirectHubTcpSegmenter : public MessageSegmenter
+{
+public:
+    DirectHubTcpSegmenter()
+    {
+        clear();
+    }
+
+    ssize_t segment_message(const void *d, size_t size) override
+    {
+        const uint8_t *data = static_cast<const uint8_t *>(d);
+        while (hdrLen_ < HDR_SIZE_END && size > 0)
+        {
+            hdr_[hdrLen_++] = *data++;
+            --size;
+            ++seen_;
+        }
+        if (hdrLen_ < HDR_SIZE_END)
+        {
+            return 0;
+        }
+        if (!expected_)
+        {
+            expected_ = HDR_SIZE_END +
+                ((uint32_t(hdr_[HDR_SIZE_OFS]) << 16) |
+                    (uint32_t(hdr_[HDR_SIZE_OFS + 1]) << 8) |
+                    hdr_[HDR_SIZE_OFS + 2]);
+        }
+        seen_ += size;
+        if (seen_ >= expected_)
+        {
+            return expected_;
+        }
+        return 0;
+    }
+
+    void clear() override
+    {
+        hdrLen_ = 0;
+        seen_ = 0;
+        expected_ = 0;
+    }
+
+    DirectHubSegmentType segment_type() override
+    {
+        return DirectHubSegmentType::OPENLCB_TCP;
+    }
+
+private:
+    /// Offset of the 24-bit big-endian length field in the header. Same as
+    /// openlcb::TcpDefs::HDR_SIZE_OFS.
+    static constexpr unsigned HDR_SIZE_OFS = 2;
+    /// The length field counts the bytes after this offset. Same as
+    /// openlcb::TcpDefs::HDR_SIZE_END.
+    static constexpr unsigned HDR_SIZE_END = 5;
+
+    /// Collects the beginning of the header, which may arrive in pieces.
+    uint8_t hdr_[HDR_SIZE_END];
+    /// How many bytes of hdr_ are filled in.
+    uint8_t hdrLen_;
+    /// How many bytes of the current message we have seen.
+    uint32_t seen_;
+    /// Total length of the current message, or 0 if not known yet.
+    uint32_t expected_;
+};
+
+MessageSegmenter *create_openlcb_tcp_message_segmenter()
+{
+    return new DirectHubTcpSegmenter();
+}
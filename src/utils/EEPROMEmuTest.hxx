@@ -293,3 +293,50 @@ TEST_F(EepromTest, many_overflow) {
     EXPECT_AT(13, "abcd");
     EXPECT_EQ(s, e->activeSector_);
 }
+
+TEST_F(EepromTest, random_writes) {
+    create();
+    string ref(eeprom_size, '\xFF');
+    unsigned int seed = 17;
+    for (int i = 0; i < 3000; ++i) {
+        unsigned ofs = rand_r(&seed) % (eeprom_size - 8);
+        string d(1 + rand_r(&seed) % 8, 'a' + (i % 26));
+        write_to(ofs, d);
+        ref.replace(ofs, d.size(), d);
+        if (i % 500 == 0) {
+            EXPECT_AT(0, ref);
+        }
+    }
+    EXPECT_AT(0, ref);
+    EXPECT_AT(13, ref.substr(13, 7));
+    // Reboot MCU
+    create(false);
+    EXPECT_AT(0, ref);
+    write_to(21, "xyz");
+    ref.replace(21, 3, "xyz");
+    EXPECT_AT(0, ref);
+}
+
+/// Reads the entire eeprom in small pieces after a reboot, when the journal
+/// in the active sector is almost full. This is what happens at boot when
+/// every config update listener reads its fields.
+TEST_F(EepromTest, boot_benchmark) {
+    create();
+    unsigned ofs = 0;
+    for (unsigned i = 0; e->avail() > 4; ++i) {
+        write_to(ofs, string(1, 'a' + (i % 26)));
+        ofs = (ofs + 7) % eeprom_size;
+    }
+    long long start = os_get_time_monotonic();
+    static constexpr int ROUNDS = 20;
+    for (int i = 0; i < ROUNDS; ++i) {
+        create(false);
+        for (unsigned ofs = 0; ofs < eeprom_size; ofs += 4) {
+            uint8_t d[4];
+            ee()->read(ofs, d, 4);
+        }
+    }
+    long long duration = os_get_time_monotonic() - start;
+    LOG(INFO, "mount and read %u bytes with %u journal slots: %lld usec",
+        eeprom_size, e->slot_count(), duration / ROUNDS / 1000);
+}
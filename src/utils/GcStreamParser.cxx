@@ -32,11 +32,65 @@
  * @date 26 May 2016
  */
 
+#include <string.h>
 #include <string>
 
+#include "openmrn_features.h"
 #include "utils/GcStreamParser.hxx"
 #include "utils/gc_format.h"
 
+#if OPENMRN_HAVE_SSE2
+#include <emmintrin.h>
+#elif OPENMRN_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+/// Finds the first frame start or frame end character.
+/// @param p is the beginning of the characters to search.
+/// @param end is the end of the characters to search.
+/// @return pointer to the first ':' or ';' character, or end if there is
+/// none.
+static const char *find_delimiter(const char *p, const char *end)
+{
+#if OPENMRN_HAVE_SSE2
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned found = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, semicolon)));
+        if (found)
+        {
+            return p + __builtin_ctz(found);
+        }
+    }
+#elif OPENMRN_HAVE_NEON
+    const uint8x16_t colon = vdupq_n_u8(':');
+    const uint8x16_t semicolon = vdupq_n_u8(';');
+    for (; end - p >= 16; p += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        uint8x16_t eq = vorrq_u8(vceqq_u8(v, colon), vceqq_u8(v, semicolon));
+        // Narrows each byte of the comparison result to 4 bits.
+        uint64_t found = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (found)
+        {
+            return p + (__builtin_ctzll(found) >> 2);
+        }
+    }
+#endif
+    for (; p < end; ++p)
+    {
+        if (*p == ':' || *p == ';')
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
 bool GcStreamParser::consume_byte(char c)
 {
     if (c == ':')
@@ -75,6 +129,54 @@ bool GcStreamParser::consume_byte(char c)
     return false;
 }
 
+bool GcStreamParser::consume_data(const char **data, const char *end)
+{
+    const char *p = *data;
+    while (p < end)
+    {
+        if (offset_ < 0)
+        {
+            // Drops bytes to the floor until the next frame start.
+            p = static_cast<const char *>(memchr(p, ':', end - p));
+            if (!p)
+            {
+                p = end;
+                break;
+            }
+            offset_ = 0;
+            ++p;
+            continue;
+        }
+        const char *d = find_delimiter(p, end);
+        if (offset_ + (d - p) > static_cast<int>(sizeof(cbuf_) - 1))
+        {
+            // We overran the buffer, so this can't be a valid frame.
+            offset_ = -1;
+            p = d;
+            continue;
+        }
+        memcpy(cbuf_ + offset_, p, d - p);
+        offset_ += d - p;
+        p = d;
+        if (p == end)
+        {
+            break;
+        }
+        if (*p++ == ';')
+        {
+            // Frame ends here.
+            cbuf_[offset_] = 0;
+            offset_ = -1;
+            *data = p;
+            return true;
+        }
+        // Frame is (re)starting here.
+        offset_ = 0;
+    }
+    *data = p;
+    return false;
+}
+
 void GcStreamParser::frame_buffer(std::string* payload) {
     if (offset_ >= 0) {
         payload->assign(cbuf_, offset_);
@@ -56,6 +56,19 @@ public:
      * internal buffer contains a complete frame. @param c next character. */
     bool consume_byte(char c);
 
+    /** Adds a sequence of characters from the source stream. Stops after the
+     * first complete frame. The result is the same as calling consume_byte()
+     * for each character, but the frame delimiters are located many
+     * characters at a time.
+     *
+     * @param data is the beginning of the characters to process; will be
+     * advanced beyond the processed characters.
+     * @param end is the end of the characters to process.
+     * @return true if the internal buffer contains a complete frame (then
+     * *data points after the frame end character); false if all characters
+     * were consumed. */
+    bool consume_data(const char **data, const char *end);
+
     /** Parses the current contents of the frame buffer to a can_frame
      * struct. Should be called if and inly if the previous consume_char call
      * returned true.
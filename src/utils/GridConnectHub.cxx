@@ -283,7 +283,7 @@ public:
         Action entry() override
         {
             inBuf_ = message()->data()->data();
-            inBufSize_ = message()->data()->size();
+            inBufEnd_ = inBuf_ + message()->data()->size();
             return call_immediately(STATE(parse_more_data));
         }
 
@@ -291,15 +291,11 @@ public:
         /// frames. @return next state.
         Action parse_more_data()
         {
-            while (inBufSize_--)
+            if (streamSegmenter_.consume_data(&inBuf_, inBufEnd_))
             {
-                char c = *inBuf_++;
-                if (streamSegmenter_.consume_byte(c))
-                {
-                    // End of frame. Allocate an output buffer and parse the
-                    // frame.
-                    return allocate_and_call(destination_, STATE(parse_to_output_frame), frameAllocator_.get());
-                }
+                // End of frame. Allocate an output buffer and parse the
+                // frame.
+                return allocate_and_call(destination_, STATE(parse_to_output_frame), frameAllocator_.get());
             }
             // Will notify the caller.
             return release_and_exit();
@@ -330,8 +326,8 @@ public:
         
         /// The incoming characters.
         const char *inBuf_;
-        /// The remaining number of characters in inBuf_.
-        size_t inBufSize_;
+        /// The end of the incoming characters.
+        const char *inBufEnd_;
 
         // Allocator to get the frame from. If NULL, the target's default
         // buffer pool will be used.
@@ -39,6 +39,7 @@
 
 #include "executor/Dispatcher.hxx"
 #include "can_frame.h"
+#include "openmrn_features.h"
 
 class PipeBuffer;
 class PipeMember;
@@ -91,6 +92,13 @@ struct CanFrameContainer : public StructContainer<can_frame>
     {
         return *this;
     }
+
+#ifdef OPENMRN_HAVE_CAN_RX_TIMESTAMP
+    /// When the frame was received from the bus, as reported by the kernel,
+    /// in nanoseconds since the epoch (CLOCK_REALTIME). 0 if not known. Not
+    /// part of data() / size().
+    long long rxTimestamp_{0};
+#endif
 };
 
 /// Data type wrapper for sending data through a Hub. It adds the @ref
@@ -137,10 +145,17 @@ typedef HubContainer<CanFrameContainer> CanHubData;
 typedef FlowInterface<Buffer<HubData>> HubPortInterface;
 /// Base class for a port to an ascii hub that is implemented as a stateflow.
 typedef StateFlow<Buffer<HubData>, QList<1>> HubPort;
+/// Base class for a port to an ascii hub that only reads the data it is
+/// sent. Such a port gets shared references instead of copies when registered
+/// with register_shared_port().
+typedef MulticastStateFlow<Buffer<HubData>, QList<1>> SharedHubPort;
 /// Interface class for a port to an CAN hub.
 typedef FlowInterface<Buffer<CanHubData>> CanHubPortInterface;
 /// Base class for a port to an CAN hub that is implemented as a stateflow.
 typedef StateFlow<Buffer<CanHubData>, QList<1>> CanHubPort;
+/// Base class for a port to a CAN hub that only reads the frames it is
+/// sent. See @ref SharedHubPort.
+typedef MulticastStateFlow<Buffer<CanHubData>, QList<1>> SharedCanHubPort;
 
 /// This should work for both 32 and 64-bit architectures.
 static const uintptr_t POINTER_MASK = UINTPTR_MAX;
@@ -170,6 +185,17 @@ public:
                                POINTER_MASK);
     }
 
+    /// Adds a new port that will get shared references to the messages
+    /// published to the hub instead of separate copies. The port must not
+    /// modify the messages. Remove with unregister_port().
+    /// @param port is the object to add.
+    void register_shared_port(MulticastFlowInterface<buffer_type> *port)
+    {
+        port_type *p = port;
+        this->register_shared_handler(
+            port, reinterpret_cast<uintptr_t>(p), POINTER_MASK);
+    }
+
     /// Removes a previously added port. @param port is the port to remove.
     virtual void unregister_port(port_type *port)
     {
@@ -237,6 +263,7 @@ namespace openlcb
 {
 class FdToTcpParser;
 }
+class SocketCanReadFlow;
 
 /** Shared base class for thread-based and select-based hub devices. */
 class FdHubPortService : public FdHubPortInterface, public Service
@@ -252,6 +279,7 @@ protected:
     // For barrier_.
     template <class HFlow> friend class HubDeviceSelectReadFlow;
     friend class openlcb::FdToTcpParser;
+    friend class SocketCanReadFlow;
 
     /// Constructor
     /// @param exec executor for the service.
@@ -43,6 +43,9 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <fcntl.h>
+#ifdef OPENMRN_HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 
 #include "executor/StateFlow.hxx"
 #include "utils/Hub.hxx"
@@ -78,6 +81,13 @@ template <> struct SelectBufferInfo<HubFlow::buffer_type>
         return false;
     }
 
+    /// @return true because several buffers can be written to the fd in one
+    /// call.
+    static bool coalesce_writes()
+    {
+        return true;
+    }
+
     /// @return true if the input needs to be throttled.
     static bool limit_input()
     {
@@ -110,6 +120,13 @@ struct SelectBufferInfo<Buffer<HubContainer<StructContainer<T>>>>
         return true;
     }
 
+    /// @return true because several buffers can be written to the fd in one
+    /// call.
+    static bool coalesce_writes()
+    {
+        return true;
+    }
+
     /// @return true if the input needs to be throttled.
     static bool limit_input()
     {
@@ -144,6 +161,13 @@ struct SelectBufferInfo<Buffer<CanHubData>> {
         return true;
     }
 
+    /// @return false, because CAN devices (such as SocketCan) typically take
+    /// exactly one frame per write call.
+    static bool coalesce_writes()
+    {
+        return false;
+    }
+
     /// @return true if the input needs to be throttled.
     static bool limit_input()
     {
@@ -312,7 +336,7 @@ public:
         barrier_.reset(
             on_error ? on_error : EmptyNotifiable::DefaultInstance());
         barrier_.new_child();
-        hub_->register_port(write_port());
+        hub_->register_shared_port(&writeFlow_);
         isRegistered_ = true;
     }
 #endif
@@ -340,7 +364,7 @@ public:
 #else
         ::fcntl(fd, F_SETFL, O_RDWR | O_NONBLOCK);
 #endif
-        hub_->register_port(write_port());
+        hub_->register_shared_port(&writeFlow_);
         isRegistered_ = true;
     }
 
@@ -408,13 +432,73 @@ public:
         return writeFlow_.is_waiting();
     }
 
+    /// @return how many write system calls the device made so far.
+    size_t num_write_calls()
+    {
+        return writeFlow_.num_write_calls();
+    }
+
 protected:
-    /// Base stateflow for the WriteFlow.
-    typedef StateFlow<typename HFlow::buffer_type, QList<1>> WriteFlowBase;
+#ifdef OPENMRN_HAVE_WRITEV
+    /// Scatter-gather entry for ::writev.
+    typedef struct iovec IoVec;
+#else
+    /// Same layout as the struct iovec used by ::writev.
+    struct IoVec
+    {
+        /// Start of the data.
+        void *iov_base;
+        /// Number of bytes.
+        size_t iov_len;
+    };
+#endif
+
+    /// @return how many buffers the write flow may hand to write_batch() at
+    /// once.
+    virtual unsigned write_batch_limit()
+    {
+        return SelectBufferInfo<typename HFlow::buffer_type>::coalesce_writes()
+            ? WriteFlow::MAX_BATCH_BUFFERS
+            : 1;
+    }
+
+    /// Performs one write system call for the buffers of a batch. Called on
+    /// the executor of the hub.
+    ///
+    /// @param fd the file descriptor to write to.
+    /// @param iov the data to write, one entry per buffer.
+    /// @param count number of entries in iov, at least one.
+    /// @return the number of bytes written (which may end in the middle of an
+    /// entry), or -1 with errno set.
+    virtual ssize_t write_batch(int fd, const IoVec *iov, unsigned count)
+    {
+#ifdef OPENMRN_HAVE_WRITEV
+        return ::writev(fd, iov, count);
+#else
+        return ::write(fd, iov[0].iov_base, iov[0].iov_len);
+#endif
+    }
+
+    /// Base stateflow for the WriteFlow. The write flow only reads the
+    /// data, thus it can take shared references from the hub.
+    typedef MulticastStateFlow<typename HFlow::buffer_type, QList<1>>
+        WriteFlowBase;
     /// State flow implementing select-aware fd writes.
+    ///
+    /// Every time the flow wakes up it takes all buffers that are queued at
+    /// that point (up to write_batch_limit() buffers or MAX_BATCH_BYTES
+    /// bytes) and writes them to the fd with a single write_batch() call. For
+    /// a hub of small messages, such as GridConnect frames, this saves most of
+    /// the system calls when there is a backlog.
     class WriteFlow : public WriteFlowBase
     {
     public:
+        /// How many buffers we write at most in one batch.
+        static constexpr unsigned MAX_BATCH_BUFFERS = 32;
+        /// After having collected this many bytes we stop adding more buffers
+        /// to the batch.
+        static constexpr size_t MAX_BATCH_BYTES = 1460;
+
         /// Constructor. @param dev is the parent object.
         WriteFlow(HubDeviceSelect *dev)
             : WriteFlowBase(dev)
@@ -436,9 +520,8 @@ protected:
             auto* e = this->service()->executor();
             if (!selectHelper_.is_empty() && e->is_selected(&selectHelper_)) {
                 e->unselect(&selectHelper_);
-                // will make the internal_try_write exit immediately
-                selectHelper_.remaining_ = 0;
-                // actually wake up the flow
+                // actually wake up the flow; try_write will exit immediately
+                // due to the closed fd.
                 this->notify();
             }
         }
@@ -449,29 +532,125 @@ protected:
             return static_cast<HubDeviceSelect *>(this->service());
         }
 
+        /// @return how many write system calls were made so far.
+        size_t num_write_calls()
+        {
+            return numWriteCalls_;
+        }
+
         StateFlowBase::Action entry() OVERRIDE
         {
             if (device()->fd() < 0) {
                 return this->release_and_exit();
             }
-            return this->write_repeated(&selectHelper_, device()->fd(),
-                this->message()->data()->data(),
-                this->message()->data()->size(), STATE(write_done),
-                this->priority());
+            // Takes over the current message and everything else that is
+            // waiting in the queue. The queue hands out the messages in
+            // priority order, which is the order they have to go on the wire.
+            size_t bytes = 0;
+            unsigned limit = device()->write_batch_limit();
+            if (limit > MAX_BATCH_BUFFERS)
+            {
+                limit = MAX_BATCH_BUFFERS;
+            }
+            numBatch_ = 0;
+            do
+            {
+                auto *b = static_cast<typename HFlow::buffer_type *>(
+                    this->transfer_message());
+                batch_[numBatch_] = b;
+                iov_[numBatch_].iov_base = (void *)b->data()->data();
+                iov_[numBatch_].iov_len = b->data()->size();
+                bytes += b->data()->size();
+                ++numBatch_;
+            } while (numBatch_ < limit &&
+                bytes < MAX_BATCH_BYTES && this->release_and_take_next());
+            iovHead_ = 0;
+            selectHelper_.reset(
+                Selectable::WRITE, device()->fd(), this->priority());
+            selectHelper_.set_wakeup(this);
+            return this->call_immediately(STATE(try_write));
         }
 
-        /// State flow call. @return next state.
-        StateFlowBase::Action write_done()
+        /// Called repeatedly upon every wakeup and tries to make progress on
+        /// writing the current batch. @return next action.
+        StateFlowBase::Action try_write()
         {
-            if (selectHelper_.hasError_) {
-                device()->report_write_error();
+            skip_empty();
+            if (iovHead_ >= numBatch_ || device()->fd() < 0)
+            {
+                return release_batch();
+            }
+            ++numWriteCalls_;
+            ssize_t count = device()->write_batch(
+                device()->fd(), iov_ + iovHead_, numBatch_ - iovHead_);
+            if (count > 0)
+            {
+                consume(count);
+                return this->again();
             }
-            return this->release_and_exit();
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                // Blocked.
+                this->service()->executor()->select(&selectHelper_);
+                return this->wait();
+            }
+            device()->report_write_error();
+            return release_batch();
         }
 
     private:
+        /// Advances the current batch after a partial or complete write.
+        /// @param count is the number of bytes written.
+        void consume(size_t count)
+        {
+            while (count)
+            {
+                IoVec &v = iov_[iovHead_];
+                if (count < v.iov_len)
+                {
+                    v.iov_base = (uint8_t *)v.iov_base + count;
+                    v.iov_len -= count;
+                    return;
+                }
+                count -= v.iov_len;
+                ++iovHead_;
+            }
+        }
+
+        /// Skips over zero-length entries at the head of the batch (e.g. the
+        /// shutdown marker).
+        void skip_empty()
+        {
+            while (iovHead_ < numBatch_ && iov_[iovHead_].iov_len == 0)
+            {
+                ++iovHead_;
+            }
+        }
+
+        /// Releases all buffers of the current batch. @return next action.
+        StateFlowBase::Action release_batch()
+        {
+            for (unsigned i = 0; i < numBatch_; ++i)
+            {
+                batch_[i]->unref();
+            }
+            numBatch_ = 0;
+            return this->exit();
+        }
+
         /// Helper class for asynchronous writes.
         StateFlowBase::StateFlowSelectHelper selectHelper_{this};
+        /// Buffers being written. We own one reference to each.
+        typename HFlow::buffer_type *batch_[MAX_BATCH_BUFFERS];
+        /// Data pointers for the buffers in batch_. The entries before
+        /// iovHead_ are done, the one at iovHead_ may be partially written.
+        IoVec iov_[MAX_BATCH_BUFFERS];
+        /// Number of valid entries in batch_ and iov_.
+        unsigned numBatch_{0};
+        /// Index of the first iov_ entry that is not completely written.
+        unsigned iovHead_{0};
+        /// Statistics: how many write syscalls were made.
+        size_t numWriteCalls_{0};
     };
 
 protected:
@@ -72,6 +72,8 @@ protected:
     friend class ActiveTimers;
     /** ActiveTimers needs to iterate through the queue. */
     friend class ExecutorBase;
+    /** DynamicPool links the buffers in its per-thread caches. */
+    friend class DynamicPool;
     friend class TimerTest;
 };
 
@@ -39,6 +39,8 @@
 #if defined(__linux__)
 
 #include <errno.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <linux/sockios.h>
 #include <net/if.h>
 #include <stdio.h>
@@ -98,4 +100,193 @@ int socketcan_open(const char *device, int loopback)
     return s;
 }
 
+int socketcan_enable_timestamps(int fd, bool hardware)
+{
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (hardware)
+    {
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    ERRNOLOG("setsockopt(timestamping)",
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)));
+    return 0;
+}
+
+constexpr unsigned SocketCanReadFlow::BATCH_SIZE;
+constexpr unsigned SocketCanReadFlow::CONTROL_SIZE;
+
+SocketCanReadFlow::SocketCanReadFlow(FdHubPortService *device,
+    CanHubFlow::port_type *dst, CanHubFlow::port_type *skip_member)
+    : StateFlowBase(device)
+    , dst_(dst)
+    , skipMember_(skip_member)
+{
+    memset(bufs_, 0, sizeof(bufs_));
+    memset(msgs_, 0, sizeof(msgs_));
+    for (unsigned i = 0; i < BATCH_SIZE; ++i)
+    {
+        msgs_[i].msg_hdr.msg_iov = &iov_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    start_flow(STATE(try_read));
+}
+
+SocketCanReadFlow::~SocketCanReadFlow()
+{
+    for (auto *b : bufs_)
+    {
+        if (b)
+        {
+            b->unref();
+        }
+    }
+}
+
+void SocketCanReadFlow::shutdown()
+{
+    auto *e = service()->executor();
+    if (e->is_selected(&selectHelper_))
+    {
+        e->unselect(&selectHelper_);
+    }
+    set_terminated();
+    notify_barrier();
+}
+
+void SocketCanReadFlow::notify_barrier()
+{
+    if (barrierOwned_)
+    {
+        barrierOwned_ = false;
+        device()->barrier_.notify();
+    }
+}
+
+long long socketcan_rx_timestamp(struct msghdr *hdr)
+{
+    long long ret = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(hdr); c; c = CMSG_NXTHDR(hdr, c))
+    {
+        if (c->cmsg_level != SOL_SOCKET)
+        {
+            continue;
+        }
+        if (c->cmsg_type == SCM_TIMESTAMPING &&
+            c->cmsg_len >= CMSG_LEN(sizeof(struct scm_timestamping)))
+        {
+            struct scm_timestamping ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            // ts[2] is the raw hardware timestamp, ts[0] is the software one.
+            const struct timespec &t =
+                (ts.ts[2].tv_sec || ts.ts[2].tv_nsec) ? ts.ts[2] : ts.ts[0];
+            return t.tv_sec * 1000000000LL + t.tv_nsec;
+        }
+        if (c->cmsg_type == SCM_TIMESTAMPNS &&
+            c->cmsg_len >= CMSG_LEN(sizeof(struct timespec)))
+        {
+            // Comes from SO_TIMESTAMPNS, for example on unix sockets.
+            struct timespec t;
+            memcpy(&t, CMSG_DATA(c), sizeof(t));
+            ret = t.tv_sec * 1000000000LL + t.tv_nsec;
+        }
+    }
+    return ret;
+}
+
+StateFlowBase::Action SocketCanReadFlow::try_read()
+{
+    for (unsigned i = 0; i < BATCH_SIZE; ++i)
+    {
+        if (!bufs_[i])
+        {
+            bufs_[i] = dst_->alloc();
+            iov_[i].iov_base = bufs_[i]->data()->mutable_frame();
+            iov_[i].iov_len = sizeof(struct can_frame);
+        }
+        // The kernel overwrites these on every call.
+        msgs_[i].msg_hdr.msg_control = control_[i];
+        msgs_[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+        msgs_[i].msg_hdr.msg_flags = 0;
+    }
+    ++numReadCalls_;
+    int count = ::recvmmsg(device()->fd(), msgs_, BATCH_SIZE, MSG_DONTWAIT,
+        nullptr);
+    if (count < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            selectHelper_.reset(Selectable::READ, device()->fd(), 0);
+            selectHelper_.set_wakeup(this);
+            service()->executor()->select(&selectHelper_);
+            return wait();
+        }
+        return call_immediately(STATE(read_error));
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (msgs_[i].msg_len != sizeof(struct can_frame))
+        {
+            if (msgs_[i].msg_len == 0)
+            {
+                // EOF.
+                return call_immediately(STATE(read_error));
+            }
+            // CAN-FD frame or garbage. Reuses the buffer.
+            continue;
+        }
+        auto *b = bufs_[i];
+        bufs_[i] = nullptr;
+        b->data()->skipMember_ = skipMember_;
+#ifdef OPENMRN_HAVE_CAN_RX_TIMESTAMP
+        b->data()->rxTimestamp_ = socketcan_rx_timestamp(&msgs_[i].msg_hdr);
+#endif
+        dst_->send(b);
+    }
+    if (count == 0)
+    {
+        return call_immediately(STATE(read_error));
+    }
+    // Lets other flows run before the next batch.
+    return yield();
+}
+
+StateFlowBase::Action SocketCanReadFlow::read_error()
+{
+    set_terminated();
+    static_cast<FdHubPortService *>(service())->report_read_error();
+    notify_barrier();
+    return exit();
+}
+
+ssize_t HubDeviceSocketCan::write_batch(
+    int fd, const IoVec *iov, unsigned count)
+{
+    if (count > SocketCanReadFlow::BATCH_SIZE)
+    {
+        count = SocketCanReadFlow::BATCH_SIZE;
+    }
+    memset(sendMsgs_, 0, sizeof(sendMsgs_[0]) * count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        sendMsgs_[i].msg_hdr.msg_iov = const_cast<IoVec *>(&iov[i]);
+        sendMsgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent = ::sendmmsg(fd, sendMsgs_, count, MSG_DONTWAIT);
+    if (sent < 0)
+    {
+        return -1;
+    }
+    if (sent == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    ssize_t bytes = 0;
+    for (int i = 0; i < sent; ++i)
+    {
+        bytes += iov[i].iov_len;
+    }
+    return bytes;
+}
+
 #endif
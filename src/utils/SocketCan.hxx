@@ -37,6 +37,10 @@
 
 #if defined(__linux__)
 
+#include <sys/socket.h>
+
+#include "utils/HubDeviceSelect.hxx"
+
 /// Opens a SocketCan socket.
 /// @param device the name of the CAN device, e.g. can0
 /// @param loopback 1 to enable loopback locally to other open references,
@@ -44,6 +48,128 @@
 /// @return an open socket file descriptor, or -1 if there was an error.
 int socketcan_open(const char *device, int loopback);
 
+/// Turns on receive timestamps (SO_TIMESTAMPING) on a socket. When
+/// OPENMRN_HAVE_CAN_RX_TIMESTAMP is set, the timestamps are then carried in
+/// CanFrameContainer::rxTimestamp_ of the frames read by HubDeviceSocketCan.
+/// @param fd socket file descriptor.
+/// @param hardware if true, asks for the raw hardware timestamp of the CAN
+/// controller as well. Frames for which the driver does not supply one will
+/// carry the software timestamp.
+/// @return 0 on success, -1 if there was an error.
+int socketcan_enable_timestamps(int fd, bool hardware);
+
+/// @return the receive timestamp in nanoseconds from the control messages of
+/// a received frame, or 0 if there is none.
+/// @param hdr the message header filled in by recvmsg or recvmmsg.
+long long socketcan_rx_timestamp(struct msghdr *hdr);
+
+/// Read flow for HubDeviceSocketCan. Reads up to BATCH_SIZE frames with a
+/// single ::recvmmsg call, and forwards each of them to the hub.
+class SocketCanReadFlow : public StateFlowBase
+{
+public:
+    /// How many frames we read (and write) at most in one system call.
+    static constexpr unsigned BATCH_SIZE = 16;
+
+    /// Constructor.
+    ///
+    /// @param device parent object.
+    /// @param dst where to send the frames read.
+    /// @param skip_member what to set as source port of the frames read.
+    SocketCanReadFlow(FdHubPortService *device, CanHubFlow::port_type *dst,
+        CanHubFlow::port_type *skip_member);
+
+    ~SocketCanReadFlow();
+
+    /// Unregisters the current flow from the hub. Must be called on the main
+    /// executor.
+    void shutdown();
+
+    /// @return how many read system calls were made so far.
+    size_t num_read_calls()
+    {
+        return numReadCalls_;
+    }
+
+private:
+    /// Fills up the buffers and attempts to read from the fd. @return next
+    /// state.
+    Action try_read();
+
+    /// Called when the fd has an error or EOF. @return next state.
+    Action read_error();
+
+    /// Calls into the parent flow's barrier notify, but makes sure to only do
+    /// this once in the lifetime of *this.
+    void notify_barrier();
+
+    /// @return the parent object.
+    FdHubPortService *device()
+    {
+        return static_cast<FdHubPortService *>(service());
+    }
+
+    /// Space for the control messages with the timestamps.
+    static constexpr unsigned CONTROL_SIZE = 128;
+
+    /// true iff pending parent->barrier_.notify()
+    bool barrierOwned_{true};
+    /// Helper object for waiting for the fd to become readable.
+    StateFlowSelectHelper selectHelper_{this};
+    /// Where do we forward the frames read.
+    CanHubFlow::port_type *dst_;
+    /// What should be the source port designation.
+    CanHubFlow::port_type *skipMember_;
+    /// Buffers to read into. nullptr entries will be allocated before the
+    /// next read.
+    CanHubFlow::buffer_type *bufs_[BATCH_SIZE];
+    /// Headers for recvmmsg.
+    struct mmsghdr msgs_[BATCH_SIZE];
+    /// Data pointers for recvmmsg.
+    struct iovec iov_[BATCH_SIZE];
+    /// Control message space for the timestamps.
+    uint64_t control_[BATCH_SIZE][CONTROL_SIZE / 8];
+    /// Statistics: how many read syscalls were made.
+    size_t numReadCalls_{0};
+};
+
+/// Hub port for a SocketCan socket. Reads and writes up to
+/// SocketCanReadFlow::BATCH_SIZE frames per system call using ::recvmmsg and
+/// ::sendmmsg. Any packet-oriented socket carrying struct can_frame will
+/// work, such as a SOCK_SEQPACKET socketpair.
+class HubDeviceSocketCan : public HubDeviceSelect<CanHubFlow, SocketCanReadFlow>
+{
+public:
+    /// Creates a hub port for a SocketCan socket.
+    ///
+    /// @param hub the hub to open the port on
+    /// @param fd the socket, e.g. from socketcan_open().
+    /// @param on_error notifiable that will be called when a write or read
+    /// error is encountered.
+    HubDeviceSocketCan(CanHubFlow *hub, int fd, Notifiable *on_error = nullptr)
+        : HubDeviceSelect<CanHubFlow, SocketCanReadFlow>(hub, fd, on_error)
+    {
+    }
+
+    /// @return how many read system calls were made so far.
+    size_t num_read_calls()
+    {
+        return readFlow_.num_read_calls();
+    }
+
+protected:
+    unsigned write_batch_limit() override
+    {
+        return SocketCanReadFlow::BATCH_SIZE;
+    }
+
+    ssize_t write_batch(int fd, const IoVec *iov, unsigned count) override;
+
+private:
+    /// Headers for sendmmsg.
+    struct mmsghdr sendMsgs_[SocketCanReadFlow::BATCH_SIZE];
+};
+
 #endif
 
 #endif // _UTILS_SOCKETCAN_HXX_
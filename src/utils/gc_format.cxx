@@ -34,10 +34,18 @@
 //#define LOGLEVEL VERBOSE
 
 #include <stdint.h>
+#include <string.h>
+#include "openmrn_features.h"
 #include "utils/logging.h"
 #include "utils/gc_format.h"
 #include "can_frame.h"
 
+#if OPENMRN_HAVE_SSE2
+#include <emmintrin.h>
+#elif OPENMRN_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
 extern "C" {
 
 /** Build an ASCII character representation of a nibble value (uppercase hex).
@@ -79,7 +87,9 @@ static int ascii_to_nibble(const char c)
 }
 
 
-int gc_format_parse(const char* buf, struct can_frame* can_frame)
+/** Parses a GridConnect packet one character at a time. Arguments and return
+ * value are the same as for gc_format_parse. */
+static int gc_format_parse_scalar(const char* buf, struct can_frame* can_frame)
 {
     CLR_CAN_FRAME_ERR(*can_frame);
     if (*buf == ':')
@@ -179,24 +189,10 @@ static void output_double(char*& dst, char value)
     *dst++ = value;
 }
 
-/** Formats a can frame in the GridConnect protocol.
-
-    If requested, it can create the double protocol with leading !!, trailing ;;
-    and all the characters doubled.
-
-    If the input frame is an error frame, then does not output anything and
-    returns the input pointer.
-
-    @param can_frame is the input frame.
-
-    @param buf is the output buffer. The caller must ensure this is big enough
-    to hold the resulting frame (28 or 56 bytes).
-
-    @param double_format if non-zero, the doubling format will be generated.
-
-    @return the pointer to the buffer character after the formatted can frame.
-*/
-char* gc_format_generate(const struct can_frame* can_frame, char* buf, int double_format)
+/** Formats a can frame in the GridConnect protocol one character at a time.
+ * Arguments and return value are the same as for gc_format_generate. */
+static char* gc_format_generate_scalar(
+    const struct can_frame* can_frame, char* buf, int double_format)
 {
     if (IS_CAN_FRAME_ERR(*can_frame))
     {
@@ -254,4 +250,235 @@ char* gc_format_generate(const struct can_frame* can_frame, char* buf, int doubl
     return buf;
 }
 
+#if OPENMRN_HAVE_SSE2 || OPENMRN_HAVE_NEON
+
+/** Converts 16 hex characters to 8 bytes. Understands both upper and
+    lowercase hex.
+    @param src is the input; 16 characters will be read, but only the first
+    count characters need to be hex digits.
+    @param count is the number of characters to check for validity (0..16).
+    @param dst is the output, 8 bytes.
+    @return true if the first count characters were valid hex digits.
+*/
+static bool hex_decode16(const char *src, unsigned count, uint8_t *dst)
+{
+#if OPENMRN_HAVE_SSE2
+    __m128i c = _mm_loadu_si128((const __m128i *)src);
+    __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    // There is no unsigned comparison in SSE2; x <= n iff min(x, n) == x.
+    __m128i is_d = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i a = _mm_sub_epi8(
+        _mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_a = _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a);
+    __m128i val = _mm_or_si128(_mm_and_si128(is_d, d),
+        _mm_and_si128(is_a, _mm_add_epi8(a, _mm_set1_epi8(10))));
+    // In each 16-bit lane the low byte is the high nibble.
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(val, _mm_set1_epi16(0xFF)), 4);
+    __m128i lo = _mm_srli_epi16(val, 8);
+    _mm_storel_epi64((__m128i *)dst,
+        _mm_packus_epi16(_mm_or_si128(hi, lo), _mm_setzero_si128()));
+    unsigned need = (1u << count) - 1;
+    return (_mm_movemask_epi8(_mm_or_si128(is_d, is_a)) & need) == need;
+#else
+    uint8x16_t c = vld1q_u8((const uint8_t *)src);
+    uint8x16_t d = vsubq_u8(c, vdupq_n_u8('0'));
+    uint8x16_t is_d = vcleq_u8(d, vdupq_n_u8(9));
+    uint8x16_t a =
+        vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t is_a = vcleq_u8(a, vdupq_n_u8(5));
+    uint8x16_t val = vbslq_u8(is_d, d, vaddq_u8(a, vdupq_n_u8(10)));
+    // Separates the even (high nibble) and odd (low nibble) characters.
+    uint8x16x2_t uz = vuzpq_u8(val, val);
+    vst1_u8(dst, vorr_u8(vshl_n_u8(vget_low_u8(uz.val[0]), 4),
+                     vget_low_u8(uz.val[1])));
+    // Narrows the comparison result to 4 bits per character.
+    uint64_t valid = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+                         vreinterpretq_u16_u8(vorrq_u8(is_d, is_a)), 4)),
+        0);
+    uint64_t need = count >= 16 ? ~0ULL : (1ULL << (4 * count)) - 1;
+    return (valid & need) == need;
+#endif
+}
+
+/** Converts 8 bytes to 16 uppercase hex characters.
+    @param src is the input, 8 bytes.
+    @param dst is the output, 16 characters.
+*/
+static void hex_encode8(const uint8_t *src, char *dst)
+{
+#if OPENMRN_HAVE_SSE2
+    __m128i v = _mm_loadl_epi64((const __m128i *)src);
+    __m128i mask = _mm_set1_epi8(0xF);
+    __m128i n = _mm_unpacklo_epi8(
+        _mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(v, mask));
+    __m128i letter = _mm_and_si128(
+        _mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+    _mm_storeu_si128((__m128i *)dst,
+        _mm_add_epi8(n, _mm_add_epi8(letter, _mm_set1_epi8('0'))));
+#else
+    static const uint8_t digits[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
+        '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+    uint8x8_t v = vld1_u8(src);
+    uint8x8x2_t n = vzip_u8(vshr_n_u8(v, 4), vand_u8(v, vdup_n_u8(0xF)));
+    vst1q_u8((uint8_t *)dst,
+        vqtbl1q_u8(vld1q_u8(digits), vcombine_u8(n.val[0], n.val[1])));
+#endif
+}
+
+/** Finds the end of the ID in a GridConnect packet.
+    @param src is the packet after the frame type character; 16 characters
+    will be read.
+    @return the offset of the first 'N' or 'R' character, or 16 if there is
+    none.
+*/
+static int find_id_end(const char *src)
+{
+#if OPENMRN_HAVE_SSE2
+    __m128i c = _mm_loadu_si128((const __m128i *)src);
+    unsigned found = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('N')),
+            _mm_cmpeq_epi8(c, _mm_set1_epi8('R'))));
+    return found ? __builtin_ctz(found) : 16;
+#else
+    uint8x16_t c = vld1q_u8((const uint8_t *)src);
+    uint8x16_t eq =
+        vorrq_u8(vceqq_u8(c, vdupq_n_u8('N')), vceqq_u8(c, vdupq_n_u8('R')));
+    uint64_t found = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return found ? __builtin_ctzll(found) >> 2 : 16;
+#endif
+}
+
+/** Parses a well-formed GridConnect packet using the vector helpers.
+    @param buf is the packet, same as for gc_format_parse.
+    @param can_frame is the output frame.
+    @return true if the packet was parsed; false if the packet is not in the
+    usual form or has errors, in which case the scalar parser has to be used
+    and can_frame is unchanged.
+*/
+static bool gc_format_parse_vector(const char *buf, struct can_frame *can_frame)
+{
+    if (*buf == ':')
+    {
+        ++buf;
+    }
+    char type = *buf++;
+    if (type != 'X' && type != 'S')
+    {
+        return false;
+    }
+    // The input is a C string of unknown length, thus we cannot read ahead in
+    // 16-byte chunks. Copies it to a local buffer where we can, after eight
+    // zero digits that pad a short ID.
+    size_t len = strcspn(buf, ";");
+    if (len > 8 + 1 + 16)
+    {
+        return false;
+    }
+    char text[8 + 32 + 16];
+    memset(text, '0', 8);
+    char *p = text + 8;
+    memcpy(p, buf, len);
+    int id_len = find_id_end(p);
+    int data_len = (int)len - id_len - 1;
+    if (id_len > 8 || data_len < 0 || data_len > 16 || (data_len & 1))
+    {
+        return false;
+    }
+    uint8_t id_bin[8];
+    uint8_t data[8];
+    if (!hex_decode16(p + id_len - 8, 8, id_bin) ||
+        !hex_decode16(p + id_len + 1, data_len, data))
+    {
+        return false;
+    }
+    uint32_t id = ((uint32_t)id_bin[0] << 24) | ((uint32_t)id_bin[1] << 16) |
+        ((uint32_t)id_bin[2] << 8) | id_bin[3];
+    if (type == 'X')
+    {
+        SET_CAN_FRAME_EFF(*can_frame);
+        SET_CAN_FRAME_ID_EFF(*can_frame, id);
+    }
+    else
+    {
+        CLR_CAN_FRAME_EFF(*can_frame);
+        SET_CAN_FRAME_ID(*can_frame, id);
+    }
+    if (p[id_len] == 'R')
+    {
+        SET_CAN_FRAME_RTR(*can_frame);
+    }
+    else
+    {
+        CLR_CAN_FRAME_RTR(*can_frame);
+    }
+    memcpy(can_frame->data, data, data_len / 2);
+    can_frame->can_dlc = data_len / 2;
+    CLR_CAN_FRAME_ERR(*can_frame);
+    return true;
+}
+
+/** Formats a can frame in the single GridConnect format using the vector
+    helpers. The frame must not be an error frame.
+    @param can_frame is the input frame, with at most 8 data bytes.
+    @param buf is the output buffer (28 bytes).
+    @return the pointer to the buffer character after the formatted can frame.
+*/
+static char *gc_format_generate_vector(
+    const struct can_frame *can_frame, char *buf)
+{
+    bool eff = IS_CAN_FRAME_EFF(*can_frame);
+    uint32_t id = eff ? GET_CAN_FRAME_ID_EFF(*can_frame)
+                      : GET_CAN_FRAME_ID(*can_frame);
+    int id_digits = eff ? 8 : 3;
+    uint8_t id_bin[8] = {0, 0, 0, 0, (uint8_t)(id >> 24), (uint8_t)(id >> 16),
+        (uint8_t)(id >> 8), (uint8_t)id};
+    // Assembles the packet in a local buffer, where the 16-byte stores may
+    // write beyond the end of the packet.
+    char text[16 + 32 + 16];
+    char *p = text + 16;
+    // The last id_digits of the 16 digits will be used.
+    hex_encode8(id_bin, p + 2 + id_digits - 16);
+    p[0] = ':';
+    p[1] = eff ? 'X' : 'S';
+    p += 2 + id_digits;
+    hex_encode8(can_frame->data, p + 1);
+    *p = IS_CAN_FRAME_RTR(*can_frame) ? 'R' : 'N';
+    p += 1 + can_frame->can_dlc * 2;
+    *p++ = ';';
+    if (config_gc_generate_newlines() == CONSTANT_TRUE)
+    {
+        *p++ = '\n';
+    }
+    size_t len = p - (text + 16);
+    memcpy(buf, text + 16, len);
+    return buf + len;
+}
+
+#endif // OPENMRN_HAVE_SSE2 || OPENMRN_HAVE_NEON
+
+int gc_format_parse(const char* buf, struct can_frame* can_frame)
+{
+#if OPENMRN_HAVE_SSE2 || OPENMRN_HAVE_NEON
+    if (gc_format_parse_vector(buf, can_frame))
+    {
+        return 0;
+    }
+#endif
+    // Unusual packets and errors.
+    return gc_format_parse_scalar(buf, can_frame);
+}
+
+char* gc_format_generate(const struct can_frame* can_frame, char* buf, int double_format)
+{
+#if OPENMRN_HAVE_SSE2 || OPENMRN_HAVE_NEON
+    if (!double_format && !IS_CAN_FRAME_ERR(*can_frame) &&
+        can_frame->can_dlc <= 8)
+    {
+        return gc_format_generate_vector(can_frame, buf);
+    }
+#endif
+    return gc_format_generate_scalar(can_frame, buf, double_format);
+}
+
 }